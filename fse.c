@@ -39,7 +39,25 @@
 // Increasing memory usage improves compression ratio
 // Reduced memory usage can improve speed, due to cache effect
 // Default value is 14, for 16KB, which nicely fits into Intel x86 L1 cache
-#define FSE_MEMORY_USAGE 14
+#ifndef FSE_MEMORY_USAGE
+#  define FSE_MEMORY_USAGE 14
+#endif
+
+// FSE_MAX_MEMORY_USAGE :
+// Largest table memory usage, hence largest tableLog (FSE_MAX_MEMORY_USAGE-2), selectable at runtime with FSE_compress2()
+// Larger tables improve precision (notably for large alphabets), but no longer fit into L1 cache
+// Up to 17 (tableLog 15) : compile with -DFSE_MAX_MEMORY_USAGE=17
+// Note : compressed streams with tableLog > 12 can only be decoded by libraries compiled with large enough FSE_MAX_MEMORY_USAGE
+#ifndef FSE_MAX_MEMORY_USAGE
+#  define FSE_MAX_MEMORY_USAGE FSE_MEMORY_USAGE
+#endif
+
+// FSE_PREFETCH_TABLELOG :
+// Beyond this tableLog, decoding table doesn't fit into L1 cache :
+// the decoder then prefetches the next cell of each interleaved state, while decoding the other one
+#ifndef FSE_PREFETCH_TABLELOG
+#  define FSE_PREFETCH_TABLELOG 12
+#endif
 
 // FSE_MAX_NB_SYMBOLS :
 // Maximum nb of symbol values authorized.
@@ -60,6 +78,7 @@
 #include <stddef.h>    // ptrdiff_t
 #include <string.h>    // memcpy, memset
 #include <stdio.h>     // printf (debug)
+#include <math.h>      // log2 (block statistics)
 
 
 //****************************************************************
@@ -89,7 +108,8 @@ typedef size_t bitContainer_t;
 //* Constants
 //****************************************************************
 #define FSE_MAX_NB_SYMBOLS_CHAR (FSE_MAX_NB_SYMBOLS>256 ? 256 : FSE_MAX_NB_SYMBOLS)
-#define FSE_MAX_TABLELOG  (FSE_MEMORY_USAGE-2)
+#define FSE_MAX_TABLELOG  (FSE_MAX_MEMORY_USAGE-2)
+#define FSE_DEFAULT_TABLELOG (FSE_MEMORY_USAGE-2)
 #define FSE_MAX_TABLESIZE (1U<<FSE_MAX_TABLELOG)
 #define FSE_MAXTABLESIZE_MASK (FSE_MAX_TABLESIZE-1)
 #define FSE_MIN_TABLELOG 5
@@ -101,6 +121,10 @@ typedef size_t bitContainer_t;
 #error "FSE_MAX_TABLELOG>15 isn't supported"
 #endif
 
+#if FSE_DEFAULT_TABLELOG>FSE_MAX_TABLELOG
+#error "FSE_MEMORY_USAGE can't be larger than FSE_MAX_MEMORY_USAGE"
+#endif
+
 
 //****************************************************************
 //* Compiler specifics
@@ -108,17 +132,73 @@ typedef size_t bitContainer_t;
 #ifdef _MSC_VER    // Visual Studio
 #  define FORCE_INLINE static __forceinline
 #  include <intrin.h>                    // For Visual 2005
+#  include <xmmintrin.h>                 // _mm_prefetch
+#  define FSE_PREFETCH(ptr) _mm_prefetch((const char*)(ptr), _MM_HINT_T0)
 #  pragma warning(disable : 4127)        // disable: C4127: conditional expression is constant
 #  pragma warning(disable : 4214)        // disable: C4214: non-int bitfields
 #else
 #  define GCC_VERSION (__GNUC__ * 100 + __GNUC_MINOR__)
 #  ifdef __GNUC__
 #    define FORCE_INLINE static inline __attribute__((always_inline))
+#    define FSE_PREFETCH(ptr) __builtin_prefetch((ptr), 0, 3)
 #  else
 #    define FORCE_INLINE static inline
+#    define FSE_PREFETCH(ptr)   // no prefetch
 #  endif
 #endif
 
+#if defined(_MSC_VER)
+#  define FSE_THREAD_LOCAL __declspec(thread)
+#elif defined(__GNUC__)
+#  define FSE_THREAD_LOCAL __thread
+#elif defined (__STDC_VERSION__) && (__STDC_VERSION__ >= 201112L)   // C11
+#  define FSE_THREAD_LOCAL _Thread_local
+#else
+#  define FSE_THREAD_LOCAL               // statistics are then shared by all threads
+#endif
+
+
+/****************************************************************
+  CPU dispatch
+****************************************************************/
+/* On x86, hot kernels are compiled twice : portable, and with BMI2 + LZCNT (shrx, shlx, bzhi, lzcnt).
+   The variant is selected at runtime, using cpuid. Define FSE_NO_DISPATCH to keep portable code only. */
+#if defined(__GNUC__) && ((GCC_VERSION >= 409) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__)) && !defined(FSE_NO_DISPATCH)
+#  include <cpuid.h>
+#  define FSE_DISPATCH 1
+#  define FSE_TARGET_BMI2 __attribute__((target("bmi,bmi2,lzcnt")))
+#else
+#  define FSE_DISPATCH 0
+#endif
+
+/* Test only : with FSE_TEST_DISPATCH defined, setting FSE_testPortable selects portable kernels on a BMI2 host,
+   so that both variants can be checked against each other within a single program. */
+#if defined(FSE_TEST_DISPATCH)
+int FSE_testPortable = 0;
+#endif
+
+#if FSE_DISPATCH
+static int FSE_detectBMI2(void)
+{
+    unsigned int a, b, c, d;
+    if (__get_cpuid_max(0, 0) < 7) return 0;
+    __cpuid_count(7, 0, a, b, c, d);
+    if (!((b >> 3) & 1) || !((b >> 8) & 1)) return 0;   // BMI1, BMI2
+    if (!__get_cpuid(0x80000001, &a, &b, &c, &d)) return 0;
+    return (c >> 5) & 1;   // LZCNT
+}
+
+static int FSE_cpuBMI2(void)
+{
+    static int bmi2 = -1;   // detected once ; concurrent first calls store the same value
+    if (bmi2 < 0) bmi2 = FSE_detectBMI2();
+#if defined(FSE_TEST_DISPATCH)
+    if (FSE_testPortable) return 0;
+#endif
+    return bmi2;
+}
+#endif
+
 
 /****************************************************************
   Internal functions
@@ -149,7 +229,7 @@ FORCE_INLINE int FSE_highbit (register U32 val)
 //****************************************************************
 //* Header bitstream
 //****************************************************************
-int FSE_writeHeader (void* header, const unsigned int* normalizedCounter, int nbSymbols, int tableLog)
+int FSE_writeHeader_spread (void* header, const unsigned int* normalizedCounter, int nbSymbols, int tableLog, int spread)
 {
     BYTE* const ostart = (BYTE*) header;
     BYTE* out = ostart;
@@ -164,13 +244,16 @@ int FSE_writeHeader (void* header, const unsigned int* normalizedCounter, int nb
 
     if (tableLog > FSE_MAX_TABLELOG) return -1;   // Unsupported
     if (tableLog < FSE_MIN_TABLELOG) return -1;   // Unsupported
+    if ((unsigned)spread >= FSE_NB_SPREADS) return -1;
 
-    // HeaderId (normal case)
-    bitStream = 2;
+    // HeaderId : normal case (step spread), or explicit spread
+    bitStream = spread ? 3 : 2;
     bitCount  = 2;
     // Table Size
     bitStream += (tableLog-FSE_MIN_TABLELOG) <<bitCount;
     bitCount  += 4;
+    // Spread (explicit spread only)
+    if (spread) { bitStream += spread << bitCount; bitCount += 2; }
 
     // Init
     remaining = tableSize;
@@ -224,10 +307,17 @@ int FSE_writeHeader (void* header, const unsigned int* normalizedCounter, int nb
     return (int) (out-ostart);
 }
 
+int FSE_writeHeader (void* header, const unsigned int* normalizedCounter, int nbSymbols, int tableLog)
+{
+    return FSE_writeHeader_spread(header, normalizedCounter, nbSymbols, tableLog, FSE_spread_step);
+}
+
 
-int FSE_readHeader (unsigned int* const normalizedCounter, int* nbSymbols, int* tableLog, const void* header)
+FORCE_INLINE int FSE_readHeader_generic (unsigned int* const normalizedCounter, int* nbSymbols, int* tableLog, int* spread,
+                                         const void* header, int maxHeaderSize, int safe)
 {
     const BYTE* const istart = (const BYTE*) header;
+    const BYTE* const ilimit = istart + maxHeaderSize - 4;   // last position where a U32 can be read (safe mode)
     const BYTE* ip = (const BYTE*) header;
     int nbBits;
     int remaining;
@@ -236,27 +326,47 @@ int FSE_readHeader (unsigned int* const normalizedCounter, int* nbSymbols, int*
     int bitCount;
     int charnum = 0;
     int previous0 = 0;
+    int explicitSpread;
 
+    *spread = FSE_spread_step;
+    if ((safe) && (maxHeaderSize < 4)) return -1;
     bitStream = * (U32*) ip;
+    explicitSpread = ((bitStream & 3) == 3);
     bitStream >>= 2;
     nbBits = (bitStream & 0xF) + FSE_MIN_TABLELOG;   // read tableLog
+    if ((safe) && (nbBits > FSE_MAX_TABLELOG)) return -1;
     bitStream >>= 4;
     *tableLog = nbBits;
     remaining = (1<<nbBits);
     threshold = remaining;
     nbBits++;
     bitCount = 6;
+    if (explicitSpread)
+    {
+        *spread = bitStream & 3;
+        if ((*spread == FSE_spread_step) || (*spread >= FSE_NB_SPREADS)) return -1;   // reserved values
+        bitStream >>= 2;
+        bitCount += 2;
+    }
 
     while (remaining>0)
     {
         if (previous0)
         {
             int n0 = charnum;
-            while ((bitStream & 0xFFFF) == 0xFFFF) { n0+=24; ip+=2; bitStream = (*(U32*)ip) >> bitCount; }
+            while ((bitStream & 0xFFFF) == 0xFFFF)
+            {
+                n0+=24; ip+=2;
+                if ((safe) && (ip > ilimit)) return -1;
+                bitStream = (*(U32*)ip) >> bitCount;
+            }
             while ((bitStream & 3) == 3) { n0+=3; bitStream>>=2; bitCount+=2; }
             n0 += bitStream & 3; bitCount += 2;
+            if ((safe) && (n0 >= FSE_MAX_NB_SYMBOLS_CHAR)) return -1;
             while (charnum < n0) normalizedCounter[charnum++] = 0;
-            ip += bitCount>>3; bitCount &= 7; bitStream = (*(U32*)ip) >> bitCount;
+            ip += bitCount>>3; bitCount &= 7;
+            if ((safe) && (ip > ilimit)) return -1;
+            bitStream = (*(U32*)ip) >> bitCount;
         }
         {
             const U32 max = (2*threshold-1)-remaining;
@@ -275,11 +385,14 @@ int FSE_readHeader (unsigned int* const normalizedCounter, int* nbSymbols, int*
             }
 
             remaining -= count;
+            if ((safe) && (charnum >= FSE_MAX_NB_SYMBOLS_CHAR)) return -1;
             normalizedCounter[charnum++] = count;
             previous0 = !count;
             while (remaining < threshold) { nbBits--; threshold >>= 1; }
 
-            ip += bitCount>>3; bitCount &= 7; bitStream = (*(U32*)ip) >> bitCount;
+            ip += bitCount>>3; bitCount &= 7;
+            if ((safe) && (ip > ilimit)) return -1;
+            bitStream = (*(U32*)ip) >> bitCount;
         }
     }
     *nbSymbols = charnum;
@@ -290,6 +403,27 @@ int FSE_readHeader (unsigned int* const normalizedCounter, int* nbSymbols, int*
     return (int) (ip-istart);
 }
 
+int FSE_readHeader (unsigned int* const normalizedCounter, int* nbSymbols, int* tableLog, const void* header)
+{
+    int spread;
+    const int headerSize = FSE_readHeader_generic(normalizedCounter, nbSymbols, tableLog, &spread, header, 0, 0);
+    if (spread != FSE_spread_step) return -1;   // table would not match : use FSE_readHeader_spread()
+    return headerSize;
+}
+
+int FSE_readHeader_safe (unsigned int* const normalizedCounter, int* nbSymbols, int* tableLog, const void* header, int maxHeaderSize)
+{
+    int spread;
+    const int headerSize = FSE_readHeader_generic(normalizedCounter, nbSymbols, tableLog, &spread, header, maxHeaderSize, 1);
+    if (spread != FSE_spread_step) return -1;   // table would not match : use FSE_readHeader_spread()
+    return headerSize;
+}
+
+int FSE_readHeader_spread (unsigned int* const normalizedCounter, int* nbSymbols, int* tableLog, int* spread, const void* header, int maxHeaderSize)
+{
+    return FSE_readHeader_generic(normalizedCounter, nbSymbols, tableLog, spread, header, maxHeaderSize, 1);
+}
+
 
 //****************************
 // FSE Compression Code
@@ -332,9 +466,9 @@ int FSE_normalizeCount (unsigned int* normalizedCounter, int tableLog, unsigned
     int vTotal= total;
 
     // Check
-    if (tableLog==0) tableLog = FSE_MAX_TABLELOG;
+    if (tableLog==0) tableLog = FSE_DEFAULT_TABLELOG;
     if ((FSE_highbit(total-1)+1) < tableLog) tableLog = FSE_highbit(total-1)+1;   // Useless accuracy
-    if ((FSE_highbit(nbSymbols)+1) > tableLog) tableLog = FSE_highbit(nbSymbols-1)+1;   // Need a minimum to represent all symbol values
+    if ((FSE_highbit(nbSymbols)+1) > tableLog) tableLog = FSE_highbit(nbSymbols)+1;   // Need a minimum to represent all symbol values : tableSize > nbSymbols
     if (tableLog < FSE_MIN_TABLELOG) tableLog = FSE_MIN_TABLELOG;
     if (tableLog > FSE_MAX_TABLELOG) return -1;   // Unsupported size
 
@@ -421,52 +555,109 @@ int FSE_sizeof_CTable (int nbSymbols, int tableLog)
     return (int) (FSE_SIZEOF_CTABLE_U32 (nbSymbols, tableLog) * sizeof (U32) );
 }
 
+/*
+Symbol spread : layout of each symbol's cells within the state table.
+It must be the same for encoder and decoder, hence it only depends on the header (normalized counts, and spread).
+FSE_spread_step    : cells are scattered with a constant step (default).
+FSE_spread_sorted  : each symbol fills a contiguous run of cells. Fastest to build, least precise.
+FSE_spread_precise : cells are sorted by ideal position, so that state x in [count, 2*count[ of symbol s
+                     lands close to tableSize/(p(s).ln(1+1/x)), with p(s) = count/tableSize (Duda's precise initialization).
+                     1/ln(1+1/x) is approximated by x + 1/2 - 1/(12x), in fixed point, so that all platforms agree;
+                     cells with the same ideal position are sorted by symbol.
+*/
 #define FSE_TABLESTEP(tableSize) ((tableSize>>1) + (tableSize>>3) + 3)
-int FSE_spreadSymbols8(BYTE* tableSymbolByte, const unsigned int* normalizedCounter, int nbSymbols, int tableLog)
-{
-    int s;
-    const int tableSize = 1 << tableLog;
-    U32 position = 0;
 
-#if !defined(SPREADFUNC)
+static U32 FSE_idealPosition(U32 x, U32 ratio, U32 tableSize)   // ratio : (tableSize<<16) / count
+{
+    const U32 fx = (x<<16) + (1<<15) - (5461/x);   // (x + 1/2 - 1/(12x)) << 16
+    U32 position = (U32)(((U64)fx * ratio) >> 32);
+    if (position < tableSize) position = tableSize;
+    if (position >= 2*tableSize) position = 2*tableSize-1;
+    return position - tableSize;
+}
 
-    const int step = FSE_TABLESTEP(tableSize);
-    const int tableMask = tableSize - 1;
+static int FSE_spreadPrecise(BYTE* tableSymbolByte, const unsigned int* normalizedCounter, int nbSymbols, int tableSize)
+{
+    U16 cell[FSE_MAX_TABLESIZE];   // nb of cells per ideal position, then next cell of each ideal position
+    U32 total = 0;
+    int s, position;
 
-    // Spread symbols
+    // counting sort of cells, by ideal position, then by symbol and state
+    memset(cell, 0, tableSize * sizeof(U16));
     for (s=0; s<nbSymbols; s++)
     {
-        U32 i;
-        for (i=0; i<normalizedCounter[s]; i++)
-        {
-            tableSymbolByte[position] = (BYTE)s;
-            position = (position + step) & tableMask;
-        }
+        const U32 count = normalizedCounter[s];
+        U32 ratio, x;
+        if (count > (U32)tableSize - total) return -1;   // normalizedCounter does not sum to tableSize
+        total += count;
+        if (!count) continue;
+        ratio = ((U32)tableSize << 16) / count;
+        for (x=count; x<2*count; x++) cell[FSE_idealPosition(x, ratio, tableSize)]++;
     }
+    if (total != (U32)tableSize) return -1;
 
-    if (position!=0) return -1;   // Must have gone through all positions, otherwise normalizedCount is not correct
+    total = 0;
+    for (position=0; position<tableSize; position++) { const U32 n = cell[position]; cell[position] = (U16)total; total += n; }
 
-#else
-    extern void SPREADFUNC(unsigned char *output, unsigned char *input, int len);
+    for (s=0; s<nbSymbols; s++)
+    {
+        const U32 count = normalizedCounter[s];
+        U32 ratio, x;
+        if (!count) continue;
+        ratio = ((U32)tableSize << 16) / count;
+        for (x=count; x<2*count; x++) tableSymbolByte[cell[FSE_idealPosition(x, ratio, tableSize)]++] = (BYTE)s;
+    }
 
-    unsigned char sorted_symbols[tableSize];
+    return 0;
+}
 
-    for (s=0; s<nbSymbols; s++)
+int FSE_spreadSymbols8(BYTE* tableSymbolByte, const unsigned int* normalizedCounter, int nbSymbols, int tableLog, int spread)
+{
+    int s;
+    const int tableSize = 1 << tableLog;
+    U32 position = 0;
+
+    switch (spread)
     {
-        if(normalizedCounter[s] > 0) {
-            memset(sorted_symbols + position, s, normalizedCounter[s]);
-            position += normalizedCounter[s];
+    case FSE_spread_step:
+    {
+        const int step = FSE_TABLESTEP(tableSize);
+        const int tableMask = tableSize - 1;
+
+        // Spread symbols
+        for (s=0; s<nbSymbols; s++)
+        {
+            U32 i;
+            for (i=0; i<normalizedCounter[s]; i++)
+            {
+                tableSymbolByte[position] = (BYTE)s;
+                position = (position + step) & tableMask;
+            }
         }
+
+        if (position!=0) return -1;   // Must have gone through all positions, otherwise normalizedCount is not correct
+        return 0;
     }
 
-    SPREADFUNC((unsigned char *)tableSymbolByte, sorted_symbols, tableSize);
+    case FSE_spread_sorted:
+        for (s=0; s<nbSymbols; s++)
+        {
+            if (normalizedCounter[s] > (U32)tableSize - position) return -1;
+            memset(tableSymbolByte + position, s, normalizedCounter[s]);
+            position += normalizedCounter[s];
+        }
+        if (position!=(U32)tableSize) return -1;
+        return 0;
 
-#endif
+    case FSE_spread_precise:
+        return FSE_spreadPrecise(tableSymbolByte, normalizedCounter, nbSymbols, tableSize);
 
-    return 0;
+    default:
+        return -1;   // unknown spread
+    }
 }
 
-int FSE_buildCTable (void* CTable, const unsigned int* normalizedCounter, int nbSymbols, int tableLog)
+FORCE_INLINE int FSE_buildCTable_generic (void* CTable, const unsigned int* normalizedCounter, int nbSymbols, int tableLog, int spread)
 {
     const int tableSize = 1 << tableLog;
     U16* tableU16 = ( (U16*) CTable) + 2;
@@ -485,7 +676,7 @@ int FSE_buildCTable (void* CTable, const unsigned int* normalizedCounter, int nb
     for (i=1; i<nbSymbols; i++) cumul[i] = cumul[i-1] + normalizedCounter[i-1];
     cumul[nbSymbols] = tableSize+1;
 
-    errorCode = FSE_spreadSymbols8(tableSymbolByte, normalizedCounter, nbSymbols, tableLog);
+    errorCode = FSE_spreadSymbols8(tableSymbolByte, normalizedCounter, nbSymbols, tableLog, spread);
     if(errorCode == -1) return -1;
 
     // Build table
@@ -523,6 +714,31 @@ int FSE_buildCTable (void* CTable, const unsigned int* normalizedCounter, int nb
     return 0;
 }
 
+static int FSE_buildCTable_default (void* CTable, const unsigned int* normalizedCounter, int nbSymbols, int tableLog, int spread)
+{
+    return FSE_buildCTable_generic(CTable, normalizedCounter, nbSymbols, tableLog, spread);
+}
+
+#if FSE_DISPATCH
+FSE_TARGET_BMI2 static int FSE_buildCTable_bmi2 (void* CTable, const unsigned int* normalizedCounter, int nbSymbols, int tableLog, int spread)
+{
+    return FSE_buildCTable_generic(CTable, normalizedCounter, nbSymbols, tableLog, spread);
+}
+#endif
+
+int FSE_buildCTable_spread (void* CTable, const unsigned int* normalizedCounter, int nbSymbols, int tableLog, int spread)
+{
+#if FSE_DISPATCH
+    if (FSE_cpuBMI2()) return FSE_buildCTable_bmi2(CTable, normalizedCounter, nbSymbols, tableLog, spread);
+#endif
+    return FSE_buildCTable_default(CTable, normalizedCounter, nbSymbols, tableLog, spread);
+}
+
+int FSE_buildCTable (void* CTable, const unsigned int* normalizedCounter, int nbSymbols, int tableLog)
+{
+    return FSE_buildCTable_spread(CTable, normalizedCounter, nbSymbols, tableLog, FSE_spread_step);
+}
+
 
 void* FSE_initCompressionStream(void** op, ptrdiff_t* state, const void** symbolTT, const void** stateTable, const void* CTable)
 {
@@ -536,16 +752,29 @@ void* FSE_initCompressionStream(void** op, ptrdiff_t* state, const void** symbol
 }
 
 
-void FSE_encodeByte(ptrdiff_t* state, bitContainer_forward_t* bitC, BYTE symbol, const void* CTable1, const void* CTable2)
+/* Same as FSE_addBits(), with a computed mask instead of a table lookup : a single bzhi once compiled for BMI2 */
+FORCE_INLINE void FSE_addBits_bzhi(bitContainer_forward_t* bitC, size_t value, int nbBits)
+{
+    bitC->bitContainer |= (value & (((size_t)1 << nbBits) - 1)) << bitC->bitPos;
+    bitC->bitPos += nbBits;
+}
+
+FORCE_INLINE void FSE_encodeByte_generic(ptrdiff_t* state, bitContainer_forward_t* bitC, BYTE symbol, const void* CTable1, const void* CTable2, int bmi2)
 {
     const FSE_symbolCompressionTransform* const symbolTT = (const FSE_symbolCompressionTransform*) CTable1;
     const U16* const stateTable = (const U16*) CTable2;
     int nbBitsOut  = symbolTT[symbol].minBitsOut;
     nbBitsOut -= (int)((symbolTT[symbol].maxState - *state) >> 31);
-    FSE_addBits(bitC, *state, nbBitsOut);
+    if (bmi2) FSE_addBits_bzhi(bitC, *state, nbBitsOut);
+    else FSE_addBits(bitC, *state, nbBitsOut);
     *state = stateTable[ (*state>>nbBitsOut) + symbolTT[symbol].deltaFindState];
 }
 
+void FSE_encodeByte(ptrdiff_t* state, bitContainer_forward_t* bitC, BYTE symbol, const void* CTable1, const void* CTable2)
+{
+    FSE_encodeByte_generic(state, bitC, symbol, CTable1, CTable2, 0);
+}
+
 
 int FSE_closeCompressionStream(void* outPtr, bitContainer_forward_t* bitC, 
                                 int nbStates, ptrdiff_t state1, ptrdiff_t state2, ptrdiff_t state3, ptrdiff_t state4,
@@ -576,7 +805,7 @@ int FSE_closeCompressionStream(void* outPtr, bitContainer_forward_t* bitC,
 }
 
 
-FORCE_INLINE int FSE_compress_usingCTable_generic (void* dest, const unsigned char* source, int sourceSize, const void* CTable, int ilp)
+FORCE_INLINE int FSE_compress_usingCTable_generic (void* dest, const unsigned char* source, int sourceSize, const void* CTable, int ilp, int bmi2)
 {
     const BYTE* const istart = (const BYTE*) source;
     const BYTE* ip;
@@ -607,7 +836,7 @@ FORCE_INLINE int FSE_compress_usingCTable_generic (void* dest, const unsigned ch
         nbCatchup = (sourceSize - nbStreams) % nbSymbolsPerLoop;
         while (nbCatchup)
         {
-            FSE_encodeByte(&state1, &bitC, *--ip, symbolTT, stateTable);
+            FSE_encodeByte_generic(&state1, &bitC, *--ip, symbolTT, stateTable, bmi2);
             FSE_flushBits((void**)&op, &bitC);
             nbCatchup--;
         }
@@ -616,13 +845,13 @@ FORCE_INLINE int FSE_compress_usingCTable_generic (void* dest, const unsigned ch
     // nbSymbolsPerLoop (2)
     while (ip>istart)
     {
-        FSE_encodeByte(&state1, &bitC, *--ip, symbolTT, stateTable);
+        FSE_encodeByte_generic(&state1, &bitC, *--ip, symbolTT, stateTable, bmi2);
 
         if (sizeof(size_t)*8 < FSE_MAX_TABLELOG*2+7 )   // this test needs to be static (special case : small size_t, large tablelog)
             FSE_flushBits((void**)&op, &bitC);
 
-        if (ilp) FSE_encodeByte(&state2, &bitC, *--ip, symbolTT, stateTable);
-        else FSE_encodeByte(&state1, &bitC, *--ip, symbolTT, stateTable);
+        if (ilp) FSE_encodeByte_generic(&state2, &bitC, *--ip, symbolTT, stateTable, bmi2);
+        else FSE_encodeByte_generic(&state1, &bitC, *--ip, symbolTT, stateTable, bmi2);
 
         FSE_flushBits((void**)&op, &bitC);
     }
@@ -631,9 +860,24 @@ FORCE_INLINE int FSE_compress_usingCTable_generic (void* dest, const unsigned ch
 }
 
 
+static int FSE_compress_usingCTable_default (void* dest, const unsigned char* source, int sourceSize, const void* CTable)
+{
+    return FSE_compress_usingCTable_generic(dest, source, sourceSize, CTable, FSE_ILP, 0);
+}
+
+#if FSE_DISPATCH
+FSE_TARGET_BMI2 static int FSE_compress_usingCTable_bmi2 (void* dest, const unsigned char* source, int sourceSize, const void* CTable)
+{
+    return FSE_compress_usingCTable_generic(dest, source, sourceSize, CTable, FSE_ILP, 1);
+}
+#endif
+
 int FSE_compress_usingCTable (void* dest, const unsigned char* source, int sourceSize, const void* CTable)
 {
-    return FSE_compress_usingCTable_generic(dest, source, sourceSize, CTable, FSE_ILP);
+#if FSE_DISPATCH
+    if (FSE_cpuBMI2()) return FSE_compress_usingCTable_bmi2(dest, source, sourceSize, CTable);
+#endif
+    return FSE_compress_usingCTable_default(dest, source, sourceSize, CTable);
 }
 
 
@@ -660,12 +904,11 @@ typedef struct
     FSE_symbolCompressionTransform symbolTT[FSE_MAX_NB_SYMBOLS];   // Also used by FSE_compressU16
 } CTable_max_t;
 
-int stats_block_data_bytes;
-int stats_block_overhead_bytes;
-int stats_block_uncompressed_size;
-double stats_block_entropy;
+static FSE_THREAD_LOCAL FSE_blockStats_t FSE_stats;   // one per thread : concurrent compressions do not share them
 
-int FSE_compress2 (void* dest, const unsigned char* source, int sourceSize, int nbSymbols, int tableLog)
+FSE_blockStats_t* FSE_getBlockStats(void) { return &FSE_stats; }
+
+int FSE_compress_spread (void* dest, const unsigned char* source, int sourceSize, int nbSymbols, int tableLog, int spread)
 {
     const BYTE* const istart = (const BYTE*) source;
     const BYTE* ip = istart;
@@ -680,7 +923,7 @@ int FSE_compress2 (void* dest, const unsigned char* source, int sourceSize, int
     // early out
     if (sourceSize <= 1) return FSE_noCompression (ostart, istart, sourceSize);
     if (!nbSymbols) nbSymbols = FSE_MAX_NB_SYMBOLS_CHAR;
-    if (!tableLog) tableLog = FSE_MAX_TABLELOG;
+    if (!tableLog) tableLog = FSE_DEFAULT_TABLELOG;
 
     // Scan input and build symbol stats
     errorCode = FSE_count (counting, ip, sourceSize, nbSymbols);
@@ -691,7 +934,7 @@ int FSE_compress2 (void* dest, const unsigned char* source, int sourceSize, int
     int i;
     for(i=0; i<nbSymbols; i++) {
         if(counting[i] > 0) {
-            stats_block_entropy += log2((double)sourceSize / (double)counting[i]) * counting[i];
+            FSE_stats.entropy += log2((double)sourceSize / (double)counting[i]) * counting[i];
         }
     }
 
@@ -701,19 +944,19 @@ int FSE_compress2 (void* dest, const unsigned char* source, int sourceSize, int
     tableLog = errorCode;
 
     // Write table description header
-    errorCode = FSE_writeHeader (op, counting, nbSymbols, tableLog);
+    errorCode = FSE_writeHeader_spread (op, counting, nbSymbols, tableLog, spread);
     if (errorCode==-1) return -1;
     op += errorCode;
 
-    stats_block_overhead_bytes = op - ostart;
+    FSE_stats.overheadBytes = (int)(op - ostart);
 
     // Compress
-    errorCode = FSE_buildCTable (&CTable, counting, nbSymbols, tableLog);
+    errorCode = FSE_buildCTable_spread (&CTable, counting, nbSymbols, tableLog, spread);
     if (errorCode==-1) return -1;
     op += FSE_compress_usingCTable (op, ip, sourceSize, &CTable);
 
-    stats_block_data_bytes = (int)(op - ostart) - stats_block_overhead_bytes;
-    stats_block_uncompressed_size = sourceSize;
+    FSE_stats.dataBytes = (int)(op - ostart) - FSE_stats.overheadBytes;
+    FSE_stats.uncompressedSize = sourceSize;
 
     // check compressibility
     if ( (op-ostart) >= (sourceSize-1) ) return FSE_noCompression (ostart, istart, sourceSize);
@@ -722,9 +965,14 @@ int FSE_compress2 (void* dest, const unsigned char* source, int sourceSize, int
 }
 
 
+int FSE_compress2 (void* dest, const unsigned char* source, int sourceSize, int nbSymbols, int tableLog)
+{
+    return FSE_compress_spread(dest, source, sourceSize, nbSymbols, tableLog, FSE_spread_step);
+}
+
 int FSE_compress (void* dest, const unsigned char* source, int sourceSize)
 {
-    return FSE_compress2(dest, source, sourceSize, FSE_MAX_NB_SYMBOLS_CHAR, FSE_MAX_TABLELOG);
+    return FSE_compress2(dest, source, sourceSize, FSE_MAX_NB_SYMBOLS_CHAR, FSE_DEFAULT_TABLELOG);
 }
 
 
@@ -741,7 +989,7 @@ typedef struct
 int FSE_sizeof_DTable (int tableLog) { return (int) ( (1<<tableLog) * (int) sizeof (FSE_decode_t) ); }
 
 
-int FSE_buildDTable (void* DTable, const unsigned int* const normalizedCounter, int nbSymbols, int tableLog)
+FORCE_INLINE int FSE_buildDTable_generic (void* DTable, const unsigned int* const normalizedCounter, int nbSymbols, int tableLog, int spread)
 {
     FSE_decode_t* const tableDecode = (FSE_decode_t*) DTable;
     const U32 tableSize = 1 << tableLog;
@@ -755,7 +1003,7 @@ int FSE_buildDTable (void* DTable, const unsigned int* const normalizedCounter,
     if (nbSymbols > FSE_MAX_NB_SYMBOLS_CHAR) return -1;
     if (tableLog > FSE_MAX_TABLELOG) return -1;
 
-    errorCode = FSE_spreadSymbols8(tableSymbolByte, normalizedCounter, nbSymbols, tableLog);
+    errorCode = FSE_spreadSymbols8(tableSymbolByte, normalizedCounter, nbSymbols, tableLog, spread);
     if(errorCode == -1) return -1;
 
     for (position=0; position<tableSize; position++)
@@ -781,6 +1029,31 @@ int FSE_buildDTable (void* DTable, const unsigned int* const normalizedCounter,
     return 0;
 }
 
+static int FSE_buildDTable_default (void* DTable, const unsigned int* const normalizedCounter, int nbSymbols, int tableLog, int spread)
+{
+    return FSE_buildDTable_generic(DTable, normalizedCounter, nbSymbols, tableLog, spread);
+}
+
+#if FSE_DISPATCH
+FSE_TARGET_BMI2 static int FSE_buildDTable_bmi2 (void* DTable, const unsigned int* const normalizedCounter, int nbSymbols, int tableLog, int spread)
+{
+    return FSE_buildDTable_generic(DTable, normalizedCounter, nbSymbols, tableLog, spread);
+}
+#endif
+
+int FSE_buildDTable_spread (void* DTable, const unsigned int* const normalizedCounter, int nbSymbols, int tableLog, int spread)
+{
+#if FSE_DISPATCH
+    if (FSE_cpuBMI2()) return FSE_buildDTable_bmi2(DTable, normalizedCounter, nbSymbols, tableLog, spread);
+#endif
+    return FSE_buildDTable_default(DTable, normalizedCounter, nbSymbols, tableLog, spread);
+}
+
+int FSE_buildDTable (void* DTable, const unsigned int* const normalizedCounter, int nbSymbols, int tableLog)
+{
+    return FSE_buildDTable_spread(DTable, normalizedCounter, nbSymbols, tableLog, FSE_spread_step);
+}
+
 
 int FSE_decompressRaw (void* out, int osize, const BYTE* in)
 {
@@ -813,6 +1086,8 @@ FORCE_INLINE const void* FSE_initDecompressionStream_generic(
     const BYTE* ip = (const BYTE*)*p;
     U32 descriptor;
 
+    if (safe) if (maxCompressedSize < 4) return NULL;
+    if (safe) if ((tableLog < FSE_MIN_TABLELOG) || (tableLog > FSE_MAX_TABLELOG)) return NULL;
     descriptor = * (U32*) ip;
     *nbStates = (descriptor >> 30) + 1;
     descriptor &= 0x3FFFFFFF;
@@ -820,6 +1095,7 @@ FORCE_INLINE const void* FSE_initDecompressionStream_generic(
     descriptor >>= 3;
 
     iend = ip + descriptor;
+    if (safe) if (descriptor < 4 + (U32)((bitC->bitsConsumed + *nbStates*tableLog) >> 3)) return NULL;   // states would be read before stream start
     if (safe) if (iend > ip+maxCompressedSize) return NULL;
     ip = iend - 4;
     bitC->bitContainer = * (U32*) ip;
@@ -877,9 +1153,18 @@ int FSE_closeDecompressionStream(const void* decompressionStreamDescriptor, cons
 }
 
 
+/* Nb of loop iterations which cannot move 'ip' below stream start, each one reading at most 'maxBitsPerIter' bits.
+   Within such a span, safe decoding needs no check. Since symbols usually need fewer bits, spans are recomputed as decoding progresses. */
+FORCE_INLINE int FSE_safeSpan(const void* ip, const void* compressed, const bitContainer_backward_t* bitC, int maxBitsPerIter)
+{
+    const int availableBits = (int)((const BYTE*)ip - (const BYTE*)compressed) * 8 - bitC->bitsConsumed;
+    return availableBits / maxBitsPerIter;
+}
+
+
 FORCE_INLINE int FSE_decompressStreams_usingDTable_generic(
     unsigned char* dest, const int originalSize, const void* compressed, int maxCompressedSize,
-    const void* DTable, const int tableLog, int safe, int nbStates)
+    const void* DTable, const int tableLog, int safe, int nbStates, int prefetch)
 {
     const void* ip = compressed;
     const void* iend;
@@ -901,17 +1186,29 @@ FORCE_INLINE int FSE_decompressStreams_usingDTable_generic(
     olimit = oend - ((originalSize-nbStates) % nbStates);
 
     // Hot loop
-    while( ((safe) && ((op<olimit) && (ip>=compressed)))
-        || ((!safe) && (op<olimit)) )
+    while (op<olimit)
     {
-        if (nbStates==2)
+        BYTE* spanEnd = olimit;
+        if (safe)
         {
-            *op++ = FSE_decodeSymbol(&state2, &bitC, DTable);
-            if (FSE_MAX_TABLELOG*2+7 > sizeof(U32)*8)   // Need this test to be static
-                FSE_updateBitStream(&bitC, &ip);
+            // unchecked span ; near stream start, one checked iteration at a time
+            const int nbIterations = FSE_safeSpan(ip, compressed, &bitC, nbStates*tableLog);
+            if (ip<compressed) break;
+            if (nbIterations < (olimit-op) / nbStates) spanEnd = op + ((nbIterations>1) ? nbIterations : 1) * nbStates;
+        }
+        while (op<spanEnd)
+        {
+            if (nbStates==2)
+            {
+                *op++ = FSE_decodeSymbol(&state2, &bitC, DTable);
+                if (prefetch) FSE_PREFETCH((const FSE_decode_t*)DTable + state2);   // used after state1 is decoded
+                if (FSE_MAX_TABLELOG*2+7 > sizeof(U32)*8)   // Need this test to be static
+                    FSE_updateBitStream(&bitC, &ip);
+            }
+            *op++ = FSE_decodeSymbol(&state1, &bitC, DTable);
+            if (prefetch) FSE_PREFETCH((const FSE_decode_t*)DTable + state1);
+            FSE_updateBitStream(&bitC, &ip);
         }
-        *op++ = FSE_decodeSymbol(&state1, &bitC, DTable);
-        FSE_updateBitStream(&bitC, &ip);
     }
 
     // last bytes
@@ -942,22 +1239,58 @@ FORCE_INLINE int FSE_decompress_usingDTable_generic(
     const void* DTable, const int tableLog, int safe)
 {
     U32 nbStates = FSE_getNbStates(compressed);
+    if ((FSE_MAX_TABLELOG > FSE_PREFETCH_TABLELOG) && (tableLog > FSE_PREFETCH_TABLELOG))   // first test is static : large tables only
+    {
+        if (nbStates==2)
+            return FSE_decompressStreams_usingDTable_generic(dest, originalSize, compressed, maxCompressedSize, DTable, tableLog, safe, 2, 1);
+        if (nbStates==1)
+            return FSE_decompressStreams_usingDTable_generic(dest, originalSize, compressed, maxCompressedSize, DTable, tableLog, safe, 1, 1);
+        return -1;
+    }
     if (nbStates==2)
-        return FSE_decompressStreams_usingDTable_generic(dest, originalSize, compressed, maxCompressedSize, DTable, tableLog, safe, 2);
+        return FSE_decompressStreams_usingDTable_generic(dest, originalSize, compressed, maxCompressedSize, DTable, tableLog, safe, 2, 0);
     if (nbStates==1)
-        return FSE_decompressStreams_usingDTable_generic(dest, originalSize, compressed, maxCompressedSize, DTable, tableLog, safe, 1);
+        return FSE_decompressStreams_usingDTable_generic(dest, originalSize, compressed, maxCompressedSize, DTable, tableLog, safe, 1, 0);
     return -1;   // should not happend
 }
 
-int FSE_decompress_usingDTable (unsigned char* dest, const int originalSize, const void* compressed, const void* DTable, const int tableLog)
+static int FSE_decompress_usingDTable_default (unsigned char* dest, const int originalSize, const void* compressed, const void* DTable, const int tableLog)
 {
     return FSE_decompress_usingDTable_generic(dest, originalSize, compressed, 0, DTable, tableLog, 0);
 }
 
-int FSE_decompress_usingDTable_safe (unsigned char* dest, const int originalSize, const void* compressed, int maxCompressedSize, const void* DTable, const int tableLog)
+static int FSE_decompress_usingDTable_safe_default (unsigned char* dest, const int originalSize, const void* compressed, int maxCompressedSize, const void* DTable, const int tableLog)
+{
+    return FSE_decompress_usingDTable_generic(dest, originalSize, compressed, maxCompressedSize, DTable, tableLog, 1);
+}
+
+#if FSE_DISPATCH
+FSE_TARGET_BMI2 static int FSE_decompress_usingDTable_bmi2 (unsigned char* dest, const int originalSize, const void* compressed, const void* DTable, const int tableLog)
+{
+    return FSE_decompress_usingDTable_generic(dest, originalSize, compressed, 0, DTable, tableLog, 0);
+}
+
+FSE_TARGET_BMI2 static int FSE_decompress_usingDTable_safe_bmi2 (unsigned char* dest, const int originalSize, const void* compressed, int maxCompressedSize, const void* DTable, const int tableLog)
 {
     return FSE_decompress_usingDTable_generic(dest, originalSize, compressed, maxCompressedSize, DTable, tableLog, 1);
 }
+#endif
+
+int FSE_decompress_usingDTable (unsigned char* dest, const int originalSize, const void* compressed, const void* DTable, const int tableLog)
+{
+#if FSE_DISPATCH
+    if (FSE_cpuBMI2()) return FSE_decompress_usingDTable_bmi2(dest, originalSize, compressed, DTable, tableLog);
+#endif
+    return FSE_decompress_usingDTable_default(dest, originalSize, compressed, DTable, tableLog);
+}
+
+int FSE_decompress_usingDTable_safe (unsigned char* dest, const int originalSize, const void* compressed, int maxCompressedSize, const void* DTable, const int tableLog)
+{
+#if FSE_DISPATCH
+    if (FSE_cpuBMI2()) return FSE_decompress_usingDTable_safe_bmi2(dest, originalSize, compressed, maxCompressedSize, DTable, tableLog);
+#endif
+    return FSE_decompress_usingDTable_safe_default(dest, originalSize, compressed, maxCompressedSize, DTable, tableLog);
+}
 
 
 FORCE_INLINE int FSE_decompress_generic (
@@ -971,21 +1304,31 @@ FORCE_INLINE int FSE_decompress_generic (
     BYTE  headerId;
     int nbSymbols;
     int tableLog;
+    int spread;
     int errorCode;
 
     // headerId early outs
-    if ((safe) && (maxCompressedSize<2)) return -1;   // too small input size
+    if ((safe) && (maxCompressedSize<1)) return -1;   // too small input size
     headerId = ip[0] & 3;
-    if (ip[0]==0) return FSE_decompressRaw (dest, originalSize, istart);
-    if (ip[0]==1) return FSE_decompressSingleSymbol (dest, originalSize, istart[1]);
-    if (headerId!=2) return -1;   // unused headerId
+    if (ip[0]==0)
+    {
+        if ((safe) && (maxCompressedSize < originalSize+1)) return -1;
+        return FSE_decompressRaw (dest, originalSize, istart);
+    }
+    if (ip[0]==1)
+    {
+        if ((safe) && (maxCompressedSize < 2)) return -1;
+        return FSE_decompressSingleSymbol (dest, originalSize, istart[1]);
+    }
+    if (headerId<2) return -1;   // unused headerId
 
     // normal FSE decoding mode
-    errorCode = FSE_readHeader (counting, &nbSymbols, &tableLog, istart);
+    errorCode = FSE_readHeader_generic (counting, &nbSymbols, &tableLog, &spread, istart, maxCompressedSize, safe);
     if (errorCode==-1) return -1;
     ip += errorCode;
+    maxCompressedSize -= errorCode;
 
-    errorCode = FSE_buildDTable (DTable, counting, nbSymbols, tableLog);
+    errorCode = FSE_buildDTable_spread (DTable, counting, nbSymbols, tableLog, spread);
     if (errorCode==-1) return -1;
 
     if (safe) errorCode = FSE_decompress_usingDTable_safe (dest, originalSize, ip, maxCompressedSize, DTable, tableLog);
@@ -1010,6 +1353,697 @@ int FSE_decompress_safe (unsigned char* dest, int originalSize,
     return FSE_decompress_generic(dest, originalSize, compressed, maxCompressedSize, 1);
 }
 
+/*********************************************************
+  Decompression by chunks (sink, segments)
+*********************************************************/
+/* Decodes symbols [pos, pos+chunkSize) of a block into 'op'.
+   Chunk boundaries can be anywhere : states interleaving is tracked using 'pos'.
+   return : 0, or -1 if the stream is exhausted before chunk end */
+FORCE_INLINE int FSE_decodeChunk(
+    BYTE* op, const int chunkSize, const int pos, const int originalSize,
+    const void** ipPtr, const void* compressed, bitContainer_backward_t* bitCPtr, U32* state1Ptr, U32* state2Ptr,
+    const void* DTable, const int tableLog, const int nbStates)
+{
+    const int pairEnd = originalSize - nbStates - ((originalSize-nbStates) % nbStates);   // symbols decoded by all states
+    const int decodedEnd = originalSize - nbStates;                                       // followed by cheap last symbols
+    BYTE* const ostart = op;
+    BYTE* const olimit = op + ((pairEnd-pos < 0) ? 0 : (pairEnd-pos < chunkSize) ? pairEnd-pos : chunkSize);
+    BYTE* const oend = op + ((decodedEnd-pos < 0) ? 0 : (decodedEnd-pos < chunkSize) ? decodedEnd-pos : chunkSize);
+    BYTE* const cend = op + chunkSize;
+    BYTE* opairs;
+    const void* ip = *ipPtr;
+    bitContainer_backward_t bitC = *bitCPtr;
+    U32 state1 = *state1Ptr;
+    U32 state2 = *state2Ptr;
+
+    // chunk starting within an interleaved pair : second half
+    if ((nbStates==2) && (pos & 1) && (op<olimit) && (ip>=compressed))
+    {
+        *op++ = FSE_decodeSymbol(&state1, &bitC, DTable);
+        FSE_updateBitStream(&bitC, &ip);
+    }
+
+    // Hot loop
+    opairs = op + ((olimit-op) - ((olimit-op) % nbStates));
+    while ((op<opairs) && (ip>=compressed))
+    {
+        const int nbIterations = FSE_safeSpan(ip, compressed, &bitC, nbStates*tableLog);
+        BYTE* const spanEnd = (nbIterations < (opairs-op) / nbStates) ? op + ((nbIterations>1) ? nbIterations : 1) * nbStates : opairs;
+        while (op<spanEnd)
+        {
+            if (nbStates==2)
+            {
+                *op++ = FSE_decodeSymbol(&state2, &bitC, DTable);
+                if (FSE_MAX_TABLELOG*2+7 > sizeof(U32)*8)   // Need this test to be static
+                    FSE_updateBitStream(&bitC, &ip);
+            }
+            *op++ = FSE_decodeSymbol(&state1, &bitC, DTable);
+            FSE_updateBitStream(&bitC, &ip);
+        }
+    }
+
+    // chunk ending within an interleaved pair : first half
+    if ((nbStates==2) && (op<olimit) && (ip>=compressed))
+    {
+        *op++ = FSE_decodeSymbol(&state2, &bitC, DTable);
+        if (FSE_MAX_TABLELOG*2+7 > sizeof(U32)*8)
+            FSE_updateBitStream(&bitC, &ip);
+    }
+
+    // last bytes
+    while ((op<oend) && (ip>=compressed))
+    {
+        *op++ = FSE_decodeSymbol(&state1, &bitC, DTable);
+        FSE_updateBitStream(&bitC, &ip);
+    }
+    if (op<oend) return -1;   // stream exhausted : corrupted
+
+    // cheap last symbol storage
+    while (op<cend)
+    {
+        if ((nbStates>=2) && (pos + (op-ostart) == originalSize-2)) *op++ = (BYTE)state2;
+        else *op++ = (BYTE)state1;
+    }
+
+    *ipPtr = ip;
+    *bitCPtr = bitC;
+    *state1Ptr = state1;
+    *state2Ptr = state2;
+    return 0;
+}
+
+
+FORCE_INLINE int FSE_decompressStreams_toSink_generic(
+    BYTE* window, int windowSize, const int originalSize, const void* compressed, int maxCompressedSize,
+    const void* DTable, const int tableLog, FSE_sink_t sink, void* opaque, int nbStates)
+{
+    const void* ip = compressed;
+    const void* iend;
+    int pos = 0;
+    bitContainer_backward_t bitC;
+    U32 state1;
+    U32 state2 = 0;
+    U32 state3;   // dummy
+    U32 state4;   // dummy
+
+    // Init
+    iend = FSE_initDecompressionStream_safe(&bitC, &nbStates, &state1, &state2, &state3, &state4, &ip, tableLog, maxCompressedSize);
+    if (iend==NULL) return -1;
+
+    while (pos < originalSize)
+    {
+        const int chunkSize = (originalSize-pos < windowSize) ? originalSize-pos : windowSize;
+        if (FSE_decodeChunk(window, chunkSize, pos, originalSize, &ip, compressed, &bitC, &state1, &state2, DTable, tableLog, nbStates)) return -1;
+        if (pos+chunkSize == originalSize)
+            if ((ip!=compressed) || bitC.bitsConsumed) return -1;   // Not fully decoded stream : don't deliver last chunk
+        if (sink(opaque, window, chunkSize)) return -1;
+        pos += chunkSize;
+    }
+
+    return FSE_closeDecompressionStream(iend, ip);
+}
+
+
+int FSE_decompress_toSink (void* window, int windowSize, int originalSize,
+                           const void* compressed, int maxCompressedSize,
+                           FSE_sink_t sink, void* opaque)
+{
+    const BYTE* const istart = (const BYTE*)compressed;
+    const BYTE* ip = istart;
+    U32   counting[FSE_MAX_NB_SYMBOLS_CHAR];
+    FSE_decode_t DTable[FSE_MAX_TABLESIZE];
+    int nbSymbols;
+    int tableLog;
+    int spread;
+    int errorCode;
+    int pos;
+
+    if ((windowSize < 1) || (maxCompressedSize<1)) return -1;
+
+    // headerId early outs : data is delivered from input (raw) or from a single window fill (single symbol)
+    if (ip[0]==0)
+    {
+        if (maxCompressedSize < originalSize+1) return -1;
+        for (pos=0; pos<originalSize; pos+=windowSize)
+            if (sink(opaque, istart+1+pos, (originalSize-pos < windowSize) ? originalSize-pos : windowSize)) return -1;
+        return originalSize+1;
+    }
+    if (ip[0]==1)
+    {
+        if (maxCompressedSize < 2) return -1;
+        memset(window, istart[1], (originalSize < windowSize) ? originalSize : windowSize);
+        for (pos=0; pos<originalSize; pos+=windowSize)
+            if (sink(opaque, (const BYTE*)window, (originalSize-pos < windowSize) ? originalSize-pos : windowSize)) return -1;
+        return 2;
+    }
+    if ((ip[0]&3)<2) return -1;   // unused headerId
+
+    // normal FSE decoding mode
+    errorCode = FSE_readHeader_spread (counting, &nbSymbols, &tableLog, &spread, istart, maxCompressedSize);
+    if (errorCode==-1) return -1;
+    ip += errorCode;
+    maxCompressedSize -= errorCode;
+
+    errorCode = FSE_buildDTable_spread (DTable, counting, nbSymbols, tableLog, spread);
+    if (errorCode==-1) return -1;
+
+    errorCode = FSE_decompress_usingDTable_toSink (window, windowSize, originalSize, ip, maxCompressedSize, DTable, tableLog, sink, opaque);
+    if (errorCode==-1) return -1;
+    ip += errorCode;
+
+    return (int) (ip-istart);
+}
+
+
+int FSE_decompress_usingDTable_toSink (void* window, int windowSize, int originalSize,
+                                       const void* compressed, int maxCompressedSize,
+                                       const void* DTable, int tableLog, FSE_sink_t sink, void* opaque)
+{
+    if ((windowSize < 1) || (maxCompressedSize < 4)) return -1;
+    if (FSE_getNbStates(compressed)==2)
+        return FSE_decompressStreams_toSink_generic((BYTE*)window, windowSize, originalSize, compressed, maxCompressedSize, DTable, tableLog, sink, opaque, 2);
+    return FSE_decompressStreams_toSink_generic((BYTE*)window, windowSize, originalSize, compressed, maxCompressedSize, DTable, tableLog, sink, opaque, 1);
+}
+
+
+FORCE_INLINE int FSE_decompressStreamsv_generic(
+    const FSE_iovec* dest, const int nbSegments, const int originalSize, const void* compressed, int maxCompressedSize,
+    const void* DTable, const int tableLog, int nbStates)
+{
+    const void* ip = compressed;
+    const void* iend;
+    int pos = 0;
+    int seg;
+    bitContainer_backward_t bitC;
+    U32 state1;
+    U32 state2 = 0;
+    U32 state3;   // dummy
+    U32 state4;   // dummy
+
+    // Init
+    iend = FSE_initDecompressionStream_safe(&bitC, &nbStates, &state1, &state2, &state3, &state4, &ip, tableLog, maxCompressedSize);
+    if (iend==NULL) return -1;
+
+    for (seg=0; seg<nbSegments; seg++)
+    {
+        if (FSE_decodeChunk((BYTE*)dest[seg].ptr, dest[seg].len, pos, originalSize, &ip, compressed, &bitC, &state1, &state2, DTable, tableLog, nbStates)) return -1;
+        pos += dest[seg].len;
+    }
+    if ((ip!=compressed) || bitC.bitsConsumed) return -1;   // Not fully decoded stream
+
+    return FSE_closeDecompressionStream(iend, ip);
+}
+
+
+int FSE_decompressv (const FSE_iovec* dest, int nbSegments, const void* compressed, int maxCompressedSize)
+{
+    const BYTE* const istart = (const BYTE*)compressed;
+    const BYTE* ip = istart;
+    U32   counting[FSE_MAX_NB_SYMBOLS_CHAR];
+    FSE_decode_t DTable[FSE_MAX_TABLESIZE];
+    int nbSymbols;
+    int tableLog;
+    int spread;
+    int errorCode;
+    int originalSize = 0;
+    int seg;
+
+    for (seg=0; seg<nbSegments; seg++)
+    {
+        if (dest[seg].len < 0) return -1;
+        originalSize += dest[seg].len;
+    }
+    if (maxCompressedSize<1) return -1;
+
+    // headerId early outs
+    if (ip[0]==0)
+    {
+        if (maxCompressedSize < originalSize+1) return -1;
+        ip++;
+        for (seg=0; seg<nbSegments; seg++)
+        {
+            memcpy(dest[seg].ptr, ip, dest[seg].len);
+            ip += dest[seg].len;
+        }
+        return originalSize+1;
+    }
+    if (ip[0]==1)
+    {
+        if (maxCompressedSize < 2) return -1;
+        for (seg=0; seg<nbSegments; seg++) memset(dest[seg].ptr, istart[1], dest[seg].len);
+        return 2;
+    }
+    if ((ip[0]&3)<2) return -1;   // unused headerId
+
+    // normal FSE decoding mode
+    errorCode = FSE_readHeader_spread (counting, &nbSymbols, &tableLog, &spread, istart, maxCompressedSize);
+    if (errorCode==-1) return -1;
+    ip += errorCode;
+    maxCompressedSize -= errorCode;
+
+    errorCode = FSE_buildDTable_spread (DTable, counting, nbSymbols, tableLog, spread);
+    if (errorCode==-1) return -1;
+
+    if (FSE_getNbStates(ip)==2)
+        errorCode = FSE_decompressStreamsv_generic(dest, nbSegments, originalSize, ip, maxCompressedSize, DTable, tableLog, 2);
+    else
+        errorCode = FSE_decompressStreamsv_generic(dest, nbSegments, originalSize, ip, maxCompressedSize, DTable, tableLog, 1);
+    if (errorCode==-1) return -1;
+    ip += errorCode;
+
+    return (int) (ip-istart);
+}
+
+
+/*********************************************************
+  Compression of segments
+*********************************************************/
+// Moves to the end of previous non-empty segment
+static const BYTE* FSE_prevSegment(const FSE_iovec* src, int* seg, const BYTE** istart)
+{
+    do { (*seg)--; } while (src[*seg].len == 0);
+    *istart = (const BYTE*)src[*seg].ptr;
+    return *istart + src[*seg].len;
+}
+
+
+/* Same as FSE_compress_usingCTable(), with 'sourceSize' symbols (>= 2) spread across segments.
+   Produces exactly the same bitstream as if segments were contiguous. */
+static int FSE_compressv_usingCTable (void* dest, const FSE_iovec* src, int nbSegments, int sourceSize, const void* CTable)
+{
+    const int ilp = FSE_ILP;
+    const int nbStreams = 1 + ilp;
+    const BYTE* istart = NULL;
+    const BYTE* ip = NULL;
+    int seg = nbSegments;
+    int pos = sourceSize;   // nb of symbols still to encode
+    int nbCatchup;
+
+    BYTE* op = (BYTE*) dest;
+    U32* streamSizePtr;
+    ptrdiff_t state1;
+    ptrdiff_t state2;
+    ptrdiff_t state3;
+    bitContainer_forward_t bitC = {0,0};
+    const void* stateTable;
+    const void* symbolTT;
+
+
+    streamSizePtr = (U32*)FSE_initCompressionStream((void**)&op, &state1, &symbolTT, &stateTable, CTable);
+    state3 = state2 = state1;
+
+    // cheap last symbol storage
+    if (ip==istart) ip = FSE_prevSegment(src, &seg, &istart);
+    state1 += *--ip; pos--;
+    if (ilp)
+    {
+        if (ip==istart) ip = FSE_prevSegment(src, &seg, &istart);
+        state2 += *--ip; pos--;
+    }
+
+    // First symbols
+    nbCatchup = (sourceSize - nbStreams) % 2;
+    while (nbCatchup)
+    {
+        if (ip==istart) ip = FSE_prevSegment(src, &seg, &istart);
+        FSE_encodeByte(&state1, &bitC, *--ip, symbolTT, stateTable);
+        FSE_flushBits((void**)&op, &bitC);
+        pos--;
+        nbCatchup--;
+    }
+
+    // nbSymbolsPerLoop (2), pairs being possibly split across segments
+    while (pos > 0)
+    {
+        const BYTE* ilimit;
+        if (ip==istart) ip = FSE_prevSegment(src, &seg, &istart);
+
+        if (pos & 1)   // segment started within a pair : second half
+        {
+            if (ilp) FSE_encodeByte(&state2, &bitC, *--ip, symbolTT, stateTable);
+            else FSE_encodeByte(&state1, &bitC, *--ip, symbolTT, stateTable);
+            FSE_flushBits((void**)&op, &bitC);
+            pos--;
+            continue;
+        }
+
+        ilimit = ip - ((ip-istart) & ~1);
+        pos -= (int)(ip-ilimit);
+        while (ip>ilimit)
+        {
+            FSE_encodeByte(&state1, &bitC, *--ip, symbolTT, stateTable);
+
+            if (sizeof(size_t)*8 < FSE_MAX_TABLELOG*2+7 )   // this test needs to be static (special case : small size_t, large tablelog)
+                FSE_flushBits((void**)&op, &bitC);
+
+            if (ilp) FSE_encodeByte(&state2, &bitC, *--ip, symbolTT, stateTable);
+            else FSE_encodeByte(&state1, &bitC, *--ip, symbolTT, stateTable);
+
+            FSE_flushBits((void**)&op, &bitC);
+        }
+
+        if (ip>istart)   // segment starts within a pair : first half
+        {
+            FSE_encodeByte(&state1, &bitC, *--ip, symbolTT, stateTable);
+            if (sizeof(size_t)*8 < FSE_MAX_TABLELOG*2+7 )
+                FSE_flushBits((void**)&op, &bitC);
+            pos--;
+        }
+    }
+
+    return FSE_closeCompressionStream(op, &bitC, nbStreams, state1, state2, state3, 0, streamSizePtr, CTable);
+}
+
+
+static int FSE_noCompressionv (BYTE* out, const FSE_iovec* src, int nbSegments, int isize)
+{
+    int seg;
+    *out++=0;     // Header means ==> uncompressed
+    for (seg=0; seg<nbSegments; seg++)
+    {
+        memcpy (out, src[seg].ptr, src[seg].len);
+        out += src[seg].len;
+    }
+    return (isize+1);
+}
+
+
+int FSE_compressv (void* dest, const FSE_iovec* src, int nbSegments)
+{
+    BYTE* const ostart = (BYTE*) dest;
+    BYTE* op = ostart;
+
+    U32   counting[FSE_MAX_NB_SYMBOLS_CHAR] = {0};
+    U32   segCounting[FSE_MAX_NB_SYMBOLS_CHAR];
+    CTable_max_t CTable;
+    int sourceSize = 0;
+    int nbSymbols = 0;
+    int tableLog = FSE_DEFAULT_TABLELOG;
+    BYTE firstSymbol = 0;
+    int errorCode;
+    int seg;
+
+    // Scan input and build symbol stats
+    for (seg=nbSegments-1; seg>=0; seg--)
+    {
+        int s;
+        if (src[seg].len < 0) return -1;
+        if (src[seg].len == 0) continue;
+        errorCode = FSE_count (segCounting, (const BYTE*)src[seg].ptr, src[seg].len, FSE_MAX_NB_SYMBOLS_CHAR);
+        if (errorCode==-1) return -1;
+        for (s=0; s<errorCode; s++) counting[s] += segCounting[s];
+        if (errorCode > nbSymbols) nbSymbols = errorCode;
+        sourceSize += src[seg].len;
+        firstSymbol = *(const BYTE*)src[seg].ptr;
+    }
+
+    // early out
+    if (sourceSize <= 1) return FSE_noCompressionv (ostart, src, nbSegments, sourceSize);
+    if (nbSymbols==1) return FSE_writeSingleChar (ostart, firstSymbol);   // Only 0 is present
+
+    errorCode = FSE_normalizeCount (counting, tableLog, counting, sourceSize, nbSymbols);
+    if (errorCode==-1) return -1;
+    if (errorCode==0) return FSE_writeSingleChar (ostart, firstSymbol);
+    tableLog = errorCode;
+
+    // Write table description header
+    errorCode = FSE_writeHeader (op, counting, nbSymbols, tableLog);
+    if (errorCode==-1) return -1;
+    op += errorCode;
+
+    // Compress
+    errorCode = FSE_buildCTable (&CTable, counting, nbSymbols, tableLog);
+    if (errorCode==-1) return -1;
+    op += FSE_compressv_usingCTable (op, src, nbSegments, sourceSize, &CTable);
+
+    // check compressibility
+    if ( (op-ostart) >= (sourceSize-1) ) return FSE_noCompressionv (ostart, src, nbSegments, sourceSize);
+
+    return (int) (op-ostart);
+}
+
+
+/*********************************************************
+  Low memory engine
+*********************************************************/
+/*
+LMTable is a variable size structure, used by both compression and decompression :
+    U16 tableLog;
+    U16 nbSymbols;
+    U16 cumul[nbSymbols+1];   // first rank of each symbol in spread order; count of 's' is cumul[s+1]-cumul[s]
+    U16 cell[1 << tableLog];  // decoding : symbol (low byte), and its rank among cells of this symbol (high byte)
+States of a symbol are given to its cells in spread order, rather than in table order :
+the cell of a state can then be computed by the encoder ((cumul[s]+rank) * step), which needs no other table.
+A rank must fit into a byte : counts are limited to 256 cells.
+*/
+#define FSE_LOWMEM_COUNT_OFFSET 520   // U32 counts of one-shot functions, after largest cumul[] (4 + 2*257 bytes), aligned
+#define FSE_LOWMEM_MAX_COUNT    256
+
+int FSE_sizeof_LMTable (int nbSymbols, int tableLog)
+{
+    if ((tableLog > FSE_LOWMEM_MAX_TABLELOG) || (nbSymbols > FSE_MAX_NB_SYMBOLS_CHAR)) return 0;
+    return (int)((2 + (nbSymbols+1) + (1<<tableLog)) * sizeof(U16));
+}
+
+int FSE_buildLMTable (void* LMTable, const unsigned int* normalizedCounter, int nbSymbols, int tableLog)
+{
+    U16* const header = (U16*)LMTable;
+    U16* const cumul = header + 2;
+    U16* const cell = cumul + nbSymbols + 1;
+    const U32 tableSize = 1 << tableLog;
+    const U32 tableMask = tableSize - 1;
+    const U32 step = FSE_TABLESTEP(tableSize);
+    U32 position = 0;
+    int s;
+
+    if ((tableLog > FSE_LOWMEM_MAX_TABLELOG) || (tableLog < FSE_MIN_TABLELOG)) return -1;
+    if ((nbSymbols < 1) || (nbSymbols > FSE_MAX_NB_SYMBOLS_CHAR)) return -1;
+    header[0] = (U16)tableLog;
+    header[1] = (U16)nbSymbols;
+
+    // symbol start ranks ; normalizedCounter may overlap cell[] (one-shot functions) : read it first
+    cumul[0] = 0;
+    for (s=0; s<nbSymbols; s++)
+    {
+        if (normalizedCounter[s] > FSE_LOWMEM_MAX_COUNT) return -1;
+        cumul[s+1] = (U16)(cumul[s] + normalizedCounter[s]);
+    }
+    if (cumul[nbSymbols] != tableSize) return -1;
+
+    // spread
+    for (s=0; s<nbSymbols; s++)
+    {
+        const U32 count = cumul[s+1] - cumul[s];
+        U32 rank;
+        for (rank=0; rank<count; rank++)
+        {
+            cell[position] = (U16)(s + (rank<<8));
+            position = (position + step) & tableMask;
+        }
+    }
+
+    return 0;
+}
+
+
+FORCE_INLINE void FSE_encodeByteLowMem(ptrdiff_t* state, bitContainer_forward_t* bitC, BYTE symbol,
+                                       const U16* cumul, int tableLog, U32 step, U32 tableMask)
+{
+    const U32 count = cumul[symbol+1] - cumul[symbol];
+    int nbBitsOut = tableLog - FSE_highbit(count);
+    nbBitsOut -= (U32)(*state >> nbBitsOut) < count;   // [count, 2*count[ is reached with one less bit
+    FSE_addBits(bitC, *state, nbBitsOut);
+    *state = (tableMask+1) + (((cumul[symbol] + (*state >> nbBitsOut) - count) * step) & tableMask);
+}
+
+int FSE_compressLowMem_usingLMTable (void* dest, const unsigned char* source, int sourceSize, const void* LMTable)
+{
+    const U16* const header = (const U16*)LMTable;
+    const U16* const cumul = header + 2;
+    const int tableLog = header[0];
+    const U32 tableSize = 1 << tableLog;
+    const U32 tableMask = tableSize - 1;
+    const U32 step = FSE_TABLESTEP(tableSize);
+    const BYTE* const istart = source;
+    const BYTE* ip = istart + sourceSize;
+    BYTE* op = (BYTE*)dest + 4;   // stream descriptor
+    const int nbStates = (sourceSize >= 2) ? 2 : 1;
+    ptrdiff_t state1 = tableSize;
+    ptrdiff_t state2 = tableSize;
+    bitContainer_forward_t bitC = {0,0};
+
+    if (sourceSize < 1) return -1;
+
+    // cheap last symbol storage (assumption : nbSymbols <= 1<<tableLog)
+    state1 += *--ip;
+    if (nbStates==2) state2 += *--ip;
+
+    if ((ip-istart) & 1)
+    {
+        FSE_encodeByteLowMem(&state1, &bitC, *--ip, cumul, tableLog, step, tableMask);
+        FSE_flushBits((void**)&op, &bitC);
+    }
+    while (ip>istart)
+    {
+        FSE_encodeByteLowMem(&state1, &bitC, *--ip, cumul, tableLog, step, tableMask);
+        FSE_encodeByteLowMem(&state2, &bitC, *--ip, cumul, tableLog, step, tableMask);
+        FSE_flushBits((void**)&op, &bitC);
+    }
+
+    return FSE_closeCompressionStream(op, &bitC, nbStates, state1, state2, 0, 0, dest, LMTable);
+}
+
+int FSE_compressLowMem (void* dest, const unsigned char* source, int sourceSize, int tableLog, void* LMTable)
+{
+    BYTE* const ostart = (BYTE*)dest;
+    BYTE* op = ostart;
+    U32* const counting = (U32*)((BYTE*)LMTable + FSE_LOWMEM_COUNT_OFFSET);   // overwritten by cell[] when building LMTable
+    int nbSymbols = FSE_MAX_NB_SYMBOLS_CHAR;
+    int errorCode;
+    int i;
+
+    // early out
+    if (sourceSize <= 1) return FSE_noCompression (ostart, source, sourceSize);
+    if (!tableLog) tableLog = FSE_LOWMEM_MAX_TABLELOG;
+    if (tableLog > FSE_LOWMEM_MAX_TABLELOG) return -1;
+
+    // stats, and normalization (a symbol beyond FSE_LOWMEM_MAX_COUNT cells needs a smaller table)
+    while (1)
+    {
+        int s;
+        for (s=0; s<FSE_MAX_NB_SYMBOLS_CHAR; s++) counting[s] = 0;
+        for (i=0; i<sourceSize; i++) counting[source[i]]++;
+        while (!counting[nbSymbols-1]) nbSymbols--;
+        if (nbSymbols==1) return FSE_writeSingleChar (ostart, *source);
+
+        errorCode = FSE_normalizeCount (counting, tableLog, counting, sourceSize, nbSymbols);
+        if (errorCode==-1) return -1;
+        if (errorCode==0) return FSE_writeSingleChar (ostart, *source);
+        for (s=0; (s<nbSymbols) && (counting[s] <= FSE_LOWMEM_MAX_COUNT); s++);
+        if (s==nbSymbols) break;
+        if ((1<<(errorCode-1)) <= nbSymbols) return FSE_noCompression (ostart, source, sourceSize);   // a smaller table can't represent all symbols
+        tableLog = errorCode-1;
+    }
+    tableLog = errorCode;
+
+    errorCode = FSE_writeHeader (op, counting, nbSymbols, tableLog);
+    if (errorCode==-1) return -1;
+    op += errorCode;
+
+    // Compress
+    errorCode = FSE_buildLMTable (LMTable, counting, nbSymbols, tableLog);
+    if (errorCode==-1) return -1;
+    op += FSE_compressLowMem_usingLMTable (op, source, sourceSize, LMTable);
+
+    // check compressibility
+    if ( (op-ostart) >= (sourceSize-1) ) return FSE_noCompression (ostart, source, sourceSize);
+
+    return (int) (op-ostart);
+}
+
+
+FORCE_INLINE BYTE FSE_decodeByteLowMem(U32* state, bitContainer_backward_t* bitC, const U16* cumul, const U16* cell, int tableLog)
+{
+    const U32 c = cell[*state];
+    const BYTE symbol = (BYTE)c;
+    const U32 nextState = (U32)(cumul[symbol+1] - cumul[symbol]) + (c >> 8);
+    const int nbBits = tableLog - FSE_highbit(nextState);
+    *state = (nextState << nbBits) - (1<<tableLog) + FSE_readBits(bitC, nbBits);
+    return symbol;
+}
+
+int FSE_decompressLowMem_usingLMTable (unsigned char* dest, int originalSize, const void* compressed, int maxCompressedSize, const void* LMTable)
+{
+    const U16* const header = (const U16*)LMTable;
+    const int tableLog = header[0];
+    const U16* const cumul = header + 2;
+    const U16* const cell = cumul + header[1] + 1;
+    const void* ip = compressed;
+    const void* iend;
+    BYTE* op = dest;
+    BYTE* oend;
+    BYTE* olimit;
+    bitContainer_backward_t bitC;
+    int nbStates;
+    U32 state1, state2, state3, state4;
+
+    iend = FSE_initDecompressionStream_safe(&bitC, &nbStates, &state1, &state2, &state3, &state4, &ip, tableLog, maxCompressedSize);
+    if (iend==NULL) return -1;
+    if ((nbStates > 2) || (originalSize < nbStates)) return -1;
+    oend = op + originalSize - nbStates;
+    olimit = oend - ((originalSize-nbStates) % nbStates);
+
+    // Hot loop : unchecked spans, as FSE_decompress_safe()
+    while (op<olimit)
+    {
+        BYTE* spanEnd = olimit;
+        const int nbIterations = FSE_safeSpan(ip, compressed, &bitC, nbStates*tableLog);
+        if (ip<compressed) break;
+        if (nbIterations < (olimit-op) / nbStates) spanEnd = op + ((nbIterations>1) ? nbIterations : 1) * nbStates;
+        while (op<spanEnd)
+        {
+            if (nbStates==2) *op++ = FSE_decodeByteLowMem(&state2, &bitC, cumul, cell, tableLog);
+            *op++ = FSE_decodeByteLowMem(&state1, &bitC, cumul, cell, tableLog);
+            FSE_updateBitStream(&bitC, &ip);
+        }
+    }
+    if (op<olimit) return -1;   // stream exhausted
+
+    // last bytes
+    while ((op<oend) && (ip>=compressed))
+    {
+        *op++ = FSE_decodeByteLowMem(&state1, &bitC, cumul, cell, tableLog);
+        FSE_updateBitStream(&bitC, &ip);
+    }
+
+    // cheap last symbol storage
+    if (nbStates==2) *op++ = (BYTE)state2;
+    *op++ = (BYTE)state1;
+
+    if ((ip!=compressed) || bitC.bitsConsumed) return -1;   // Not fully decoded stream
+
+    return FSE_closeDecompressionStream(iend, ip);
+}
+
+int FSE_decompressLowMem (unsigned char* dest, int originalSize, const void* compressed, int maxCompressedSize, void* LMTable)
+{
+    const BYTE* const istart = (const BYTE*)compressed;
+    const BYTE* ip = istart;
+    U32* const counting = (U32*)((BYTE*)LMTable + FSE_LOWMEM_COUNT_OFFSET);   // overwritten by cell[] when building LMTable
+    int nbSymbols;
+    int tableLog;
+    int errorCode;
+
+    // headerId early outs
+    if (maxCompressedSize<1) return -1;
+    if (ip[0]==0)
+    {
+        if (maxCompressedSize < originalSize+1) return -1;
+        return FSE_decompressRaw (dest, originalSize, istart);
+    }
+    if (ip[0]==1)
+    {
+        if (maxCompressedSize < 2) return -1;
+        return FSE_decompressSingleSymbol (dest, originalSize, istart[1]);
+    }
+    if ((ip[0]&3)!=2) return -1;
+
+    errorCode = FSE_readHeader_safe (counting, &nbSymbols, &tableLog, istart, maxCompressedSize);
+    if (errorCode==-1) return -1;
+    ip += errorCode;
+    maxCompressedSize -= errorCode;
+
+    errorCode = FSE_buildLMTable (LMTable, counting, nbSymbols, tableLog);
+    if (errorCode==-1) return -1;
+
+    errorCode = FSE_decompressLowMem_usingLMTable (dest, originalSize, ip, maxCompressedSize, LMTable);
+    if (errorCode==-1) return -1;
+    ip += errorCode;
+
+    return (int) (ip-istart);
+}
+
+
 /*********************************************************
   U16 Compression functions
 *********************************************************/
@@ -1221,7 +2255,7 @@ int FSE_compressU16 (void* dest, const unsigned short* source, int sourceSize, i
     // early out
     if (sourceSize <= 1) return FSE_noCompressionU16 (ostart, istart, sourceSize);
     if (!nbSymbols) nbSymbols = FSE_MAX_NB_SYMBOLS;
-    if (!tableLog) tableLog = FSE_MAX_TABLELOG;
+    if (!tableLog) tableLog = FSE_DEFAULT_TABLELOG;
 
     // Scan for stats
     nbSymbols = FSE_countU16 (counting, ip, sourceSize, nbSymbols);
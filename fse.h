@@ -94,23 +94,122 @@ FSE_compress2():
     Both parameters can be defined as '0' to mean : use default value
     The function will then assume that any unsigned char within 'source' has value < nbSymbols.
     note : If this condition is not respected, compressed data will be corrupted !
+    'tableLog' can be up to 12, or up to 15 if fse.c is compiled with a larger FSE_MAX_MEMORY_USAGE (17).
+    Larger tables improve precision for large alphabets; beyond 12, the decoder prefetches its table, which no longer fits L1 cache.
     return : size of compressed data
              or -1 if there is an error
 */
 int FSE_compress2 (void* dest, const unsigned char* source, int sourceSize, int nbSymbols, int tableLog);
 
 
+/*
+FSE_compress_spread():
+    Same as FSE_compress2(), but also selects how symbols are spread within the state table :
+    FSE_spread_step (default, as FSE_compress2()), FSE_spread_sorted (fastest table build, lower ratio),
+    or FSE_spread_precise (closest to entropy, slower table build).
+    The spread is stored into the header (when not default) : all decoding functions follow it.
+    return : size of compressed data
+             or -1 if there is an error
+*/
+typedef enum { FSE_spread_step=0, FSE_spread_sorted=1, FSE_spread_precise=2 } FSE_spread_e;
+#define FSE_NB_SPREADS 3
+int FSE_compress_spread (void* dest, const unsigned char* source, int sourceSize, int nbSymbols, int tableLog, int spread);
+
+
+/*
+FSE_getBlockStats():
+    Statistics of the last block entropy-coded by FSE_compress2() within calling thread :
+    sizes of header ('overheadBytes') and of compressed data, and 'entropy' of source, in bits.
+    'entropy' accumulates from one block to the next : reset it before compressing a block.
+    Each thread has its own statistics (where the compiler supports thread-local storage).
+*/
+typedef struct { int dataBytes; int overheadBytes; int uncompressedSize; double entropy; } FSE_blockStats_t;
+FSE_blockStats_t* FSE_getBlockStats(void);
+
+
 /*
 FSE_decompress_safe():
     Same as FSE_decompress(), but ensures that the decoder never reads beyond compressed + maxCompressedSize.
     note : you don't have to provide the exact compressed size. If you provide more, it's fine too.
     This function is safe against malicious data.
+    Bounds are checked once per span of symbols which cannot exhaust input, so speed is close to FSE_decompress().
     return : size of compressed data
              or -1 if there is an error
 */
 int FSE_decompress_safe (unsigned char* dest, int originalSize, const void* compressed, int maxCompressedSize);
 
 
+/*
+FSE_decompress_toSink():
+    Same as FSE_decompress_safe(), but decoded data is not stored into a destination buffer of size 'originalSize'.
+    It is decoded into 'window', of size 'windowSize', and handed to 'sink' each time 'window' is full.
+    Using a window small enough to stay in cache (typically a few hundred KB, to fit in L2)
+    lets the consumer (hash, writer, parser) process decoded data while it is still hot.
+    Chunks are provided in order; each chunk is 'windowSize' bytes, except the last one.
+    'decoded' may point into 'compressed' (uncompressed blocks) rather than into 'window'.
+    'windowSize' must be >= 1.
+    'sink' must return 0 to continue; any other value interrupts decoding.
+    return : size of compressed data
+             or -1 if there is an error (including sink interruption)
+*/
+typedef int (*FSE_sink_t) (void* opaque, const unsigned char* decoded, int size);
+int FSE_decompress_toSink (void* window, int windowSize, int originalSize,
+                           const void* compressed, int maxCompressedSize,
+                           FSE_sink_t sink, void* opaque);
+
+
+/*
+FSE_compressv():
+    Same as FSE_compress(), but 'source' is provided as 'nbSegments' segments, compressed as one single block.
+    Result is the same as FSE_compress() of the concatenated segments : it can be decoded by FSE_decompress().
+    'dest' must be contiguous, sized to handle worst case situations (see FSE_compressBound()).
+FSE_decompressv():
+    Same as FSE_decompress_safe(), but regenerated data is written into 'nbSegments' segments,
+    which together define 'originalSize'. 'compressed' must be contiguous.
+    Segments can have any size, including 0.
+    return : size of compressed data
+             or -1 if there is an error
+*/
+typedef struct { void* ptr; int len; } FSE_iovec;
+int FSE_compressv  (void* dest, const FSE_iovec* source, int nbSegments);
+int FSE_decompressv(const FSE_iovec* dest, int nbSegments, const void* compressed, int maxCompressedSize);
+
+
+/*
+FSE_compressLowMem():
+    Same as FSE_compress2(), for embedding many encoders and decoders, such as one per connection.
+    'tableLog' is limited to FSE_LOWMEM_MAX_TABLELOG (0 means : this maximum), and nothing is allocated on stack :
+    all tables and statistics use 'LMTable', a caller-provided workspace of FSE_LOWMEM_TABLESIZE bytes, aligned on 4 bytes.
+    Compressed format is specific : it can only be decoded by FSE_decompressLowMem().
+    return : size of compressed data
+             or -1 if there is an error
+FSE_decompressLowMem():
+    Same as FSE_decompress_safe(), using 'LMTable' (FSE_LOWMEM_TABLESIZE bytes, aligned on 4 bytes) instead of stack.
+    return : size of compressed data
+             or -1 if there is an error
+*/
+#define FSE_LOWMEM_MAX_TABLELOG 9
+#define FSE_LOWMEM_TABLESIZE 1544   // largest LMTable (256 symbols, tableLog 9), and one-shot workspace
+int FSE_compressLowMem  (void* dest, const unsigned char* source, int sourceSize, int tableLog, void* LMTable);
+int FSE_decompressLowMem(unsigned char* dest, int originalSize, const void* compressed, int maxCompressedSize, void* LMTable);
+
+/*
+When statistics are known in advance, a single LMTable, built once, serves both directions,
+and one-shot functions are no longer needed : both only read it.
+FSE_sizeof_LMTable() gives its size, at most FSE_LOWMEM_TABLESIZE : 1542 bytes for 256 symbols and tableLog 9.
+FSE_buildLMTable() fills it from normalized counts (see FSE_normalizeCount()), none of which can be > 256.
+    return : 0, or -1 if there is an error
+FSE_compressLowMem_usingLMTable() writes a stream without header, which FSE_decompressLowMem_usingLMTable() decodes.
+    All symbol values within 'source' must be < nbSymbols, and each one must have a non-zero count.
+    return : size of compressed (or read) stream, or -1 if there is an error
+Decoding a symbol takes a few more operations than FSE_decompress(), since its cell stores only its symbol and rank.
+*/
+int FSE_sizeof_LMTable(int nbSymbols, int tableLog);
+int FSE_buildLMTable(void* LMTable, const unsigned int* normalizedCounter, int nbSymbols, int tableLog);
+int FSE_compressLowMem_usingLMTable  (void* dest, const unsigned char* source, int sourceSize, const void* LMTable);
+int FSE_decompressLowMem_usingLMTable(unsigned char* dest, int originalSize, const void* compressed, int maxCompressedSize, const void* LMTable);
+
+
 /* same as previously, but data is presented as a table of unsigned short (2 bytes per symbol).
    All symbol values within input table must be < nbSymbols.
    Maximum allowed 'nbSymbols' value is controlled by constant FSE_MAX_NB_SYMBOLS inside fse.c */
@@ -146,9 +245,11 @@ int FSE_normalizeCount(unsigned int* normalizedCounter, int maxTableLog, unsigne
 
 static inline int FSE_headerBound(int nbSymbols, int tableLog) { (void)tableLog; return nbSymbols ? (nbSymbols*2)+1 : 512; }
 int FSE_writeHeader(void* header, const unsigned int* normalizedCounter, int nbSymbols, int tableLog);
+int FSE_writeHeader_spread(void* header, const unsigned int* normalizedCounter, int nbSymbols, int tableLog, int spread);
 
 int FSE_sizeof_CTable(int nbSymbols, int tableLog);
 int FSE_buildCTable(void* CTable, const unsigned int* normalizedCounter, int nbSymbols, int tableLog);
+int FSE_buildCTable_spread(void* CTable, const unsigned int* normalizedCounter, int nbSymbols, int tableLog, int spread);
 
 int FSE_compress_usingCTable (void* dest, const unsigned char* source, int sourceSize, const void* CTable);
 
@@ -180,6 +281,8 @@ If there is an error, the function will return -1.
 The space required by 'CTable' must be already allocated. Its size is provided by FSE_sizeof_CTable().
 You can then use FSE_buildCTable() to fill 'CTable'.
 In both cases, if there is an error, the function will return -1.
+FSE_writeHeader_spread() and FSE_buildCTable_spread() select a symbol spread (see FSE_compress_spread()) :
+it must be the same for both, and FSE_spread_step is what FSE_writeHeader() and FSE_buildCTable() use.
 
 'CTable' can then be used to compress 'source', with FSE_compress_usingCTable().
 Similar to FSE_count(), the convention is that 'source' is assumed to be a table of char of size 'sourceSize'
@@ -190,11 +293,17 @@ The function returns the size of compressed data (without header), or -1 if fail
 /* *** DECOMPRESSION *** */
 
 int FSE_readHeader (unsigned int* const normalizedCounter, int* nbSymbols, int* tableLog, const void* header);
+int FSE_readHeader_safe (unsigned int* const normalizedCounter, int* nbSymbols, int* tableLog, const void* header, int maxHeaderSize);
+int FSE_readHeader_spread (unsigned int* const normalizedCounter, int* nbSymbols, int* tableLog, int* spread, const void* header, int maxHeaderSize);
 
 int FSE_sizeof_DTable(int tableLog);
 int FSE_buildDTable(void* DTable, const unsigned int* const normalizedCounter, int nbSymbols, int tableLog);
+int FSE_buildDTable_spread(void* DTable, const unsigned int* const normalizedCounter, int nbSymbols, int tableLog, int spread);
 
 int FSE_decompress_usingDTable(unsigned char* dest, const int originalSize, const void* compressed, const void* DTable, const int tableLog);
+int FSE_decompress_usingDTable_safe(unsigned char* dest, const int originalSize, const void* compressed, int maxCompressedSize, const void* DTable, const int tableLog);
+int FSE_decompress_usingDTable_toSink(void* window, int windowSize, int originalSize, const void* compressed, int maxCompressedSize,
+                                      const void* DTable, int tableLog, FSE_sink_t sink, void* opaque);
 
 /*
 The first step is to get the normalized frequency of symbols.
@@ -208,6 +317,13 @@ The following values have special meaning :
 return 2 : there is only a single symbol value. The value is provided into the second byte.
 return 1 : data is uncompressed
 If there is an error, the function will return -1.
+FSE_readHeader_safe() is the same, but never reads beyond header + maxHeaderSize,
+and never writes more than 256 cells into 'normalizedCounter'. It is safe against malicious data.
+Since it reads 4 bytes at a time, it requires the 4 bytes following the header to be readable :
+it fails (-1) if maxHeaderSize is too short, which can be used to detect an incomplete header.
+FSE_readHeader() and FSE_readHeader_safe() fail (-1) on headers written with a spread other than FSE_spread_step.
+FSE_readHeader_spread() is the same as FSE_readHeader_safe(), but accepts any spread, and provides it into 'spread',
+to be given to FSE_buildDTable_spread().
 
 The next step is to create the decompression tables 'DTable' from 'normalizedCounter'.
 This is performed by the function FSE_buildDTable().
@@ -216,6 +332,9 @@ The space required by 'DTable' must be already allocated. Its size is provided b
 'DTable' can then be used to decompress 'compressed', with FSE_decompress_usingDTable().
 FSE_decompress_usingDTable() will regenerate exactly 'originalSize' symbols, as a table of unsigned char.
 The function returns the size of compressed data (without header), or -1 if failed.
+FSE_decompress_usingDTable_safe() and FSE_decompress_usingDTable_toSink() are the same,
+respectively in the manner of FSE_decompress_safe() and FSE_decompress_toSink().
+Since 'DTable' only depends on the header, it can be kept and reused for any block starting with the same header.
 */
 
 
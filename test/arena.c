@@ -0,0 +1,190 @@
+/*
+  arena.c - arena allocator for per-file buffers and tables, for FSE
+  Copyright (C) Yann Collet 2013-2014
+  GPL v2 License
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License along
+  with this program; if not, write to the Free Software Foundation, Inc.,
+  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+  You can contact the author at :
+  - Public forum : https://groups.google.com/forum/#!forum/lz4c
+*/
+/*
+  Note : this is stand-alone program.
+  It is not part of FSE compression library, it is a user program of the FSE library.
+  The license of FSE library is BSD.
+  The license of this program is GPLv2.
+*/
+
+
+//**************************************
+// Compiler Options
+//**************************************
+#if defined(__linux__)
+#  define _GNU_SOURCE             // MAP_ANONYMOUS, madvise
+#endif
+
+
+//**************************************
+// Includes
+//**************************************
+#include <stdlib.h>   // malloc, free
+#include "arena.h"
+
+#if !defined(_WIN32)
+#  include <sys/mman.h>   // mmap, munmap, madvise
+#endif
+#if defined(MAP_ANONYMOUS) && defined(MAP_FAILED)
+#  define ARN_MMAP 1
+#else
+#  define ARN_MMAP 0
+#endif
+
+
+//**************************************
+// Constants
+//**************************************
+#define KB *(1U<<10)
+#define MB *(1U<<20)
+
+#define ARN_MIN_REGION  (256 KB)
+#define ARN_HUGEPAGE    (2 MB)
+
+
+//**************************************
+// Local Parameters
+//**************************************
+static int hugePages = 0;
+
+void ARN_setHugePages(int enabled) { hugePages = enabled; }
+
+
+//**************************************
+// Regions
+//**************************************
+typedef struct ARN_region_s ARN_region;
+struct ARN_region_s
+{
+    ARN_region* next;
+    void*  raw;        // as obtained from system
+    size_t rawSize;
+    char*  start;      // aligned
+    size_t size;
+    size_t used;
+};
+
+struct ARN_arena_s
+{
+    ARN_region* regions;   // current one first
+    size_t totalSize;
+};
+
+static size_t ARN_roundUp(size_t size, size_t alignment) { return (size + (alignment-1)) & ~(alignment-1); }
+
+static ARN_region* ARN_newRegion(size_t size)
+{
+    ARN_region* region = (ARN_region*)malloc(sizeof(ARN_region));
+    const size_t alignment = hugePages ? ARN_HUGEPAGE : ARN_ALIGNMENT;
+    if (region==NULL) return NULL;
+    if (size < ARN_MIN_REGION) size = ARN_MIN_REGION;
+    size = ARN_roundUp(size, alignment);
+    region->rawSize = size + alignment;
+#if ARN_MMAP
+    region->raw = mmap(NULL, region->rawSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (region->raw == MAP_FAILED) region->raw = NULL;
+#else
+    region->raw = malloc(region->rawSize);
+#endif
+    if (region->raw==NULL) { free(region); return NULL; }
+    region->start = (char*)ARN_roundUp((size_t)region->raw, alignment);
+    region->size = size;
+    region->used = 0;
+    region->next = NULL;
+#if ARN_MMAP && defined(MADV_HUGEPAGE)
+    if (hugePages) madvise(region->start, size, MADV_HUGEPAGE);
+#endif
+    return region;
+}
+
+static void ARN_freeRegion(ARN_region* region)
+{
+#if ARN_MMAP
+    munmap(region->raw, region->rawSize);
+#else
+    free(region->raw);
+#endif
+    free(region);
+}
+
+
+//**************************************
+// Arena functions
+//**************************************
+ARN_arena* ARN_create(void)
+{
+    return (ARN_arena*)calloc(1, sizeof(ARN_arena));
+}
+
+void ARN_free(ARN_arena* arena)
+{
+    if (arena==NULL) return;
+    while (arena->regions)
+    {
+        ARN_region* const region = arena->regions;
+        arena->regions = region->next;
+        ARN_freeRegion(region);
+    }
+    free(arena);
+}
+
+void* ARN_alloc(ARN_arena* arena, size_t size)
+{
+    ARN_region* region = arena->regions;
+    void* result;
+    size = ARN_roundUp(size ? size : 1, ARN_ALIGNMENT);
+    if ((region==NULL) || (region->size - region->used < size))
+    {
+        // Regions grow geometrically, so that a file needs few of them
+        size_t regionSize = arena->totalSize;
+        if (regionSize < size) regionSize = size;
+        region = ARN_newRegion(regionSize);
+        if (region==NULL) return NULL;
+        region->next = arena->regions;
+        arena->regions = region;
+        arena->totalSize += region->size;
+    }
+    result = region->start + region->used;
+    region->used += size;
+    return result;
+}
+
+void ARN_reset(ARN_arena* arena)
+{
+    if ((arena->regions!=NULL) && (arena->regions->next!=NULL))
+    {
+        // Merge : next file will fit into a single region
+        const size_t totalSize = arena->totalSize;
+        while (arena->regions)
+        {
+            ARN_region* const region = arena->regions;
+            arena->regions = region->next;
+            ARN_freeRegion(region);
+        }
+        arena->totalSize = 0;
+        arena->regions = ARN_newRegion(totalSize);
+        if (arena->regions) arena->totalSize = arena->regions->size;
+        return;
+    }
+    if (arena->regions) arena->regions->used = 0;
+}
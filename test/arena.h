@@ -0,0 +1,73 @@
+/*
+  arena.h - arena allocator for per-file buffers and tables - header
+  Copyright (C) Yann Collet 2013-2014
+  GPL v2 License
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License along
+  with this program; if not, write to the Free Software Foundation, Inc.,
+  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+  You can contact the author at :
+  - Public forum : https://groups.google.com/forum/#!forum/lz4c
+*/
+#pragma once
+
+#if defined (__cplusplus)
+extern "C" {
+#endif
+
+
+//**************************************
+// Includes
+//**************************************
+#include <stddef.h>   // size_t
+
+
+//**************************************
+// Parameters
+//**************************************
+#define ARN_ALIGNMENT 64   // all allocations start on a cache line
+
+void ARN_setHugePages(int enabled);   // applies to memory mapped afterwards
+/*
+When enabled, arena memory is aligned on 2 MB and advised as huge pages (Linux transparent huge pages),
+which reduces page faults and TLB misses on large buffers. Ignored where not supported.
+*/
+
+
+//**************************************
+// Arena functions
+//**************************************
+typedef struct ARN_arena_s ARN_arena;
+
+ARN_arena* ARN_create(void);
+void       ARN_free  (ARN_arena* arena);
+void*      ARN_alloc (ARN_arena* arena, size_t size);
+void       ARN_reset (ARN_arena* arena);
+/*
+An arena hands out buffers from large regions, by bumping a pointer. Buffers are never freed one by one :
+ARN_reset() releases all of them at once, typically before processing next file.
+Memory is kept from one file to the next, hence pages are faulted only once.
+An arena is meant to be used by a single thread.
+ARN_create():
+    return : NULL if allocation fails
+ARN_alloc():
+    return : a buffer of 'size' bytes, aligned on ARN_ALIGNMENT, or NULL if memory cannot be obtained
+ARN_reset():
+    If previous file needed several regions, they are merged into a single one, large enough for all of them.
+*/
+
+
+#if defined (__cplusplus)
+}
+#endif
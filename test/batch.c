@@ -0,0 +1,940 @@
+/*
+  batch.c - parallel processing of multiple files, for FSE
+  Copyright (C) Yann Collet 2013-2014
+  GPL v2 License
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License along
+  with this program; if not, write to the Free Software Foundation, Inc.,
+  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+  You can contact the author at :
+  - Public forum : https://groups.google.com/forum/#!forum/lz4c
+*/
+/*
+  Note : this is stand-alone program.
+  It is not part of FSE compression library, it is a user program of the FSE library.
+  The license of FSE library is BSD.
+  The license of this program is GPLv2.
+*/
+
+
+//**************************************
+// Compiler Options
+//**************************************
+#define _POSIX_C_SOURCE 200809L   // lstat, pread, clock_gettime
+#define _FILE_OFFSET_BITS 64      // Large file support on 32-bits unix
+
+
+//**************************************
+// Includes
+//**************************************
+#include <stdio.h>    // fprintf, fopen, fread
+#include <stdlib.h>   // malloc, realloc, qsort
+#include <string.h>   // memcpy, strlen
+#include "batch.h"
+#include "fileio.h"
+#include "membudget.h"
+#include "arena.h"
+#include "scheduler.h"
+#include "xxhash.h"
+
+
+//**************************************
+// Basic Types
+//**************************************
+#if defined (__STDC_VERSION__) && __STDC_VERSION__ >= 199901L   // C99
+# include <stdint.h>
+typedef uint8_t  BYTE;
+typedef uint32_t U32;
+typedef uint64_t U64;
+#else
+typedef unsigned char       BYTE;
+typedef unsigned int        U32;
+typedef unsigned long long  U64;
+#endif
+
+
+//**************************************
+// Constants
+//**************************************
+#define KB *(1U<<10)
+#define MB *(1U<<20)
+#define GB *(1U<<30)
+
+#define FSE_EXTENSION     ".fse"
+#define BAT_CHUNKSIZE     (8 MB)   // larger files are cut into chunks of this size (at most)
+#define BAT_MAX_INFLIGHT  64       // max nb of chunks of a file being processed or waiting to be written
+#define BAT_MIN_BUDGET_CHUNKS 4    // chunk size is reduced until budget holds at least this nb of chunks per core
+#define FSE_CHECKSUM_SEED 0
+
+
+//**************************************
+// Macros
+//**************************************
+#define DISPLAY(...)         fprintf(stderr, __VA_ARGS__)
+#define DISPLAYLEVEL(l, ...) if (displayLevel>=l) { DISPLAY(__VA_ARGS__); }
+
+
+//**************************************
+// Local Parameters
+//**************************************
+static int displayLevel = 2;   // 0 : no display  // 1: errors  // 2 : + result + interaction + warnings ;  // 3 : + progression;  // 4 : + information
+static int overwrite = 0;
+
+
+//**************************************
+// Exceptions
+//**************************************
+#define EXM_THROW(error, ...)                                             \
+{                                                                         \
+    DISPLAYLEVEL(1, "Error %i : ", error);                                \
+    DISPLAYLEVEL(1, __VA_ARGS__);                                         \
+    DISPLAYLEVEL(1, "\n");                                                \
+    exit(error);                                                          \
+}
+
+
+//**************************************
+// Parameters
+//**************************************
+void BAT_overwriteMode(void) { overwrite = 1; }
+
+
+#if defined(_WIN32)
+
+// No thread pool nor directory exploration : files are processed one after another
+int BAT_processFiles(char** fileNames, int nbFiles, int decode, int recursive, int testMode)
+{
+    int i;
+    if (recursive) { DISPLAYLEVEL(1, "Recursive mode is not supported on this platform\n"); return 1; }
+    for (i=0; i<nbFiles; i++)
+    {
+        size_t l = strlen(fileNames[i]);
+        char* outName = (char*)calloc(1, l+5);
+        if (outName==NULL) EXM_THROW(80, "Allocation error : not enough memory");
+        strcpy(outName, fileNames[i]);
+        if (!decode) strcpy(outName+l, FSE_EXTENSION);
+        else if ((l>4) && !strcmp(fileNames[i]+l-4, FSE_EXTENSION)) outName[l-4]=0;
+        else { DISPLAYLEVEL(2, "%s : unknown suffix -- ignored\n", fileNames[i]); free(outName); continue; }
+        if (decode) decompress_file(testMode ? nulmark : outName, fileNames[i]);
+        else compress_file(outName, fileNames[i]);
+        free(outName);
+    }
+    return 0;
+}
+
+#else
+
+#include <pthread.h>
+#include <time.h>        // clock_gettime
+#include <unistd.h>      // pread
+#include <dirent.h>      // opendir, readdir
+#include <sys/stat.h>    // stat, lstat, fstat
+
+
+//**************************************
+// File list
+//**************************************
+typedef struct
+{
+    char* inName;
+    char* outName;
+    U64   size;
+    void* batch;
+} BAT_file_t;
+
+typedef struct
+{
+    BAT_file_t* files;
+    size_t nbFiles;
+    size_t capacity;
+    int    nbSkipped;
+} BAT_fileList_t;
+
+static int BAT_hasExtension(const char* name)
+{
+    size_t l = strlen(name);
+    return (l>4) && !strcmp(name+l-4, FSE_EXTENSION);
+}
+
+static void BAT_addFile(BAT_fileList_t* list, const char* name, U64 size, int decode, int testMode)
+{
+    size_t l = strlen(name);
+    BAT_file_t* file;
+
+    if (decode != BAT_hasExtension(name))
+    {
+        DISPLAYLEVEL(2, "%s : %s -- ignored\n", name, decode ? "unknown suffix" : "already has " FSE_EXTENSION " suffix");
+        list->nbSkipped++;
+        return;
+    }
+
+    if (list->nbFiles == list->capacity)
+    {
+        list->capacity = list->capacity ? list->capacity*2 : 64;
+        list->files = (BAT_file_t*)realloc(list->files, list->capacity * sizeof(BAT_file_t));
+        if (list->files==NULL) EXM_THROW(80, "Allocation error : not enough memory");
+    }
+    file = list->files + list->nbFiles;
+    file->size = size;
+    file->inName  = (char*)malloc(l+1);
+    file->outName = (char*)malloc(l+5 + sizeof(nulmark));
+    if ((file->inName==NULL) || (file->outName==NULL)) EXM_THROW(80, "Allocation error : not enough memory");
+    strcpy(file->inName, name);
+    strcpy(file->outName, name);
+    if (decode) file->outName[l-4] = 0;
+    else strcpy(file->outName+l, FSE_EXTENSION);
+
+    // Workers cannot ask for confirmation
+    if (testMode) strcpy(file->outName, nulmark);
+    else if (!overwrite)
+    {
+        struct stat st;
+        if (stat(file->outName, &st)==0)
+        {
+            DISPLAYLEVEL(2, "%s already exists -- skipped (use -f to overwrite)\n", file->outName);
+            free(file->inName);
+            free(file->outName);
+            list->nbSkipped++;
+            return;
+        }
+    }
+
+    list->nbFiles++;
+}
+
+static void BAT_collectFiles(BAT_fileList_t* list, const char* path, int recursive, int explicitName, int decode, int testMode)
+{
+    struct stat st;
+    int statError = explicitName ? stat(path, &st) : lstat(path, &st);   // links are followed only when explicitly named
+
+    if (statError) { DISPLAYLEVEL(1, "%s : cannot access\n", path); list->nbSkipped++; return; }
+
+    if (S_ISREG(st.st_mode)) { BAT_addFile(list, path, (U64)st.st_size, decode, testMode); return; }
+
+    if (S_ISDIR(st.st_mode) && recursive)
+    {
+        DIR* dir = opendir(path);
+        struct dirent* entry;
+        size_t pathLength = strlen(path);
+        if (dir==NULL) { DISPLAYLEVEL(1, "%s : cannot open directory\n", path); list->nbSkipped++; return; }
+        while ((entry = readdir(dir)) != NULL)
+        {
+            char* name;
+            if (!strcmp(entry->d_name, ".") || !strcmp(entry->d_name, "..")) continue;
+            name = (char*)malloc(pathLength + strlen(entry->d_name) + 2);
+            if (name==NULL) EXM_THROW(80, "Allocation error : not enough memory");
+            strcpy(name, path);
+            if ((pathLength==0) || (path[pathLength-1] != '/')) strcat(name, "/");
+            strcat(name, entry->d_name);
+            BAT_collectFiles(list, name, recursive, 0, decode, testMode);
+            free(name);
+        }
+        closedir(dir);
+        return;
+    }
+
+    DISPLAYLEVEL(2, "%s : %s -- ignored\n", path, S_ISDIR(st.st_mode) ? "is a directory" : "not a regular file");
+    list->nbSkipped++;
+}
+
+static int BAT_compareSize(const void* a, const void* b)
+{
+    U64 sizeA = ((const BAT_file_t*)a)->size;
+    U64 sizeB = ((const BAT_file_t*)b)->size;
+    return (sizeA > sizeB) - (sizeA < sizeB);
+}
+
+
+//**************************************
+// Batch context
+//**************************************
+typedef struct BAT_chunk_s BAT_chunk_t;
+typedef struct BAT_buffers_s BAT_buffers_t;
+
+// Buffers for whole files, one arena per thread of the pool, reset before next file
+typedef struct
+{
+    ARN_arena*   arena;
+    BYTE*        inBuff;
+    BYTE*        outBuff;
+    FSE_DStream* dstream;
+    FILE*        dstreamOutput;
+    U64          dstreamWritten;
+} BAT_context_t;
+
+typedef struct
+{
+    int             decode;
+    size_t          chunkSize;
+    int             maxInFlight;
+    BAT_context_t*  contexts;
+    SCH_group*      group;
+    pthread_mutex_t mutex;
+    BAT_chunk_t*    freeChunks;   // chunk descriptors, reused from one file to the next
+    BAT_buffers_t** freeBuffers;  // chunk buffers, one list per NUMA node, reused from one file to the next
+    int             nbNodes;
+    int             nbErrors;
+    U64             totalIn;
+    U64             totalOut;
+    U64*            nodeBytes;    // source bytes processed by threads of each node
+} BAT_batch_t;
+
+static BAT_batch_t* BAT_getBatch(const BAT_file_t* file) { return (BAT_batch_t*)file->batch; }
+
+// Memory used by a chunk, or by whole-file buffers of a thread
+static size_t BAT_chunkCost(size_t chunkSize) { return chunkSize + FIO_compressFrameBound(chunkSize); }
+
+
+//**************************************
+// Helper functions
+//**************************************
+// Grows a buffer when needed; its content is not preserved. Buffer is never NULL, even for size 0.
+// return : 0, or an error code
+static int BAT_reserve(BYTE** buffer, size_t* capacity, size_t size)
+{
+    if (size==0) size=1;
+    if (*capacity >= size) return 0;
+    free(*buffer);
+    *buffer = (BYTE*)malloc(size);
+    *capacity = (*buffer==NULL) ? 0 : size;
+    return (*buffer==NULL) ? 80 : 0;
+}
+
+static int BAT_write(const void* buffer, size_t size, FILE* foutput)
+{
+    return (fwrite(buffer, 1, size, foutput) != size) ? 82 : 0;
+}
+
+static int BAT_currentNode(const BAT_batch_t* batch)
+{
+    int node = SCH_workerNode(SCH_workerId());
+    return (node < batch->nbNodes) ? node : 0;
+}
+
+static void BAT_addNodeStats(BAT_batch_t* batch, U64 srcSize)
+{
+    pthread_mutex_lock(&batch->mutex);
+    batch->nodeBytes[BAT_currentNode(batch)] += srcSize;
+    pthread_mutex_unlock(&batch->mutex);
+}
+
+static void BAT_addStats(const BAT_file_t* file, U64 inSize, U64 outSize)
+{
+    BAT_batch_t* const batch = BAT_getBatch(file);
+    pthread_mutex_lock(&batch->mutex);
+    batch->totalIn  += inSize;
+    batch->totalOut += outSize;
+    pthread_mutex_unlock(&batch->mutex);
+    DISPLAYLEVEL(3, "%s : %llu => %llu bytes\n", file->inName, (unsigned long long)inSize, (unsigned long long)outSize);
+}
+
+static const char* BAT_errorString(int errorCode)
+{
+    switch(errorCode)
+    {
+    case 80: return "not enough memory";
+    case 81: return "cannot open output file";
+    case 82: return "write error";
+    case 83: return "cannot open input file";
+    case 84: return "read error";
+    case 85: return "unexpected end of file";
+    case 86: return "corrupted data";
+    case 87: return "unrecognised header";
+    case 88: return "wrong checksum, corrupted data";
+    case 89: return "compression error";
+    default: return "unknown error";
+    }
+}
+
+// An error stops current file only : other files are still processed
+static void BAT_fileError(const BAT_file_t* file, int errorCode)
+{
+    BAT_batch_t* const batch = BAT_getBatch(file);
+    pthread_mutex_lock(&batch->mutex);
+    batch->nbErrors++;
+    pthread_mutex_unlock(&batch->mutex);
+    DISPLAYLEVEL(1, "Error %i : %s : %s\n", errorCode, file->inName, BAT_errorString(errorCode));
+}
+
+// Removes an incomplete output file, once closed
+static void BAT_removeOutput(const BAT_file_t* file)
+{
+    if (strcmp(file->outName, nulmark)) remove(file->outName);
+}
+
+
+//**************************************
+// Whole files
+//**************************************
+// Resets context arena, then loads file into context->inBuff; return : 0, or an error code
+static int BAT_loadFile(BAT_context_t* context, const BAT_file_t* file, size_t* sizePtr)
+{
+    FILE* finput = fopen(file->inName, "rb");
+    size_t size = 0;
+    size_t capacity = (size_t)file->size + 1;
+    int errorCode = 0;
+    if (finput==NULL) return 83;
+    if (context->arena==NULL) context->arena = ARN_create();   // created, hence first touched, by its own thread
+    if (context->arena==NULL) { fclose(finput); return 80; }
+    ARN_reset(context->arena);
+    context->inBuff = (BYTE*)ARN_alloc(context->arena, capacity);
+    if (context->inBuff==NULL) errorCode = 80;
+    while (!errorCode)
+    {
+        size += fread(context->inBuff + size, 1, capacity - size, finput);
+        if (ferror(finput)) { errorCode = 84; break; }
+        if (size < capacity) break;
+        // file has grown since exploration
+        {
+            BYTE* newBuff = (BYTE*)ARN_alloc(context->arena, capacity * 2);
+            if (newBuff==NULL) { errorCode = 80; break; }
+            memcpy(newBuff, context->inBuff, size);
+            context->inBuff = newBuff;
+            capacity *= 2;
+        }
+    }
+    fclose(finput);
+    *sizePtr = size;
+    return errorCode;
+}
+
+static int BAT_compressWholeFile(BAT_context_t* context, const BAT_file_t* file)
+{
+    size_t inSize, outSize;
+    FILE* foutput;
+    int errorCode = BAT_loadFile(context, file, &inSize);
+
+    if (errorCode) return errorCode;
+    context->outBuff = (BYTE*)ARN_alloc(context->arena, FIO_compressFrameBound(inSize));
+    if (context->outBuff==NULL) return 80;
+    outSize = FIO_compressFrame(context->outBuff, context->inBuff, inSize);
+    if (outSize==FIO_ERROR) return 89;
+    foutput = fopen(file->outName, "wb");
+    if (foutput==NULL) return 81;
+    errorCode = BAT_write(context->outBuff, outSize, foutput);
+    fclose(foutput);
+    if (errorCode) { BAT_removeOutput(file); return errorCode; }
+    BAT_addNodeStats(BAT_getBatch(file), inSize);
+    BAT_addStats(file, inSize, outSize);
+    return 0;
+}
+
+// FSE_DStream output
+static int BAT_writeDecoded(void* opaque, const void* decoded, size_t size)
+{
+    BAT_context_t* const context = (BAT_context_t*)opaque;
+    context->dstreamWritten += size;
+    return fwrite(decoded, 1, size, context->dstreamOutput) != size;
+}
+
+static int BAT_decodeWholeFile(BAT_context_t* context, const BAT_file_t* file)
+{
+    size_t inSize;
+    int result;
+    int errorCode = BAT_loadFile(context, file, &inSize);
+
+    if (errorCode) return errorCode;
+    if (context->dstream==NULL) context->dstream = FSE_createDStream(BAT_writeDecoded, context);
+    if (context->dstream==NULL) return 80;
+    FSE_resetDStream(context->dstream);
+    context->dstreamOutput = fopen(file->outName, "wb");
+    if (context->dstreamOutput==NULL) return 81;
+    context->dstreamWritten = 0;
+    result = FSE_DStream_update(context->dstream, context->inBuff, inSize);
+    fclose(context->dstreamOutput);
+    if (result!=0) BAT_removeOutput(file);
+    if (result==1) return 85;
+    if (result!=0) return 86;   // or write error
+    BAT_addNodeStats(BAT_getBatch(file), inSize);
+    BAT_addStats(file, inSize, context->dstreamWritten);
+    return 0;
+}
+
+
+//**************************************
+// Large files : chunks
+//**************************************
+typedef struct BAT_job_s BAT_job_t;
+
+// Acquired by the thread processing the chunk, from the list of its own node, so that they stay local to it
+struct BAT_buffers_s
+{
+    BAT_buffers_t* next;    // free list
+    int          node;
+    BYTE*        inBuff;    // compression source
+    size_t       inCapacity;
+    BYTE*        outBuff;
+    size_t       outCapacity;
+};
+
+struct BAT_chunk_s
+{
+    BAT_chunk_t* next;      // free list
+    BAT_job_t*   job;
+    int          last;
+    int          done;
+    size_t       charge;    // memory budget reserved for this chunk
+    U64          offset;    // compression source, within input file
+    size_t       inSize;
+    size_t       outSize;
+    BAT_buffers_t* buffers;
+    FIO_frameSegment segment;   // decompression source, read in order by the thread issuing chunks
+};
+
+struct BAT_job_s
+{
+    const BAT_file_t* file;
+    BAT_batch_t*    batch;
+    SCH_group*      group;      // chunks of this file
+    FILE*           finput;
+    FILE*           foutput;
+    int             blockSizeId;
+    pthread_mutex_t mutex;
+    pthread_cond_t  chunkRun;   // a chunk has been run, and written if it was next
+    SCH_function    function;   // runs one chunk
+    BAT_chunk_t*    slots[BAT_MAX_INFLIGHT];   // chunk i is in slot i % BAT_MAX_INFLIGHT until written
+    U64             nbIssued;
+    U64             nbStarted;
+    U64             nbWritten;
+    int             writing;
+    U64             outSize;
+    XXH32_stateSpace_t hashState;   // of uncompressed data, in order
+};
+
+static BAT_chunk_t* BAT_getChunk(BAT_batch_t* batch)
+{
+    BAT_chunk_t* chunk;
+    pthread_mutex_lock(&batch->mutex);
+    chunk = batch->freeChunks;
+    if (chunk) batch->freeChunks = chunk->next;
+    pthread_mutex_unlock(&batch->mutex);
+    if (chunk==NULL) chunk = (BAT_chunk_t*)calloc(1, sizeof(BAT_chunk_t));
+    if (chunk) chunk->done = 0;
+    return chunk;
+}
+
+static BAT_buffers_t* BAT_getBuffers(BAT_batch_t* batch)
+{
+    const int node = BAT_currentNode(batch);
+    BAT_buffers_t* buffers;
+    pthread_mutex_lock(&batch->mutex);
+    buffers = batch->freeBuffers[node];
+    if (buffers) batch->freeBuffers[node] = buffers->next;
+    pthread_mutex_unlock(&batch->mutex);
+    if (buffers==NULL) buffers = (BAT_buffers_t*)calloc(1, sizeof(BAT_buffers_t));
+    if (buffers) buffers->node = node;
+    return buffers;
+}
+
+static void BAT_releaseChunk(BAT_batch_t* batch, BAT_chunk_t* chunk)
+{
+    BAT_buffers_t* const buffers = chunk->buffers;
+    chunk->buffers = NULL;
+    if (chunk->charge) MEM_release(chunk->charge);
+    chunk->charge = 0;
+    pthread_mutex_lock(&batch->mutex);
+    if (buffers)
+    {
+        buffers->next = batch->freeBuffers[buffers->node];
+        batch->freeBuffers[buffers->node] = buffers;
+    }
+    chunk->next = batch->freeChunks;
+    batch->freeChunks = chunk;
+    pthread_mutex_unlock(&batch->mutex);
+}
+
+// Chunks are written in order, by the thread completing the next one to write
+static int BAT_chunkDone(BAT_chunk_t* chunk)
+{
+    BAT_job_t* const job = chunk->job;
+    int errorCode = 0;
+    pthread_mutex_lock(&job->mutex);
+    chunk->done = 1;
+    if (!job->writing)
+    {
+        job->writing = 1;
+        while (!errorCode)
+        {
+            BAT_chunk_t* const next = job->slots[job->nbWritten % BAT_MAX_INFLIGHT];
+            size_t outSize;
+            if ((next==NULL) || (!next->done)) break;
+            job->slots[job->nbWritten % BAT_MAX_INFLIGHT] = NULL;
+            pthread_mutex_unlock(&job->mutex);
+
+            errorCode = BAT_write(next->buffers->outBuff, next->outSize, job->foutput);
+            if (job->batch->decode) XXH32_update(&job->hashState, next->buffers->outBuff, (int)next->outSize);
+            else XXH32_update(&job->hashState, next->buffers->inBuff, (int)next->inSize);
+            outSize = next->outSize;
+            BAT_releaseChunk(job->batch, next);   // from now on, may be reused by another job
+
+            pthread_mutex_lock(&job->mutex);
+            job->outSize += outSize;
+            job->nbWritten++;
+        }
+        job->writing = 0;
+    }
+    pthread_mutex_unlock(&job->mutex);
+    return errorCode;
+}
+
+// Source is read by the compressing thread itself, hence lands in memory local to it
+static int BAT_compressChunk(void* arg)
+{
+    BAT_chunk_t* const chunk = (BAT_chunk_t*)arg;
+    BAT_batch_t* const batch = chunk->job->batch;
+    const int fd = fileno(chunk->job->finput);
+    BAT_buffers_t* buffers;
+    size_t readSize = 0;
+
+    buffers = chunk->buffers = BAT_getBuffers(batch);   // released with chunk, even on error
+    if (buffers==NULL) return 80;
+    if (BAT_reserve(&buffers->inBuff, &buffers->inCapacity, batch->chunkSize)) return 80;
+    if (BAT_reserve(&buffers->outBuff, &buffers->outCapacity, FIO_compressFrameBound(batch->chunkSize))) return 80;
+    while (readSize < chunk->inSize)
+    {
+        ssize_t r = pread(fd, buffers->inBuff + readSize, chunk->inSize - readSize, (off_t)(chunk->offset + readSize));
+        if (r<0) return 84;
+        if (r==0) return 85;   // file has shrunk
+        readSize += (size_t)r;
+    }
+    chunk->outSize = FIO_compressFrameSegment(buffers->outBuff, buffers->inBuff, chunk->inSize, chunk->last);
+    if (chunk->outSize==FIO_ERROR) return 89;
+    BAT_addNodeStats(batch, chunk->inSize);
+    return BAT_chunkDone(chunk);
+}
+
+static int BAT_decodeChunk(void* arg)
+{
+    BAT_chunk_t* const chunk = (BAT_chunk_t*)arg;
+    BAT_buffers_t* buffers;
+
+    buffers = chunk->buffers = BAT_getBuffers(chunk->job->batch);
+    if (buffers==NULL) return 80;
+    chunk->outSize = (size_t)chunk->segment.decodedSize;
+    if (BAT_reserve(&buffers->outBuff, &buffers->outCapacity, chunk->outSize)) return 80;
+    if (FIO_decodeFrameSegment(buffers->outBuff, &chunk->segment, chunk->job->blockSizeId)) return 86;
+    BAT_addNodeStats(chunk->job->batch, chunk->segment.size);
+    return BAT_chunkDone(chunk);
+}
+
+// Task of a job : runs its oldest chunk not started yet, whichever task this is.
+// Hence next chunk to write is never left behind newer ones, as would happen when its owner pops newest tasks first.
+static int BAT_runChunk(void* arg)
+{
+    BAT_job_t* const job = (BAT_job_t*)arg;
+    BAT_chunk_t* chunk = NULL;
+    int errorCode;
+    pthread_mutex_lock(&job->mutex);
+    if (job->nbStarted < job->nbIssued) chunk = job->slots[job->nbStarted++ % BAT_MAX_INFLIGHT];
+    pthread_mutex_unlock(&job->mutex);
+    if (chunk==NULL) return 0;   // already run by the issuing thread
+    errorCode = job->function(chunk);
+    if (errorCode) SCH_cancel(job->group, errorCode);   // before waking the issuing thread, which checks it
+    pthread_mutex_lock(&job->mutex);
+    pthread_cond_broadcast(&job->chunkRun);
+    pthread_mutex_unlock(&job->mutex);
+    return errorCode;
+}
+
+// Blocks while memory budget is exhausted, or too many chunks are in flight (issued, but not written yet).
+// While waiting, the issuing thread runs chunks of its job, oldest first.
+// return : 0, or an error code which cancelled the job
+static int BAT_issueChunk(BAT_job_t* job, BAT_chunk_t* chunk, size_t charge)
+{
+    int errorCode = 0;
+    MEM_acquire(charge);
+    chunk->charge = charge;
+    chunk->job = job;
+    pthread_mutex_lock(&job->mutex);
+    job->slots[job->nbIssued % BAT_MAX_INFLIGHT] = chunk;   // free : less than maxInFlight chunks were unwritten
+    job->nbIssued++;
+    pthread_mutex_unlock(&job->mutex);
+    if (SCH_submit(job->group, BAT_runChunk, job)) { SCH_cancel(job->group, 80); return 80; }
+
+    pthread_mutex_lock(&job->mutex);
+    while (job->nbIssued - job->nbWritten >= (U64)job->batch->maxInFlight)
+    {
+        errorCode = SCH_isCancelled(job->group);
+        if (errorCode) break;
+        if (job->nbStarted < job->nbIssued)
+        {
+            pthread_mutex_unlock(&job->mutex);
+            BAT_runChunk(job);
+            pthread_mutex_lock(&job->mutex);
+            continue;
+        }
+        pthread_cond_wait(&job->chunkRun, &job->mutex);   // all chunks in flight are running on other threads
+    }
+    pthread_mutex_unlock(&job->mutex);
+    return errorCode;
+}
+
+static int BAT_initJob(BAT_job_t* job, const BAT_file_t* file)
+{
+    memset(job, 0, sizeof(*job));
+    job->file = file;
+    job->batch = BAT_getBatch(file);
+    pthread_mutex_init(&job->mutex, NULL);
+    pthread_cond_init(&job->chunkRun, NULL);
+    XXH32_resetState(&job->hashState, FSE_CHECKSUM_SEED);
+    job->group = SCH_createGroup(job->batch->group);
+    if (job->group==NULL) return 80;
+    job->finput = fopen(file->inName, "rb");
+    if (job->finput==NULL) return 83;
+    job->foutput = fopen(file->outName, "wb");
+    if (job->foutput==NULL) return 81;
+    return 0;
+}
+
+// Waits for all chunks (cancelled ones are skipped), then releases what remains
+static int BAT_endJob(BAT_job_t* job, int errorCode, U64 inSize)
+{
+    int i;
+    if (job->group)
+    {
+        if (errorCode) SCH_cancel(job->group, errorCode);
+        errorCode = SCH_wait(job->group, 0);
+        SCH_freeGroup(job->group);
+    }
+    for (i=0; i<BAT_MAX_INFLIGHT; i++) if (job->slots[i]) BAT_releaseChunk(job->batch, job->slots[i]);
+    if (job->finput) fclose(job->finput);
+    if (job->foutput) { fclose(job->foutput); if (errorCode) BAT_removeOutput(job->file); }
+    pthread_cond_destroy(&job->chunkRun);
+    pthread_mutex_destroy(&job->mutex);
+    if (!errorCode) BAT_addStats(job->file, inSize, job->outSize);
+    return errorCode;
+}
+
+static int BAT_compressLargeFile(const BAT_file_t* file)
+{
+    BAT_job_t job;
+    BYTE header[8];
+    U64 inSize = 0;
+    U64 offset = 0;
+    int last = 0;
+    int errorCode = BAT_initJob(&job, file);
+    const size_t chunkSize = job.batch->chunkSize;
+
+    job.function = BAT_compressChunk;
+    if (!errorCode)
+    {
+        struct stat st;
+        if (fstat(fileno(job.finput), &st)) errorCode = 84;
+        inSize = (U64)st.st_size;
+    }
+    if (!errorCode)
+    {
+        job.outSize = FIO_compressFrameHeader(header);
+        errorCode = BAT_write(header, (size_t)job.outSize, job.foutput);
+    }
+
+    // Chunks are only described here : each one is read by the thread compressing it
+    while ((!errorCode) && (!last))
+    {
+        BAT_chunk_t* const chunk = BAT_getChunk(job.batch);
+        if (chunk==NULL) { errorCode = 80; break; }
+        chunk->offset = offset;
+        chunk->inSize = (inSize - offset < chunkSize) ? (size_t)(inSize - offset) : chunkSize;
+        offset += chunk->inSize;
+        last = chunk->last = (chunk->inSize < chunkSize);   // a full last chunk is followed by an empty one
+        errorCode = BAT_issueChunk(&job, chunk, BAT_chunkCost(chunkSize));
+    }
+
+    if (!errorCode) errorCode = SCH_wait(job.group, 0);
+    if (!errorCode)
+    {
+        job.outSize += FIO_compressFrameEnd(header, XXH32_intermediateDigest(&job.hashState));
+        errorCode = BAT_write(header, 4, job.foutput);
+    }
+    return BAT_endJob(&job, errorCode, inSize);
+}
+
+static int BAT_decodeLargeFile(const BAT_file_t* file)
+{
+    BAT_job_t job;
+    BAT_chunk_t* chunk = NULL;
+    U32 checksum = 0;
+    int errorCode = BAT_initJob(&job, file);
+
+    job.function = BAT_decodeChunk;
+    if (!errorCode)
+    {
+        job.blockSizeId = FIO_readFrameHeader(job.finput);
+        if (job.blockSizeId < 0) errorCode = 87;
+    }
+
+    // Segment n+1 is read before segment n is issued : it starts with bytes read beyond segment n
+    if (!errorCode)
+    {
+        chunk = BAT_getChunk(job.batch);
+        if (chunk==NULL) errorCode = 80;
+        else if (FIO_readFrameSegment(&chunk->segment, NULL, job.finput, job.blockSizeId, job.batch->chunkSize)) errorCode = 86;
+    }
+    while (!errorCode)
+    {
+        BAT_chunk_t* next = NULL;
+        chunk->last = chunk->segment.last;
+        checksum = chunk->segment.checksum;
+        if (!chunk->last)
+        {
+            next = BAT_getChunk(job.batch);
+            if (next==NULL) errorCode = 80;
+            else if (FIO_readFrameSegment(&next->segment, &chunk->segment, job.finput, job.blockSizeId, job.batch->chunkSize)) errorCode = 86;
+            if (errorCode) { if (next) BAT_releaseChunk(job.batch, next); break; }
+        }
+        errorCode = BAT_issueChunk(&job, chunk, chunk->segment.capacity + (size_t)chunk->segment.decodedSize);
+        chunk = next;
+        if (chunk==NULL) break;
+    }
+    if (errorCode && chunk) BAT_releaseChunk(job.batch, chunk);   // read, but not issued
+
+    if (!errorCode) errorCode = SCH_wait(job.group, 0);
+    if ((!errorCode) && (XXH32_intermediateDigest(&job.hashState) != checksum)) errorCode = 88;
+    return BAT_endJob(&job, errorCode, job.finput ? (U64)ftello(job.finput) : 0);
+}
+
+
+//**************************************
+// File tasks
+//**************************************
+static int BAT_processFile(void* arg)
+{
+    const BAT_file_t* const file = (const BAT_file_t*)arg;
+    BAT_batch_t* const batch = BAT_getBatch(file);
+    BAT_context_t* const context = batch->contexts + SCH_workerId();
+    const int large = (file->size > batch->chunkSize);
+    int errorCode;
+
+    if (batch->decode) errorCode = large ? BAT_decodeLargeFile(file) : BAT_decodeWholeFile(context, file);
+    else errorCode = large ? BAT_compressLargeFile(file) : BAT_compressWholeFile(context, file);
+
+    if (errorCode && !SCH_isCancelled(batch->group)) BAT_fileError(file, errorCode);
+    return 0;   // next files are still processed
+}
+
+
+//**************************************
+// Batch functions
+//**************************************
+int BAT_processFiles(char** fileNames, int nbFiles, int decode, int recursive, int testMode)
+{
+    BAT_fileList_t list;
+    BAT_batch_t batch;
+    struct timespec start, end;
+    double seconds;
+    int nbWorkers;
+    int i;
+    size_t f;
+
+    // File list
+    memset(&list, 0, sizeof(list));
+    for (i=0; i<nbFiles; i++) BAT_collectFiles(&list, fileNames[i], recursive, 1, decode, testMode);
+    if (list.nbFiles==0) { DISPLAYLEVEL(2, "No file to process\n"); return list.nbSkipped>0; }
+    qsort(list.files, list.nbFiles, sizeof(BAT_file_t), BAT_compareSize);
+
+    // Context, derived from memory budget : half of it for whole-file buffers (one set per thread), half for chunks in flight
+    memset(&batch, 0, sizeof(batch));
+    batch.decode = decode;
+    {
+        const size_t budget = MEM_getBudget();
+        const size_t unit = FIO_frameSegmentUnit();   // compressed chunks must be made of whole buffers
+        int nbCores = SCH_getNbCores();
+        size_t chunkSize = BAT_CHUNKSIZE;
+        size_t inFlight;
+        while ((chunkSize > unit) && (BAT_MIN_BUDGET_CHUNKS * (size_t)nbCores * BAT_chunkCost(chunkSize) > budget)) chunkSize /= 2;
+        batch.chunkSize = (chunkSize / unit) * unit;
+        if (batch.chunkSize == 0) batch.chunkSize = unit;
+        SCH_limitThreads((int)(budget / 2 / BAT_chunkCost(batch.chunkSize)));
+        nbWorkers = SCH_getNbThreads();
+        if (nbWorkers==0) EXM_THROW(89, "Cannot create worker threads");
+        inFlight = budget / 2 / BAT_chunkCost(batch.chunkSize);
+        if (inFlight > (size_t)2*nbWorkers) inFlight = 2*nbWorkers;
+        if (inFlight > BAT_MAX_INFLIGHT) inFlight = BAT_MAX_INFLIGHT;
+        batch.maxInFlight = (inFlight < 1) ? 1 : (int)inFlight;
+        DISPLAYLEVEL(4, "memory budget %u MB : %i threads, chunks of %u KB, %i in flight per file\n",
+            (U32)(budget>>20), nbWorkers, (U32)(batch.chunkSize>>10), batch.maxInFlight);
+    }
+    pthread_mutex_init(&batch.mutex, NULL);
+    batch.contexts = (BAT_context_t*)calloc(nbWorkers, sizeof(BAT_context_t));   // first touched by their own thread
+    batch.nbNodes = SCH_getNbNodes();
+    batch.freeBuffers = (BAT_buffers_t**)calloc(batch.nbNodes, sizeof(BAT_buffers_t*));
+    batch.nodeBytes = (U64*)calloc(batch.nbNodes, sizeof(U64));
+    batch.group = SCH_createGroup(NULL);
+    if ((batch.contexts==NULL) || (batch.freeBuffers==NULL) || (batch.nodeBytes==NULL) || (batch.group==NULL))
+        EXM_THROW(80, "Allocation error : not enough memory");
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    // Largest files first, so that their chunks can keep all threads busy until the end
+    for (f=list.nbFiles; f>0; f--)
+    {
+        list.files[f-1].batch = &batch;
+        if (SCH_submit(batch.group, BAT_processFile, list.files+f-1)) EXM_THROW(89, "Cannot create worker threads");
+    }
+    SCH_wait(batch.group, 0);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    seconds = (double)(end.tv_sec - start.tv_sec) + (double)(end.tv_nsec - start.tv_nsec) / 1000000000.;
+    if (seconds <= 0.) seconds = 0.000001;
+
+    DISPLAYLEVEL(2, "%s %u files : %llu bytes into %llu bytes ==> %.2f%% (%i threads)\n",
+        decode ? "Decoded" : "Compressed", (U32)(list.nbFiles - batch.nbErrors),
+        (unsigned long long)batch.totalIn, (unsigned long long)batch.totalOut,
+        batch.totalIn ? (double)batch.totalOut/batch.totalIn*100 : 100., nbWorkers);
+    if (SCH_getPinning())
+    {
+        int node;
+        for (node=0; node<batch.nbNodes; node++)
+        {
+            int nbThreads = 0;
+            for (i=0; i<nbWorkers; i++) nbThreads += (SCH_workerNode(i)==node);
+            if (nbThreads==0) continue;
+            DISPLAYLEVEL(2, "node %i : %2i threads, %8.1f MB/s\n", node, nbThreads, (double)batch.nodeBytes[node] / seconds / (1 MB));
+        }
+    }
+    if (list.nbSkipped) DISPLAYLEVEL(2, "%i files skipped\n", list.nbSkipped);
+    if (batch.nbErrors) DISPLAYLEVEL(1, "%i files failed\n", batch.nbErrors);
+
+    // Free
+    for (i=0; i<nbWorkers; i++)
+    {
+        ARN_free(batch.contexts[i].arena);
+        if (batch.contexts[i].dstream) FSE_freeDStream(batch.contexts[i].dstream);
+    }
+    while (batch.freeChunks)
+    {
+        BAT_chunk_t* const chunk = batch.freeChunks;
+        batch.freeChunks = chunk->next;
+        FIO_freeFrameSegment(&chunk->segment);
+        free(chunk);
+    }
+    for (i=0; i<batch.nbNodes; i++)
+        while (batch.freeBuffers[i])
+        {
+            BAT_buffers_t* const buffers = batch.freeBuffers[i];
+            batch.freeBuffers[i] = buffers->next;
+            free(buffers->inBuff);
+            free(buffers->outBuff);
+            free(buffers);
+        }
+    for (f=0; f<list.nbFiles; f++) { free(list.files[f].inName); free(list.files[f].outName); }
+    free(list.files);
+    free(batch.contexts);
+    free(batch.freeBuffers);
+    free(batch.nodeBytes);
+    SCH_freeGroup(batch.group);
+    pthread_mutex_destroy(&batch.mutex);
+
+    return (list.nbSkipped>0) || (batch.nbErrors>0);
+}
+
+#endif   // _WIN32
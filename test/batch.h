@@ -0,0 +1,59 @@
+/*
+  batch.h - parallel processing of multiple files - header
+  Copyright (C) Yann Collet 2013-2014
+  GPL v2 License
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License along
+  with this program; if not, write to the Free Software Foundation, Inc.,
+  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+  You can contact the author at :
+  - Public forum : https://groups.google.com/forum/#!forum/lz4c
+*/
+#pragma once
+
+#if defined (__cplusplus)
+extern "C" {
+#endif
+
+
+//**************************************
+// Parameters
+//**************************************
+void BAT_overwriteMode(void);
+
+
+//**************************************
+// Batch functions
+//**************************************
+int BAT_processFiles(char** fileNames, int nbFiles, int decode, int recursive, int testMode);
+/*
+BAT_processFiles():
+    Compresses (or decodes) each file of 'fileNames' into its own file, using a pool of threads.
+    Compression adds extension .fse; decoding requires it, and removes it.
+    Directories are explored if 'recursive' is set, and skipped otherwise. Symbolic links met during exploration are skipped.
+    'testMode' decodes without writing anything.
+    Existing files are not overwritten, unless BAT_overwriteMode() was selected.
+    Files are scheduled on the shared work-stealing pool (see scheduler.h) : small files are processed whole by one thread,
+    large files are cut into chunks of up to 8 MB, processed in parallel.
+    Chunk size, nb of threads and nb of chunks in flight are derived from memory budget (see membudget.h) :
+    a file stops being read while the budget is exhausted, until written chunks release it.
+    An error stops the file concerned (its output is removed), but not the others.
+    Results are identical to compress_file() / decompress_file().
+    return : 0 if all files were processed, 1 if some were skipped or failed
+*/
+
+
+#if defined (__cplusplus)
+}
+#endif
@@ -23,7 +23,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 // Tuning parameters
 //**************************************
 #define NBLOOPS    4
-#define TIMELOOP   2500
+#define TIMELOOP   2500   // ms, per iteration
 
 
 //**************************************
@@ -33,6 +33,8 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #define _CRT_SECURE_NO_WARNINGS
 #define _CRT_SECURE_NO_DEPRECATE     // VS2005
 
+#define _POSIX_C_SOURCE 200112L      // clock_gettime
+
 // Unix Large Files support (>4GB)
 #define _FILE_OFFSET_BITS 64
 #if (defined(__sun__) && (!defined(__LP64__)))   // Sun Solaris 32-bits requires specific definitions
@@ -41,10 +43,6 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #  define _LARGEFILE64_SOURCE
 #endif
 
-// S_ISREG & gettimeofday() are not supported by MSVC
-#if defined(_MSC_VER) || defined(_WIN32)
-#  define BMK_LEGACY_TIMER 1
-#endif
 
 
 //**************************************
@@ -53,18 +51,24 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include <stdlib.h>      // malloc
 #include <stdio.h>       // fprintf, fopen, ftello64
 #include <string.h>      // strcat
+#include <math.h>        // pow
 #include <sys/types.h>   // stat64
 #include <sys/stat.h>    // stat64
 
-// Use ftime() if gettimeofday() is not available on your target
-#if defined(BMK_LEGACY_TIMER)
-#  include <sys/timeb.h>   // timeb, ftime
+#if defined(_WIN32)
+#  include <windows.h>     // QueryPerformanceCounter
 #else
-#  include <sys/time.h>    // gettimeofday
+#  include <time.h>        // clock_gettime
+#  include <pthread.h>     // scaling benchmark
 #endif
 
 #include "bench.h"
 #include "fileio.h"
+#include "membudget.h"
+#include "arena.h"
+#include "report.h"
+#include "scheduler.h"
+#include "perfcount.h"
 #include "fse.h"
 #include "zlibh.h"
 #include "xxhash.h"
@@ -89,6 +93,14 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #  include <intrin.h>
 #endif
 
+// Cache line flush (cold benchmark)
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#  include <emmintrin.h>   // _mm_clflush, _mm_mfence
+#  define BMK_CLFLUSH 1
+#else
+#  define BMK_CLFLUSH 0
+#endif
+
 
 //**************************************
 // Basic Types
@@ -133,12 +145,34 @@ typedef unsigned long long  U64;
 static int chunkSize = DEFAULT_CHUNKSIZE;
 static int nbIterations = NBLOOPS;
 static int BMK_pause = 0;
-static int BMK_byteCompressor = 1;
-
-void BMK_SetByteCompressor(int id) { BMK_byteCompressor = id; }
+static int BMK_phases = 0;
+static int BMK_sweep = 0;
+static int BMK_tableLogs = 0;
+static int BMK_spreads = 0;
+static int BMK_scaling = 0;
+static int BMK_cold = 0;
+static int BMK_latency = 0;
+static int BMK_perf = 0;
+static const char* BMK_recordName = NULL;   // when set, replaces display name in results
 
 void BMK_SetBlocksize(int bsize) { chunkSize = bsize; }
 
+void BMK_SetPhaseProfiling(int enabled) { BMK_phases = enabled; }
+
+void BMK_SetSweep(int enabled) { BMK_sweep = enabled; }
+
+void BMK_SetTableLogs(int enabled) { BMK_tableLogs = enabled; }
+
+void BMK_SetSpreads(int enabled) { BMK_spreads = enabled; }
+
+void BMK_SetScaling(int enabled) { BMK_scaling = enabled; }
+
+void BMK_SetColdCache(int enabled) { BMK_cold = enabled; }
+
+void BMK_SetLatency(int enabled) { BMK_latency = enabled; }
+
+void BMK_SetPerfCounters(int enabled) { BMK_perf = enabled; }
+
 void BMK_SetNbIterations(int nbLoops)
 {
     nbIterations = nbLoops;
@@ -161,62 +195,243 @@ typedef struct
 //  Private functions
 //*********************************************************
 
-#if defined(BMK_LEGACY_TIMER)
+//**************************************
+// Timing
+//**************************************
+/*
+Each sample times one pass over all blocks, in nanoseconds and, where available, in TSC cycles.
+Samples are collected during TIMELOOP for each iteration; speeds use the fastest one (min-of-N),
+and the median is reported alongside, to judge stability.
+TSC counts reference cycles : they equal core cycles only at nominal frequency (turbo and frequency scaling disabled).
+*/
+#define TIMELOOP_NS      ((U64)TIMELOOP * 1000000)
+#define BMK_MAX_SAMPLES  (1<<16)   // most recent samples kept for median
+
+static U64 BMK_timeLoopNs = TIMELOOP_NS;
 
-static int BMK_GetMilliStart()
+typedef struct
 {
-    // Based on Legacy ftime()
-    // Rolls over every ~ 12.1 days (0x100000/24/60/60)
-    // Use GetMilliSpan to correct for rollover
-    struct timeb tb;
-    int nCount;
-    ftime( &tb );
-    nCount = (int) (tb.millitm + (tb.time & 0xfffff) * 1000);
-    return nCount;
+    U32 nb;                        // total nb of samples
+    U64 minNs;
+    U64 minCycles;
+    U32 nbIter;
+    U64 iterMinNs[REP_MAX_SAMPLES];   // fastest sample of each iteration
+    U64 ns[BMK_MAX_SAMPLES];
+    U64 cycles[BMK_MAX_SAMPLES];
+} BMK_samples_t;
+
+typedef struct
+{
+    int running;
+    U64 start;
+    U64 sampleStart;
+    U64 cycleStart;
+} BMK_timer_t;
+
+static BMK_samples_t BMK_samplesC, BMK_samplesD;
+
+static U64 BMK_getNanos(void)
+{
+#if defined(_WIN32)
+    static LARGE_INTEGER frequency = { 0 };
+    LARGE_INTEGER now;
+    if (!frequency.QuadPart) QueryPerformanceFrequency(&frequency);
+    QueryPerformanceCounter(&now);
+    return (U64)((double)now.QuadPart * 1000000000. / (double)frequency.QuadPart);
+#else
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (U64)now.tv_sec * 1000000000ULL + (U64)now.tv_nsec;
+#endif
 }
 
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#  define BMK_CYCLES 1
+static U64 BMK_getCycles(void)
+{
+    U32 lo, hi;
+    __asm__ __volatile__ ("rdtsc" : "=a"(lo), "=d"(hi));
+    return ((U64)hi << 32) | lo;
+}
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#  define BMK_CYCLES 1
+static U64 BMK_getCycles(void) { return __rdtsc(); }
 #else
+#  define BMK_CYCLES 0
+static U64 BMK_getCycles(void) { return 0; }
+#endif
 
-static int BMK_GetMilliStart()
+static void BMK_resetSamples(BMK_samples_t* samples)
 {
-    // Based on newer gettimeofday()
-    // Use GetMilliSpan to correct for rollover
-    struct timeval tv;
-    int nCount;
-    gettimeofday(&tv, NULL);
-    nCount = (int) (tv.tv_usec/1000 + (tv.tv_sec & 0xfffff) * 1000);
-    return nCount;
+    samples->nb = samples->nbIter = 0;
+    samples->minNs = samples->minCycles = (U64)-1;
 }
 
-#endif
+/*
+BMK_timerLoop() : use as 'while (BMK_timerLoop(&timer, &samples, duration)) { timed code }'
+    Each call ends previous sample; 'timer.running' must be 0 before first call.
+*/
+static void BMK_newIteration(BMK_samples_t* samples)
+{
+    if (samples->nbIter < REP_MAX_SAMPLES) samples->iterMinNs[samples->nbIter] = (U64)-1;
+    samples->nbIter++;
+}
 
+// must follow BMK_newIteration()
+static void BMK_addSample(BMK_samples_t* samples, U64 ns, U64 nbCycles)
+{
+    samples->ns[samples->nb % BMK_MAX_SAMPLES] = ns;
+    samples->cycles[samples->nb % BMK_MAX_SAMPLES] = nbCycles;
+    samples->nb++;
+    if (ns < samples->minNs) samples->minNs = ns;
+    if (nbCycles < samples->minCycles) samples->minCycles = nbCycles;
+    if ((samples->nbIter <= REP_MAX_SAMPLES) && (ns < samples->iterMinNs[samples->nbIter-1])) samples->iterMinNs[samples->nbIter-1] = ns;
+}
 
-static int BMK_GetMilliSpan( int nTimeStart )
+static int BMK_timerLoop(BMK_timer_t* timer, BMK_samples_t* samples, U64 duration)
 {
-    int nSpan = BMK_GetMilliStart() - nTimeStart;
-    if ( nSpan < 0 )
-        nSpan += 0x100000 * 1000;
-    return nSpan;
+    const U64 cycles = BMK_getCycles();
+    const U64 now = BMK_getNanos();
+    if (timer->running)
+        BMK_addSample(samples, now - timer->sampleStart, cycles - timer->cycleStart);
+    else
+    {
+        if (duration==0) return 0;
+        timer->running = 1; timer->start = now;
+        BMK_newIteration(samples);
+    }
+    if (now - timer->start >= duration) { timer->running = 0; return 0; }
+    timer->sampleStart = BMK_getNanos();
+    timer->cycleStart = BMK_getCycles();
+    return 1;
 }
 
+// return : fastest sample, in ms (same unit as former millisecond timer)
+static double BMK_fastestMs(const BMK_samples_t* samples)
+{
+    if (samples->nb==0) return 100000000.;
+    return (double)samples->minNs / 1000000.;
+}
 
-static size_t BMK_findMaxMem(U64 requiredMem)
+static int BMK_compareU64(const void* a, const void* b)
 {
-    size_t step = (64 MB);
-    BYTE* testmem=NULL;
+    U64 va = *(const U64*)a, vb = *(const U64*)b;
+    return (va > vb) - (va < vb);
+}
 
-    requiredMem = (((requiredMem >> 26) + 1) << 26);
-    requiredMem += 2*step;
-    if (requiredMem > MAX_MEM) requiredMem = MAX_MEM;
+// Sorts kept samples
+static void BMK_medians(BMK_samples_t* samples, double* ns, double* cycles)
+{
+    const size_t nb = (samples->nb < BMK_MAX_SAMPLES) ? samples->nb : BMK_MAX_SAMPLES;
+    *ns = *cycles = 0.;
+    if (nb==0) return;
+    qsort(samples->ns, nb, sizeof(U64), BMK_compareU64);
+    qsort(samples->cycles, nb, sizeof(U64), BMK_compareU64);
+    *ns = (double)samples->ns[nb/2];
+    *cycles = (double)samples->cycles[nb/2];
+}
+
+static void BMK_displayTimings(int nbBlocks, U64 nbSymbols)
+{
+    BMK_samples_t* const all[2] = { &BMK_samplesC, &BMK_samplesD };
+    const char* const names[2] = { "C", "D" };
+    int i;
+    if (nbBlocks < 1) nbBlocks = 1;
+    if (nbSymbols < 1) nbSymbols = 1;
+    DISPLAY("%16s :", "");
+    for (i=0; i<2; i++)
+    {
+        BMK_samples_t* const samples = all[i];
+        double medianNs, medianCycles;
+        if (samples->nb==0) continue;
+        BMK_medians(samples, &medianNs, &medianCycles);
+        DISPLAY(" %s %9.0f ns/block (med %9.0f)", names[i], (double)samples->minNs / nbBlocks, medianNs / nbBlocks);
+        if (BMK_CYCLES) DISPLAY(", %5.2f cycles/sym (med %5.2f)", (double)samples->minCycles / nbSymbols, medianCycles / nbSymbols);
+        DISPLAY(i==0 ? " |" : "");
+    }
+    DISPLAY(" [%u/%u samples]\n", BMK_samplesC.nb, BMK_samplesD.nb);
+}
+
+static void BMK_iterSpeeds(double* speeds, int* nb, const BMK_samples_t* samples, U64 srcSize)
+{
+    int i;
+    *nb = (samples->nbIter < REP_MAX_SAMPLES) ? (int)samples->nbIter : REP_MAX_SAMPLES;
+    for (i=0; i<*nb; i++) speeds[i] = (double)srcSize / (double)samples->iterMinNs[i] * 1000.;
+}
+
+static void BMK_record(const char* codec, const char* fileName, int blockSize, int tableLog, U64 srcSize, U64 cSize)
+{
+    REP_result_t r;
+    r.fileName = BMK_recordName ? BMK_recordName : fileName;
+    r.codec = codec;
+    r.blockSize = blockSize;
+    r.tableLog = tableLog;
+    r.srcSize = srcSize;
+    r.cSize = cSize;
+    r.cSpeed = BMK_samplesC.nb ? (double)srcSize / (double)BMK_samplesC.minNs * 1000. : 0.;
+    r.dSpeed = BMK_samplesD.nb ? (double)srcSize / (double)BMK_samplesD.minNs * 1000. : 0.;
+    BMK_iterSpeeds(r.cSamples, &r.nbCSamples, &BMK_samplesC, srcSize);
+    BMK_iterSpeeds(r.dSamples, &r.nbDSamples, &BMK_samplesD, srcSize);
+    REP_add(&r);
+}
+
+
+//**************************************
+// Performance counters
+//**************************************
+static PRF_counts_t BMK_perfC, BMK_perfD;
+
+static void BMK_perfReset(void)
+{
+    static int opened = 0;
+    if (!BMK_perf) return;
+    if (!opened)
+    {
+        opened = 1;
+        if (PRF_open()==0)
+        {
+            DISPLAY("Hardware performance counters unavailable (not supported, or perf_event_paranoid) : --perf ignored\n");
+            BMK_perf = 0;
+            return;
+        }
+    }
+    memset(&BMK_perfC, 0, sizeof(BMK_perfC));
+    memset(&BMK_perfD, 0, sizeof(BMK_perfD));
+}
+
+static void BMK_perfStart(void) { if (BMK_perf) PRF_start(); }
+static void BMK_perfStop(PRF_counts_t* counts) { if (BMK_perf) PRF_stop(counts); }
 
-    while (!testmem)
+static void BMK_displayPerf(U64 nbSymbolsC, U64 nbSymbolsD)
+{
+    const PRF_counts_t* const all[2] = { &BMK_perfC, &BMK_perfD };
+    const U64 nbSymbols[2] = { nbSymbolsC, nbSymbolsD };
+    int i, c;
+    if (!BMK_perf) return;
+    for (i=0; i<2; i++)
     {
-        requiredMem -= step;
-        testmem = (BYTE*) malloc ((size_t)requiredMem);
+        const PRF_counts_t* const counts = all[i];
+        if (nbSymbols[i]==0) continue;
+        DISPLAY("%16s : %s", "", i ? "D" : "C");
+        if (PRF_available(PRF_cycles) && PRF_available(PRF_instructions) && counts->value[PRF_cycles])
+            DISPLAY(" IPC %4.2f,", (double)counts->value[PRF_instructions] / (double)counts->value[PRF_cycles]);
+        for (c=0; c<PRF_nbCounters; c++)
+        {
+            if (PRF_available((PRF_counter)c)) DISPLAY(" %.4f %s", (double)counts->value[c] / (double)nbSymbols[i], PRF_name((PRF_counter)c));
+            else DISPLAY(" n/a %s", PRF_name((PRF_counter)c));
+            DISPLAY(c+1<PRF_nbCounters ? "," : " per symbol\n");
+        }
     }
+}
+
 
-    free (testmem);
-    return (size_t) (requiredMem - step);
+// No probing by malloc() : within a container, memory can be promised beyond its limit, then the process gets killed
+static size_t BMK_findMaxMem(U64 requiredMem)
+{
+    U64 budget = MEM_getBudget();
+    if (requiredMem > budget) requiredMem = budget;
+    if (requiredMem > MAX_MEM) requiredMem = MAX_MEM;
+    return (size_t)requiredMem;
 }
 
 
@@ -235,14 +450,154 @@ static U64 BMK_GetFileSize(char* infilename)
 }
 
 
+//**************************************
+// Codecs
+//**************************************
+/*
+All codecs are benchmarked by the same engine (BMK_benchCodec()), hence with identical methodology.
+Sizes are in bytes, whatever the symbol size. 'nbSymbols' and 'tableLog' can be 0, to mean : default.
+*/
+typedef int (*BMK_compressor)  (void* dst, const void* src, int srcSize, int nbSymbols, int tableLog);
+typedef int (*BMK_decompressor)(void* dst, int dstSize, const void* src, int srcSize);
+
+typedef struct
+{
+    const char* name;
+    BMK_compressor   compress;
+    BMK_decompressor decompress;   // NULL : decompression not benchmarked
+    int symbolSize;                // in bytes
+    int tableLog;                  // default
+    int anyInput;                  // 0 : needs specific values, only produced by LZ4 extraction (-l)
+} BMK_codec_t;
+
+static int BMK_fse_compress(void* dst, const void* src, int srcSize, int nbSymbols, int tableLog)
+{ return FSE_compress2(dst, (const unsigned char*)src, srcSize, nbSymbols, tableLog); }
+static int BMK_fse_decompress(void* dst, int dstSize, const void* src, int srcSize)
+{ (void)srcSize; return FSE_decompress((unsigned char*)dst, dstSize, src); }
+static int BMK_fseSafe_decompress(void* dst, int dstSize, const void* src, int srcSize)
+{ return FSE_decompress_safe((unsigned char*)dst, dstSize, src, srcSize); }
+
+static int BMK_fseSorted_compress(void* dst, const void* src, int srcSize, int nbSymbols, int tableLog)
+{ return FSE_compress_spread(dst, (const unsigned char*)src, srcSize, nbSymbols, tableLog, FSE_spread_sorted); }
+static int BMK_fsePrecise_compress(void* dst, const void* src, int srcSize, int nbSymbols, int tableLog)
+{ return FSE_compress_spread(dst, (const unsigned char*)src, srcSize, nbSymbols, tableLog, FSE_spread_precise); }
+
+static int BMK_fseLowMem_compress(void* dst, const void* src, int srcSize, int nbSymbols, int tableLog)
+{
+    U32 LMTable[FSE_LOWMEM_TABLESIZE/4];
+    (void)nbSymbols;
+    if (tableLog > FSE_LOWMEM_MAX_TABLELOG) tableLog = FSE_LOWMEM_MAX_TABLELOG;
+    return FSE_compressLowMem(dst, (const unsigned char*)src, srcSize, tableLog, LMTable);
+}
+static int BMK_fseLowMem_decompress(void* dst, int dstSize, const void* src, int srcSize)
+{
+    U32 LMTable[FSE_LOWMEM_TABLESIZE/4];
+    return FSE_decompressLowMem((unsigned char*)dst, dstSize, src, srcSize, LMTable);
+}
+
+static int BMK_fse2t_compress(void* dst, const void* src, int srcSize, int nbSymbols, int tableLog)
+{ (void)nbSymbols; return FSE2T_compress2(dst, (const unsigned char*)src, srcSize, tableLog); }
+static int BMK_fse2t_decompress(void* dst, int dstSize, const void* src, int srcSize)
+{ (void)srcSize; return FSE2T_decompress((unsigned char*)dst, dstSize, src); }
+
+static int BMK_fseU16_compress(void* dst, const void* src, int srcSize, int nbSymbols, int tableLog)
+{ (void)nbSymbols; return FSED_compressU16(dst, (const U16*)src, srcSize/2, tableLog); }
+static int BMK_fseU16_decompress(void* dst, int dstSize, const void* src, int srcSize)
+{ (void)srcSize; return FSED_decompressU16((U16*)dst, dstSize/2, src); }
+
+static int BMK_fseU16Log2_compress(void* dst, const void* src, int srcSize, int nbSymbols, int tableLog)
+{ (void)nbSymbols; return FSED_compressU16Log2(dst, (const U16*)src, srcSize/2, tableLog); }
+
+static int BMK_fseU32_compress(void* dst, const void* src, int srcSize, int nbSymbols, int tableLog)
+{ (void)nbSymbols; return FSED_compressU32(dst, (const U32*)src, srcSize/4, tableLog); }
+static int BMK_fseU32_decompress(void* dst, int dstSize, const void* src, int srcSize)
+{ (void)srcSize; return FSED_decompressU32((U32*)dst, dstSize/4, src); }
+
+static int BMK_fse285_compress(void* dst, const void* src, int srcSize, int nbSymbols, int tableLog)
+{ (void)nbSymbols; return FSE_compressU16(dst, (const U16*)src, srcSize/2, 0, tableLog); }
+static int BMK_fse285_decompress(void* dst, int dstSize, const void* src, int srcSize)
+{ (void)srcSize; return FSE_decompressU16((U16*)dst, dstSize/2, src); }
+
+static int BMK_zlibh_compress(void* dst, const void* src, int srcSize, int nbSymbols, int tableLog)
+{ (void)nbSymbols; (void)tableLog; return ZLIBH_compress((char*)dst, (const char*)src, srcSize); }
+static int BMK_zlibh_decompress(void* dst, int dstSize, const void* src, int srcSize)
+{ (void)dstSize; (void)srcSize; return ZLIBH_decompress((char*)dst, (const char*)src); }
+
+static const BMK_codec_t BMK_codecs[] =
+{
+    // name         compress                 decompress              symbolSize tableLog anyInput
+    { "fse",        BMK_fse_compress,        BMK_fse_decompress,        1,   0, 1 },
+    { "fseSafe",    BMK_fse_compress,        BMK_fseSafe_decompress,    1,   0, 1 },   // untrusted input
+    { "fseLowMem",  BMK_fseLowMem_compress,  BMK_fseLowMem_decompress,  1,   0, 1 },   // tables < 2 KB
+    { "fseSorted",  BMK_fseSorted_compress,  BMK_fse_decompress,        1,   0, 1 },   // spread : contiguous runs
+    { "fsePrecise", BMK_fsePrecise_compress, BMK_fse_decompress,        1,   0, 1 },   // spread : ideal positions
+    { "fse2t",      BMK_fse2t_compress,      BMK_fse2t_decompress,      1,  10, 1 },
+    { "zlibh",      BMK_zlibh_compress,      BMK_zlibh_decompress,      1,   0, 1 },
+    { "fseU16",     BMK_fseU16_compress,     BMK_fseU16_decompress,     2,  10, 0 },   // distances : values > 0
+    { "fseU32",     BMK_fseU32_compress,     BMK_fseU32_decompress,     4,  10, 0 },
+    { "fseU16Log2", BMK_fseU16Log2_compress, NULL,                      2,  10, 0 },   // no decoder yet
+    { "fse285",     BMK_fse285_compress,     BMK_fse285_decompress,     2,  12, 0 },   // symbols < 286
+};
+#define BMK_NB_CODECS (int)(sizeof(BMK_codecs) / sizeof(BMK_codecs[0]))
+
+static const BMK_codec_t* BMK_selected[BMK_NB_CODECS] = { BMK_codecs };   // fse
+static int BMK_nbSelected = 1;
+
+static const BMK_codec_t* BMK_findCodec(const char* name, size_t length)
+{
+    int i;
+    for (i=0; i<BMK_NB_CODECS; i++)
+        if ((strlen(BMK_codecs[i].name)==length) && !strncmp(BMK_codecs[i].name, name, length)) return BMK_codecs+i;
+    return NULL;
+}
+
+int BMK_SetCodecs(const char* names)
+{
+    int nbSelected = 0;
+    if (!strcmp(names, "all"))
+    {
+        int i;
+        for (i=0; i<BMK_NB_CODECS; i++) if (BMK_codecs[i].anyInput) BMK_selected[nbSelected++] = BMK_codecs+i;
+        BMK_nbSelected = nbSelected;
+        return 0;
+    }
+    while (*names)
+    {
+        const size_t length = strcspn(names, ",");
+        const BMK_codec_t* const codec = BMK_findCodec(names, length);
+        int i;
+        if ((codec==NULL) || !codec->anyInput) return -1;
+        for (i=0; (i<nbSelected) && (BMK_selected[i]!=codec); i++) {}
+        if ((i==nbSelected) && (nbSelected<BMK_NB_CODECS)) BMK_selected[nbSelected++] = codec;
+        names += length;
+        if (*names==',') names++;
+    }
+    if (nbSelected==0) return -1;
+    BMK_nbSelected = nbSelected;
+    return 0;
+}
+
+void BMK_listCodecs(void)
+{
+    int i;
+    for (i=0; i<BMK_NB_CODECS; i++) if (BMK_codecs[i].anyInput) DISPLAY(" %s", BMK_codecs[i].name);
+    DISPLAY("\n");
+}
+
+
 //*********************************************************
 //  Public function
 //*********************************************************
 
-void BMK_benchMemU32(chunkParameters_t* chunkP, int nbChunks, char* inFileName, int benchedSize,
+/*
+Decoded data is written into destBuffer, then checked against origBuffer.
+Both must be contiguous, from chunkP[0], and 'benchedSize' must be a multiple of codec's symbol size.
+*/
+static void BMK_benchCodec(const BMK_codec_t* codec, chunkParameters_t* chunkP, int nbChunks, char* inFileName, int benchedSize,
                   U64* totalCompressedSize, double* totalCompressionTime, double* totalDecompressionTime,
-                  int memLog)
+                  int nbSymbols, int tableLog)
 {
+    const U64 nbSymbolsTotal = (U64)benchedSize / codec->symbolSize;
     int loopNb, chunkNb;
     size_t cSize=0;
     double fastestC = 100000000., fastestD = 100000000.;
@@ -251,66 +606,79 @@ void BMK_benchMemU32(chunkParameters_t* chunkP, int nbChunks, char* inFileName,
     U32 crcOrig;
 
     // Init
+    if (tableLog==0) tableLog = codec->tableLog;
     crcOrig = XXH32(chunkP[0].origBuffer, benchedSize,0);
+    if (codec->decompress==NULL) crcCheck = crcOrig;
 
+    BMK_resetSamples(&BMK_samplesC);
+    BMK_resetSamples(&BMK_samplesD);
+    BMK_perfReset();
     DISPLAY("\r%79s\r", "");
     for (loopNb = 1; loopNb <= nbIterations; loopNb++)
     {
-        int nbLoops;
-        int milliTime;
+        BMK_timer_t timer;
 
         // Compression
         DISPLAY("%1i-%-14.14s : %9i ->\r", loopNb, inFileName, benchedSize);
         { int i; for (i=0; i<benchedSize; i++) chunkP[0].compressedBuffer[i]=(char)i; }     // warmimg up memory
 
-        nbLoops = 0;
-        milliTime = BMK_GetMilliStart();
-        while(BMK_GetMilliStart() == milliTime);
-        milliTime = BMK_GetMilliStart();
-        while(BMK_GetMilliSpan(milliTime) < TIMELOOP)
+        BMK_perfStart();
+        timer.running = 0;
+        while (BMK_timerLoop(&timer, &BMK_samplesC, BMK_timeLoopNs))
         {
             for (chunkNb=0; chunkNb<nbChunks; chunkNb++)
-                chunkP[chunkNb].compressedSize = FSED_compressU32(chunkP[chunkNb].compressedBuffer, (const U32*)(chunkP[chunkNb].origBuffer), chunkP[chunkNb].origSize/4, memLog);
-            nbLoops++;
+                chunkP[chunkNb].compressedSize = codec->compress(chunkP[chunkNb].compressedBuffer, chunkP[chunkNb].origBuffer, chunkP[chunkNb].origSize, nbSymbols, tableLog);
+        }
+        BMK_perfStop(&BMK_perfC);
+        fastestC = BMK_fastestMs(&BMK_samplesC);
+        cSize=0;
+        for (chunkNb=0; chunkNb<nbChunks; chunkNb++)
+        {
+            if (chunkP[chunkNb].compressedSize < 0) { DISPLAY("\n!!! %14s : %s compression error on block %i\n", inFileName, codec->name, chunkNb); return; }
+            cSize += chunkP[chunkNb].compressedSize;
         }
-        milliTime = BMK_GetMilliSpan(milliTime);
-
-        if ((double)milliTime < fastestC*nbLoops) fastestC = (double)milliTime/nbLoops;
-        cSize=0; for (chunkNb=0; chunkNb<nbChunks; chunkNb++) cSize += chunkP[chunkNb].compressedSize;
         ratio = (double)cSize/(double)benchedSize*100.;
 
         DISPLAY("%1i-%-14.14s : %9i -> %9i (%5.2f%%),%7.1f MB/s\r", loopNb, inFileName, (int)benchedSize, (int)cSize, ratio, (double)benchedSize / fastestC / 1000.);
 
-        //DISPLAY("\n"); continue;   // skip decompression
-        // Decompression
-        //{ size_t i; for (i=0; i<benchedSize; i++) orig_buff[i]=0; }     // zeroing area, for CRC checking
+        if (codec->decompress==NULL) continue;   // compression only
 
-        nbLoops = 0;
-        milliTime = BMK_GetMilliStart();
-        while(BMK_GetMilliStart() == milliTime);
-        milliTime = BMK_GetMilliStart();
-        while(BMK_GetMilliSpan(milliTime) < TIMELOOP)
+        // Decompression
+        BMK_perfStart();
+        timer.running = 0;
+        while (BMK_timerLoop(&timer, &BMK_samplesD, BMK_timeLoopNs))
         {
             for (chunkNb=0; chunkNb<nbChunks; chunkNb++)
-                chunkP[chunkNb].compressedSize = FSED_decompressU32((unsigned int*)chunkP[chunkNb].origBuffer, chunkP[chunkNb].origSize/4, chunkP[chunkNb].compressedBuffer);
-            nbLoops++;
+                chunkP[chunkNb].destSize = codec->decompress(chunkP[chunkNb].destBuffer, chunkP[chunkNb].origSize, chunkP[chunkNb].compressedBuffer, chunkP[chunkNb].compressedSize);
         }
-        milliTime = BMK_GetMilliSpan(milliTime);
-
-        if ((double)milliTime < fastestD*nbLoops) fastestD = (double)milliTime/nbLoops;
+        BMK_perfStop(&BMK_perfD);
+        fastestD = BMK_fastestMs(&BMK_samplesD);
         DISPLAY("%1i-%-14.14s : %9i -> %9i (%5.2f%%),%7.1f MB/s ,%7.1f MB/s\r", loopNb, inFileName, (int)benchedSize, (int)cSize, ratio, (double)benchedSize / fastestC / 1000., (double)benchedSize / fastestD / 1000.);
 
         // CRC Checking
-        crcCheck = XXH32(chunkP[0].origBuffer, benchedSize,0);
-        if (crcOrig!=crcCheck) { DISPLAY("\n!!! WARNING !!! %14s : Invalid Checksum : %x != %x\n", inFileName, (unsigned)crcOrig, (unsigned)crcCheck); break; }
+        crcCheck = XXH32(chunkP[0].destBuffer, benchedSize,0);
+        if (crcOrig!=crcCheck)
+        {
+            const char* src = chunkP[0].origBuffer;
+            const char* fin = chunkP[0].destBuffer;
+            const char* const srcStart = src;
+            while (*src==*fin) src++, fin++;
+            DISPLAY("\n!!! %14s : %s : Invalid Checksum !!! pos %i/%i\n", inFileName, codec->name, (int)(src-srcStart), benchedSize);
+            break;
+        }
     }
 
     if (crcOrig==crcCheck)
     {
-        if (ratio<100.)
+        if (codec->decompress==NULL)
+            DISPLAY("%-16.16s : %9i -> %9i (%5.2f%%),%7.1f MB/s\n", inFileName, (int)benchedSize, (int)cSize, ratio, (double)benchedSize / fastestC / 1000.);
+        else if (ratio<100.)
             DISPLAY("%-16.16s : %9i -> %9i (%5.2f%%),%7.1f MB/s ,%7.1f MB/s\n", inFileName, (int)benchedSize, (int)cSize, ratio, (double)benchedSize / fastestC / 1000., (double)benchedSize / fastestD / 1000.);
         else
             DISPLAY("%-16.16s : %9i -> %9i (%5.1f%%),%7.1f MB/s ,%7.1f MB/s \n", inFileName, (int)benchedSize, (int)cSize, ratio, (double)benchedSize / fastestC / 1000., (double)benchedSize / fastestD / 1000.);
+        BMK_displayTimings(nbChunks, nbSymbolsTotal);
+        BMK_displayPerf((U64)BMK_samplesC.nb * nbSymbolsTotal, (U64)BMK_samplesD.nb * nbSymbolsTotal);
+        BMK_record(codec->name, inFileName, chunkSize, tableLog, (U64)benchedSize, (U64)cSize);
     }
     *totalCompressedSize    += cSize;
     *totalCompressionTime   += fastestC;
@@ -318,357 +686,716 @@ void BMK_benchMemU32(chunkParameters_t* chunkP, int nbChunks, char* inFileName,
 }
 
 
-void BMK_benchMemU16(chunkParameters_t* chunkP, int nbChunks, char* inFileName, int benchedSize,
-                  U64* totalCompressedSize, double* totalCompressionTime, double* totalDecompressionTime,
-                  int memLog)
-{
-    int loopNb, chunkNb;
-    size_t cSize=0;
-    double fastestC = 100000000., fastestD = 100000000.;
-    double ratio=0.;
-    U32 crcCheck=0;
-    U32 crcOrig;
-
-    // Init
-    crcOrig = XXH32(chunkP[0].origBuffer, benchedSize,0);
+//**************************************
+// Phase profiling
+//**************************************
+/*
+Times separately each step of FSE_compress2() and FSE_decompress(), using the public primitives,
+for block sizes from BMK_PHASE_MINBLOCK up to chunkSize.
+Each step of each block is timed on its own : for a pass over all blocks, times of each step are summed,
+and the fastest pass is kept (min-of-N), per step.
+Blocks which FSE_compress2() would not entropy-code (single symbol) are only counted.
+*/
+#define BMK_PHASE_MINBLOCK (1 KB)
 
-    DISPLAY("\r%79s\r", "");
-    for (loopNb = 1; loopNb <= nbIterations; loopNb++)
-    {
-        int nbLoops;
-        int milliTime;
+enum { BMK_count, BMK_normalizeCount, BMK_writeHeader, BMK_buildCTable, BMK_compressCore,
+       BMK_readHeader, BMK_buildDTable, BMK_decompressCore, BMK_nbPhases };
 
-        // Compression
-        DISPLAY("%1i-%-14.14s : %9i ->\r", loopNb, inFileName, benchedSize);
-        { int i; for (i=0; i<benchedSize; i++) chunkP[0].compressedBuffer[i]=(char)i; }     // warmimg up memory
+static const char* const BMK_phaseNames[BMK_nbPhases] =
+    { "FSE_count", "FSE_normalizeCount", "FSE_writeHeader", "FSE_buildCTable", "FSE_compress_usingCTable",
+      "FSE_readHeader", "FSE_buildDTable", "FSE_decompress_usingDTable" };
 
-        nbLoops = 0;
-        milliTime = BMK_GetMilliStart();
-        while(BMK_GetMilliStart() == milliTime);
-        milliTime = BMK_GetMilliStart();
-        while(BMK_GetMilliSpan(milliTime) < TIMELOOP)
+static int BMK_profilePhases_blockSize(ARN_arena* arena, const BYTE* src, int srcSize, int blockSize)
+{
+    const int nbBlocks = (srcSize + blockSize - 1) / blockSize;
+    U64 fastest[BMK_nbPhases];
+    U64 passTime[BMK_nbPhases];
+    U32 count[256];
+    U32 normalized[256];
+    BYTE* cBuff = (BYTE*)ARN_alloc(arena, FSE_compressBound(blockSize));
+    BYTE* dBuff = (BYTE*)ARN_alloc(arena, blockSize);
+    void* CTable = NULL;
+    void* DTable = NULL;
+    int nbCoded = 0, pass = 0, phase, errorCode = 0;
+    U64 start, cSize = 0, hSize = 0;
+    double totalC = 0., totalD = 0.;
+
+    // Largest tables needed
+    {
+        int ctSize = 0, dtSize = 0, blockNb;
+        for (blockNb=0; blockNb<nbBlocks; blockNb++)
         {
-            for (chunkNb=0; chunkNb<nbChunks; chunkNb++)
-                chunkP[chunkNb].compressedSize = FSED_compressU16(chunkP[chunkNb].compressedBuffer, (const U16*)(chunkP[chunkNb].origBuffer), chunkP[chunkNb].origSize/2, memLog);
-            nbLoops++;
+            const BYTE* const ip = src + (size_t)blockNb*blockSize;
+            const int size = (blockSize < srcSize - blockNb*blockSize) ? blockSize : srcSize - blockNb*blockSize;
+            int nbSymbols, tableLog;
+            if (size <= 1) continue;
+            nbSymbols = FSE_count(count, ip, size, 256);
+            if (nbSymbols <= 1) continue;
+            tableLog = FSE_normalizeCount(count, 0, count, size, nbSymbols);
+            if (tableLog <= 0) continue;
+            if (FSE_sizeof_CTable(nbSymbols, tableLog) > ctSize) ctSize = FSE_sizeof_CTable(nbSymbols, tableLog);
+            if (FSE_sizeof_DTable(tableLog) > dtSize) dtSize = FSE_sizeof_DTable(tableLog);
         }
-        milliTime = BMK_GetMilliSpan(milliTime);
-
-        if ((double)milliTime < fastestC*nbLoops) fastestC = (double)milliTime/nbLoops;
-        cSize=0; for (chunkNb=0; chunkNb<nbChunks; chunkNb++) cSize += chunkP[chunkNb].compressedSize;
-        ratio = (double)cSize/(double)benchedSize*100.;
-
-        DISPLAY("%1i-%-14.14s : %9i -> %9i (%5.2f%%),%7.1f MB/s\r", loopNb, inFileName, (int)benchedSize, (int)cSize, ratio, (double)benchedSize / fastestC / 1000.);
+        CTable = ARN_alloc(arena, ctSize ? ctSize : 1);
+        DTable = ARN_alloc(arena, dtSize ? dtSize : 1);
+    }
+    if (!cBuff || !dBuff || !CTable || !DTable)
+    {
+        DISPLAY("\nError: not enough memory!\n");
+        return 12;
+    }
 
-        //DISPLAY("\n"); continue;   // skip decompression
-        // Decompression
-        //{ size_t i; for (i=0; i<benchedSize; i++) orig_buff[i]=0; }     // zeroing area, for CRC checking
+    for (phase=0; phase<BMK_nbPhases; phase++) fastest[phase] = (U64)-1;
+    start = BMK_getNanos();
+    while ((pass < 2) || (BMK_getNanos() - start < TIMELOOP_NS / 2))   // first pass checks and warms up
+    {
+        int blockNb;
+        for (phase=0; phase<BMK_nbPhases; phase++) passTime[phase] = 0;
+        nbCoded = 0; cSize = 0; hSize = 0;
+        for (blockNb=0; blockNb<nbBlocks; blockNb++)
+        {
+            const BYTE* const ip = src + (size_t)blockNb*blockSize;
+            const int size = (blockSize < srcSize - blockNb*blockSize) ? blockSize : srcSize - blockNb*blockSize;
+            U64 t0, t1;
+            int nbSymbols, tableLog, headerSize, dataSize, dNbSymbols, dTableLog;
+
+            if (size <= 1) continue;
+            t0 = BMK_getNanos();
+            nbSymbols = FSE_count(count, ip, size, 256);
+            t1 = BMK_getNanos(); passTime[BMK_count] += t1-t0; t0 = t1;
+            if (nbSymbols <= 1) continue;
+            tableLog = FSE_normalizeCount(count, 0, count, size, nbSymbols);   // in place, as FSE_compress2()
+            t1 = BMK_getNanos(); passTime[BMK_normalizeCount] += t1-t0; t0 = t1;
+            if (tableLog <= 0) continue;
+            headerSize = FSE_writeHeader(cBuff, count, nbSymbols, tableLog);
+            t1 = BMK_getNanos(); passTime[BMK_writeHeader] += t1-t0; t0 = t1;
+            FSE_buildCTable(CTable, count, nbSymbols, tableLog);
+            t1 = BMK_getNanos(); passTime[BMK_buildCTable] += t1-t0; t0 = t1;
+            dataSize = FSE_compress_usingCTable(cBuff + headerSize, ip, size, CTable);
+            t1 = BMK_getNanos(); passTime[BMK_compressCore] += t1-t0; t0 = t1;
+
+            headerSize = FSE_readHeader(normalized, &dNbSymbols, &dTableLog, cBuff);
+            t1 = BMK_getNanos(); passTime[BMK_readHeader] += t1-t0; t0 = t1;
+            FSE_buildDTable(DTable, normalized, dNbSymbols, dTableLog);
+            t1 = BMK_getNanos(); passTime[BMK_buildDTable] += t1-t0; t0 = t1;
+            FSE_decompress_usingDTable(dBuff, size, cBuff + headerSize, DTable, dTableLog);
+            t1 = BMK_getNanos(); passTime[BMK_decompressCore] += t1-t0;
+
+            if ((pass==0) && memcmp(dBuff, ip, size)) { errorCode = 1; break; }
+            nbCoded++; cSize += headerSize + dataSize; hSize += headerSize;
+        }
+        if (errorCode) break;
+        if (pass++ == 0) continue;
+        for (phase=0; phase<BMK_nbPhases; phase++)
+            if (passTime[phase] < fastest[phase]) fastest[phase] = passTime[phase];
+    }
 
-        nbLoops = 0;
-        milliTime = BMK_GetMilliStart();
-        while(BMK_GetMilliStart() == milliTime);
-        milliTime = BMK_GetMilliStart();
-        while(BMK_GetMilliSpan(milliTime) < TIMELOOP)
+    if (errorCode)
+        DISPLAY("!!! %7i-byte blocks : decoded data differs from source !!!\n", blockSize);
+    else
+    {
+        for (phase=0; phase<BMK_compressCore+1; phase++) totalC += (double)fastest[phase];
+        for (; phase<BMK_nbPhases; phase++) totalD += (double)fastest[phase];
+        DISPLAY("%6i KB blocks : %i/%i entropy-coded, %.2f%% of which is headers, %i passes\n",
+                blockSize>>10, nbCoded, nbBlocks, cSize ? (double)hSize / (double)cSize * 100. : 0., pass-1);
+        for (phase=0; phase<BMK_nbPhases; phase++)
         {
-            for (chunkNb=0; chunkNb<nbChunks; chunkNb++)
-                chunkP[chunkNb].compressedSize = FSED_decompressU16((unsigned short*)chunkP[chunkNb].origBuffer, chunkP[chunkNb].origSize/2, chunkP[chunkNb].compressedBuffer);
-            nbLoops++;
+            const double total = (phase <= BMK_compressCore) ? totalC : totalD;
+            DISPLAY("  %-27.27s : %9.0f ns/block  (%5.1f%% of %s)\n", BMK_phaseNames[phase],
+                    (double)fastest[phase] / (nbCoded ? nbCoded : 1), total > 0. ? (double)fastest[phase] / total * 100. : 0.,
+                    (phase <= BMK_compressCore) ? "compression" : "decompression");
         }
-        milliTime = BMK_GetMilliSpan(milliTime);
+    }
 
-        if ((double)milliTime < fastestD*nbLoops) fastestD = (double)milliTime/nbLoops;
-        DISPLAY("%1i-%-14.14s : %9i -> %9i (%5.2f%%),%7.1f MB/s ,%7.1f MB/s\r", loopNb, inFileName, (int)benchedSize, (int)cSize, ratio, (double)benchedSize / fastestC / 1000., (double)benchedSize / fastestD / 1000.);
+    return errorCode;
+}
 
-        // CRC Checking
-        crcCheck = XXH32(chunkP[0].origBuffer, benchedSize,0);
-        if (crcOrig!=crcCheck) { DISPLAY("\n!!! WARNING !!! %14s : Invalid Checksum : %x != %x\n", inFileName, (unsigned)crcOrig, (unsigned)crcCheck); break; }
+// Buffers and tables are taken from the arena of current file
+static void BMK_profilePhases(ARN_arena* arena, const char* src, int srcSize, const char* inFileName)
+{
+    int blockSize;
+    DISPLAY("Phases of %s :\n", inFileName);
+    for (blockSize = BMK_PHASE_MINBLOCK; blockSize <= chunkSize; blockSize *= 2)
+    {
+        if (BMK_profilePhases_blockSize(arena, (const BYTE*)src, srcSize, blockSize)) break;
+        if (blockSize > srcSize) break;
     }
+}
 
-    if (crcOrig==crcCheck)
+
+// return : nb of chunks
+static int BMK_initChunks(chunkParameters_t* chunkP, char* orig_buff, char* compressedBuffer, char* destBuffer,
+                          size_t benchedSize, int blockSize)
+{
+    const int nbChunks = (int) (benchedSize / blockSize) + 1;
+    const int maxCompressedChunkSize = FSE_compressBound(blockSize);
+    int i;
+    size_t remaining = benchedSize;
+    char* in = orig_buff;
+    char* out = compressedBuffer;
+    char* dst = destBuffer;
+    for (i=0; i<nbChunks; i++)
     {
-        if (ratio<100.)
-            DISPLAY("%-16.16s : %9i -> %9i (%5.2f%%),%7.1f MB/s ,%7.1f MB/s\n", inFileName, (int)benchedSize, (int)cSize, ratio, (double)benchedSize / fastestC / 1000., (double)benchedSize / fastestD / 1000.);
-        else
-            DISPLAY("%-16.16s : %9i -> %9i (%5.1f%%),%7.1f MB/s ,%7.1f MB/s \n", inFileName, (int)benchedSize, (int)cSize, ratio, (double)benchedSize / fastestC / 1000., (double)benchedSize / fastestD / 1000.);
+        chunkP[i].id = i;
+        chunkP[i].origBuffer = in; in += blockSize;
+        if (remaining > (size_t)blockSize) { chunkP[i].origSize = blockSize; remaining -= blockSize; } else { chunkP[i].origSize = (int)remaining; remaining = 0; }
+        chunkP[i].compressedBuffer = out; out += maxCompressedChunkSize;
+        chunkP[i].compressedSize = 0;
+        chunkP[i].destBuffer = dst; dst += blockSize;
     }
-    *totalCompressedSize    += cSize;
-    *totalCompressionTime   += fastestC;
-    *totalDecompressionTime += fastestD;
+    return nbChunks;
 }
 
 
-void BMK_benchMemLog2(chunkParameters_t* chunkP, int nbChunks, char* inFileName, int benchedSize,
-                  U64* totalCompressedSize, double* totalCompressionTime, double* totalDecompressionTime,
-                  int memLog)
+//**************************************
+// Multi-threads scaling
+//**************************************
+/*
+For N = 1 to nb of threads (-T#, default : nb of cores), N tasks of the shared pool compress, then decompress, their own copy of the file,
+using FSE_compress2() and FSE_decompress(), with no shared state besides the library itself.
+Each task allocates and first writes its own buffers, on the worker running it (pinned with --numa, hence local to its node).
+Tasks wait on each other before each timed phase : as N never exceeds the pool size, they all run together.
+Aggregate throughput is the sum of tasks throughputs; efficiency is aggregate / (N * single task throughput).
+*/
+typedef struct
 {
-    int loopNb, chunkNb;
-    size_t cSize=0;
-    double fastestC = 100000000., fastestD = 100000000.;
-    double ratio=0.;
-    U32 crcCheck=0;
-    U32 crcOrig;
+    const char* src;
+    size_t srcSize;
+    int    error;
+    U64    cBytes, cNs;
+    U64    dBytes, dNs;
+#if !defined(_WIN32)
+    pthread_barrier_t* barrier;
+#endif
+} BMK_scalingThread_t;
 
-    // Init
-    crcOrig = XXH32(chunkP[0].origBuffer, benchedSize,0);
+static void BMK_scalingWait(BMK_scalingThread_t* job)
+{
+#if defined(_WIN32)
+    (void)job;
+#else
+    pthread_barrier_wait(job->barrier);
+#endif
+}
 
-    DISPLAY("\r%79s\r", "");
-    for (loopNb = 1; loopNb <= nbIterations; loopNb++)
+// return : 0 (failures are reported into job->error, so that all tasks still reach the barriers)
+static int BMK_scalingTask(void* arg)
+{
+    BMK_scalingThread_t* const job = (BMK_scalingThread_t*)arg;
+    const size_t srcSize = job->srcSize;
+    const int nbChunks = (int)(srcSize / chunkSize) + 1;
+    const int maxCompressedChunkSize = FSE_compressBound(chunkSize);
+    chunkParameters_t* chunkP = (chunkParameters_t*)malloc(nbChunks * sizeof(chunkParameters_t));
+    char* src = (char*)malloc(srcSize ? srcSize : 1);
+    char* compressed = (char*)malloc((size_t)nbChunks * maxCompressedChunkSize);
+    char* dst = (char*)malloc(srcSize ? srcSize : 1);
+    int phase, chunkNb;
+
+    job->error = (!chunkP || !src || !compressed || !dst);
+    if (!job->error)
     {
-        int nbLoops;
-        int milliTime;
-
-        // Compression
-        DISPLAY("%1i-%-14.14s : %9i ->\r", loopNb, inFileName, benchedSize);
-        { int i; for (i=0; i<benchedSize; i++) chunkP[0].compressedBuffer[i]=(char)i; }     // warmimg up memory
+        memcpy(src, job->src, srcSize);
+        BMK_initChunks(chunkP, src, compressed, dst, srcSize, chunkSize);
+    }
 
-        nbLoops = 0;
-        milliTime = BMK_GetMilliStart();
-        while(BMK_GetMilliStart() == milliTime);
-        milliTime = BMK_GetMilliStart();
-        while(BMK_GetMilliSpan(milliTime) < TIMELOOP)
+    for (phase=0; phase<2; phase++)
+    {
+        U64 start, now, bytes = 0;
+        BMK_scalingWait(job);   // all threads start together
+        start = now = BMK_getNanos();
+        while (!job->error && (now - start < TIMELOOP_NS))
         {
             for (chunkNb=0; chunkNb<nbChunks; chunkNb++)
-                chunkP[chunkNb].compressedSize = FSED_compressU16Log2(chunkP[chunkNb].compressedBuffer, (const U16*)(chunkP[chunkNb].origBuffer), chunkP[chunkNb].origSize/2, memLog);
-            nbLoops++;
+            {
+                if (phase==0)
+                    chunkP[chunkNb].compressedSize = FSE_compress2(chunkP[chunkNb].compressedBuffer, (const BYTE*)chunkP[chunkNb].origBuffer, chunkP[chunkNb].origSize, 0, 0);
+                else
+                    FSE_decompress((BYTE*)chunkP[chunkNb].destBuffer, chunkP[chunkNb].origSize, chunkP[chunkNb].compressedBuffer);
+            }
+            bytes += srcSize;
+            now = BMK_getNanos();
         }
-        milliTime = BMK_GetMilliSpan(milliTime);
-
-        if ((double)milliTime < fastestC*nbLoops) fastestC = (double)milliTime/nbLoops;
-        cSize=0; for (chunkNb=0; chunkNb<nbChunks; chunkNb++) cSize += chunkP[chunkNb].compressedSize;
-        ratio = (double)cSize/(double)benchedSize*100.;
-
-        DISPLAY("%1i-%-14.14s : %9i -> %9i (%5.2f%%),%7.1f MB/s\r", loopNb, inFileName, (int)benchedSize, (int)cSize, ratio, (double)benchedSize / fastestC / 1000.);
+        if (phase==0) { job->cBytes = bytes; job->cNs = now - start; }
+        else          { job->dBytes = bytes; job->dNs = now - start; }
+    }
+    if (!job->error && memcmp(src, dst, srcSize)) job->error = 1;
 
-        //DISPLAY("\n"); continue;   // skip decompression
-        // Decompression
-        //{ size_t i; for (i=0; i<benchedSize; i++) orig_buff[i]=0; }     // zeroing area, for CRC checking
+    free(chunkP); free(src); free(compressed); free(dst);
+    return 0;
+}
 
-        nbLoops = 0;
-        milliTime = BMK_GetMilliStart();
-        while(BMK_GetMilliStart() == milliTime);
-        milliTime = BMK_GetMilliStart();
-        while(BMK_GetMilliSpan(milliTime) < 0) // TIMELOOP)
+// return : 0, or an error code
+static int BMK_benchScaling(const char* src, size_t srcSize, const char* inFileName)
+{
+#if defined(_WIN32)
+    const int maxThreads = 1;
+#else
+    const int maxThreads = SCH_getNbThreads();
+#endif
+    const size_t perThread = srcSize + (srcSize / chunkSize + 1) * FSE_compressBound(chunkSize) + srcSize;
+    BMK_scalingThread_t* jobs = (BMK_scalingThread_t*)malloc(maxThreads * sizeof(BMK_scalingThread_t));
+    double singleC = 0., singleD = 0.;
+    int nbThreads, t, error = 0;
+
+    if (jobs==NULL) { DISPLAY("\nError: not enough memory!\n"); return 12; }
+    DISPLAY("Scaling of %s, %i KB blocks (%i threads max) :\n", inFileName, chunkSize>>10, maxThreads);
+    for (nbThreads=1; (nbThreads<=maxThreads) && !error; nbThreads++)
+    {
+        double aggregateC = 0., aggregateD = 0.;
+        SCH_group* group;
+#if !defined(_WIN32)
+        pthread_barrier_t barrier;
+#endif
+        if ((size_t)nbThreads * perThread > MEM_getBudget())
         {
-            for (chunkNb=0; chunkNb<nbChunks; chunkNb++)
-                chunkP[chunkNb].compressedSize = FSED_decompressU16((unsigned short*)chunkP[chunkNb].origBuffer, chunkP[chunkNb].origSize/2, chunkP[chunkNb].compressedBuffer);
-            nbLoops++;
+            DISPLAY("%3i threads : exceeds memory budget (%i MB), stopping\n", nbThreads, (int)(MEM_getBudget()>>20));
+            break;
         }
-        milliTime = BMK_GetMilliSpan(milliTime);
+        group = SCH_createGroup(NULL);
+        if (group==NULL) { error = 12; break; }
+#if !defined(_WIN32)
+        pthread_barrier_init(&barrier, NULL, nbThreads);
+#endif
+        DISPLAY("%3i threads ...\r", nbThreads);
+        for (t=0; t<nbThreads; t++)
+        {
+            memset(jobs+t, 0, sizeof(BMK_scalingThread_t));
+            jobs[t].src = src;
+            jobs[t].srcSize = srcSize;
+#if !defined(_WIN32)
+            jobs[t].barrier = &barrier;
+#endif
+            if (SCH_submit(group, BMK_scalingTask, jobs+t)) { DISPLAY("\nError: cannot submit task\n"); exit(14); }
+        }
+        SCH_wait(group, 0);
+        SCH_freeGroup(group);
+#if !defined(_WIN32)
+        pthread_barrier_destroy(&barrier);
+#endif
+        for (t=0; t<nbThreads; t++)
+        {
+            if (jobs[t].error) { DISPLAY("\n!!! %3i threads : thread %i failed (memory or invalid data) !!!\n", nbThreads, t); error = 1; }
+            if (jobs[t].cNs) aggregateC += (double)jobs[t].cBytes / (double)jobs[t].cNs * 1000.;
+            if (jobs[t].dNs) aggregateD += (double)jobs[t].dBytes / (double)jobs[t].dNs * 1000.;
+        }
+        if (error) break;
+        if (nbThreads==1) { singleC = aggregateC; singleD = aggregateD; }
+        DISPLAY("%3i threads : C %8.1f MB/s (%5.1f%% per core) , D %8.1f MB/s (%5.1f%% per core)\n", nbThreads,
+                aggregateC, singleC > 0. ? aggregateC / (nbThreads * singleC) * 100. : 0.,
+                aggregateD, singleD > 0. ? aggregateD / (nbThreads * singleD) * 100. : 0.);
+    }
+    free(jobs);
+    return error;
+}
 
-        if ((double)milliTime < fastestD*nbLoops) fastestD = (double)milliTime/nbLoops;
-        DISPLAY("%1i-%-14.14s : %9i -> %9i (%5.2f%%),%7.1f MB/s ,%7.1f MB/s\r", loopNb, inFileName, (int)benchedSize, (int)cSize, ratio, (double)benchedSize / fastestC / 1000., (double)benchedSize / fastestD / 1000.);
 
-        // CRC Checking
-        crcCheck = XXH32(chunkP[0].origBuffer, benchedSize,0);
-        if (crcOrig!=crcCheck) { DISPLAY("\n!!! WARNING !!! %14s : Invalid Checksum : %x != %x\n", inFileName, (unsigned)crcOrig, (unsigned)crcCheck); break; }
-    }
+//**************************************
+// Latency
+//**************************************
+/*
+Messages are slices of the file, at random positions, with sizes drawn from a log-uniform distribution
+between BMK_LAT_MINSIZE and block size (-B#) : as many small messages as large ones, per size decade.
+Each FSE_compress2() and FSE_decompress() call is timed on its own, into a histogram with
+BMK_HIST_SUBBITS significant bits (relative precision < 1%), as HdrHistogram does.
+*/
+#define BMK_LAT_MINSIZE     64
+#define BMK_LAT_NBMESSAGES  4096
+#define BMK_HIST_SUBBITS    7
+#define BMK_HIST_SIZE       ((64 - BMK_HIST_SUBBITS + 1) << BMK_HIST_SUBBITS)
 
-    if (crcOrig==crcCheck)
-    {
-        if (ratio<100.)
-            DISPLAY("%-16.16s : %9i -> %9i (%5.2f%%),%7.1f MB/s ,%7.1f MB/s\n", inFileName, (int)benchedSize, (int)cSize, ratio, (double)benchedSize / fastestC / 1000., (double)benchedSize / fastestD / 1000.);
-        else
-            DISPLAY("%-16.16s : %9i -> %9i (%5.1f%%),%7.1f MB/s ,%7.1f MB/s \n", inFileName, (int)benchedSize, (int)cSize, ratio, (double)benchedSize / fastestC / 1000., (double)benchedSize / fastestD / 1000.);
-    }
-    *totalCompressedSize    += cSize;
-    *totalCompressionTime   += fastestC;
-    *totalDecompressionTime += fastestD;
+typedef struct
+{
+    U64 count[BMK_HIST_SIZE];
+    U64 total;
+    U64 max;
+    U64 sum;
+} BMK_histogram_t;
+
+static U32 BMK_rand(U32* state)
+{
+    *state = (*state * KNUTH) + 12345;
+    return *state >> 8;
 }
 
+static int BMK_histIndex(U64 value)
+{
+    int shift = 0;
+    while ((value >> shift) >= (1U << BMK_HIST_SUBBITS)) shift++;
+    return (shift << BMK_HIST_SUBBITS) + (int)(value >> shift);
+}
 
-void BMK_benchMem285(chunkParameters_t* chunkP, int nbChunks, char* inFileName, int benchedSize,
-                  U64* totalCompressedSize, double* totalCompressionTime, double* totalDecompressionTime,
-                  int memLog)
+// return : highest value of bucket 'index'
+static U64 BMK_histValue(int index)
 {
-    int loopNb, chunkNb;
-    size_t cSize=0;
-    double fastestC = 100000000., fastestD = 100000000.;
-    double ratio=0.;
-    U32 crcCheck=0;
-    U32 crcOrig;
+    const int shift = index >> BMK_HIST_SUBBITS;
+    const U64 sub = (U64)(index & ((1 << BMK_HIST_SUBBITS) - 1));
+    return ((sub+1) << shift) - 1;
+}
 
-    // Init
-    crcOrig = XXH32(chunkP[0].origBuffer, benchedSize,0);
+static void BMK_histAdd(BMK_histogram_t* hist, U64 value)
+{
+    hist->count[BMK_histIndex(value)]++;
+    hist->total++;
+    hist->sum += value;
+    if (value > hist->max) hist->max = value;
+}
 
-    DISPLAY("\r%79s\r", "");
-    for (loopNb = 1; loopNb <= nbIterations; loopNb++)
+static U64 BMK_histPercentile(const BMK_histogram_t* hist, double percentile)
+{
+    const U64 target = (U64)((double)hist->total * percentile / 100. + 0.5);
+    U64 cumulated = 0;
+    int i;
+    for (i=0; i<BMK_HIST_SIZE; i++)
     {
-        int nbLoops;
-        int milliTime;
+        cumulated += hist->count[i];
+        if ((cumulated >= target) && (cumulated > 0)) return (BMK_histValue(i) < hist->max) ? BMK_histValue(i) : hist->max;
+    }
+    return hist->max;
+}
 
-        // Compression
-        DISPLAY("%1i-%-14.14s : %9i ->\r", loopNb, inFileName, benchedSize);
-        { int i; for (i=0; i<benchedSize; i++) chunkP[0].compressedBuffer[i]=(char)i; }     // warmimg up memory
+static void BMK_histDisplay(const BMK_histogram_t* hist, const char* name)
+{
+    static const double percentiles[] = { 0., 50., 75., 90., 99., 99.9, 99.99, 100. };
+    int i;
+    if (hist->total==0) return;
+    DISPLAY("%s : %llu calls, mean %.0f ns\n", name, (long long unsigned)hist->total, (double)hist->sum / (double)hist->total);
+    DISPLAY("  %9s %12s %12s\n", "Percentile", "Value (ns)", "Count");
+    for (i=0; i<(int)(sizeof(percentiles)/sizeof(percentiles[0])); i++)
+    {
+        const U64 value = BMK_histPercentile(hist, percentiles[i]);
+        const U64 count = (U64)((double)hist->total * percentiles[i] / 100. + 0.5);
+        if ((percentiles[i] > 99.) && (hist->total * (100.-percentiles[i]) < 100.) && (percentiles[i] < 100.)) continue;   // not enough calls
+        DISPLAY("  %9.3f%% %12llu %12llu\n", percentiles[i], (long long unsigned)value, (long long unsigned)count);
+    }
+}
 
-        nbLoops = 0;
-        milliTime = BMK_GetMilliStart();
-        while(BMK_GetMilliStart() == milliTime);
-        milliTime = BMK_GetMilliStart();
-        while(BMK_GetMilliSpan(milliTime) < TIMELOOP)
+// return : 0, or an error code; buffers are taken from the arena of current file
+static int BMK_benchLatency(ARN_arena* arena, char* orig_buff, size_t benchedSize, const char* inFileName)
+{
+    const int maxSize = (benchedSize < (size_t)chunkSize) ? (int)benchedSize : chunkSize;
+    chunkParameters_t* messages;
+    char* compressed;
+    char* dst;
+    BMK_histogram_t* hist;
+    size_t totalSize = 0, compressedCapacity = 0;
+    U32 seed = 1;
+    int i, phase, error = 0;
+
+    if (maxSize < BMK_LAT_MINSIZE) { DISPLAY("%s : too small for latency benchmark\n", inFileName); return 0; }
+
+    // Messages
+    messages = (chunkParameters_t*)ARN_alloc(arena, BMK_LAT_NBMESSAGES * sizeof(chunkParameters_t));
+    if (messages==NULL) { DISPLAY("\nError: not enough memory!\n"); return 12; }
+    for (i=0; i<BMK_LAT_NBMESSAGES; i++)
+    {
+        const double u = (double)(BMK_rand(&seed) & 0xFFFFFF) / (double)(1<<24);
+        const int size = (int)((double)BMK_LAT_MINSIZE * pow((double)maxSize / BMK_LAT_MINSIZE, u));
+        const size_t position = ((size_t)BMK_rand(&seed) << 8 | (BMK_rand(&seed) & 0xFF)) % (benchedSize - size + 1);
+        messages[i].id = i;
+        messages[i].origBuffer = orig_buff + position;
+        messages[i].origSize = size;
+        messages[i].compressedSize = 0;
+        totalSize += size;
+        compressedCapacity += FSE_compressBound(size);
+    }
+    compressed = (char*)ARN_alloc(arena, compressedCapacity);
+    dst = (char*)ARN_alloc(arena, maxSize);
+    hist = (BMK_histogram_t*)ARN_alloc(arena, 2 * sizeof(BMK_histogram_t));
+    if (!compressed || !dst || !hist) { DISPLAY("\nError: not enough memory!\n"); return 12; }
+    memset(hist, 0, 2 * sizeof(BMK_histogram_t));
+    {
+        char* op = compressed;
+        for (i=0; i<BMK_LAT_NBMESSAGES; i++) { messages[i].compressedBuffer = op; messages[i].destBuffer = dst; op += FSE_compressBound(messages[i].origSize); }
+    }
+
+    DISPLAY("Latency on %s : %i messages, %i - %i bytes (log-uniform), mean %i bytes\n",
+            inFileName, BMK_LAT_NBMESSAGES, BMK_LAT_MINSIZE, maxSize, (int)(totalSize / BMK_LAT_NBMESSAGES));
+    for (phase=0; (phase<2) && !error; phase++)
+    {
+        const U64 start = BMK_getNanos();
+        int loopNb = 0;
+        DISPLAY("%s...\r", phase ? "decompression" : "compression");
+        while ((loopNb==0) || (BMK_getNanos() - start < (U64)nbIterations * BMK_timeLoopNs / 2))
         {
-            for (chunkNb=0; chunkNb<nbChunks; chunkNb++)
-                chunkP[chunkNb].compressedSize = FSE_compressU16(chunkP[chunkNb].compressedBuffer, (const U16*)(chunkP[chunkNb].origBuffer), chunkP[chunkNb].origSize/2, 0, memLog);
-            nbLoops++;
+            for (i=0; i<BMK_LAT_NBMESSAGES; i++)
+            {
+                chunkParameters_t* const m = messages + i;
+                U64 t0 = BMK_getNanos(), t1;
+                if (phase==0) m->compressedSize = FSE_compress2(m->compressedBuffer, (const BYTE*)m->origBuffer, m->origSize, 0, 0);
+                else m->destSize = FSE_decompress((BYTE*)m->destBuffer, m->origSize, m->compressedBuffer);
+                t1 = BMK_getNanos();
+                if (loopNb > 0) BMK_histAdd(hist+phase, t1-t0);   // first pass warms up
+                if ((phase==1) && (loopNb==0) && ((m->destSize != m->compressedSize) || memcmp(m->destBuffer, m->origBuffer, m->origSize)))
+                    { DISPLAY("\n!!! message %i : decoded data differs from source !!!\n", i); error = 1; break; }
+            }
+            loopNb++;
+            if (error) break;
         }
-        milliTime = BMK_GetMilliSpan(milliTime);
+    }
+    if (!error)
+    {
+        BMK_histDisplay(hist+0, "FSE_compress2  ");
+        BMK_histDisplay(hist+1, "FSE_decompress ");
+    }
 
-        if ((double)milliTime < fastestC*nbLoops) fastestC = (double)milliTime/nbLoops;
-        cSize=0; for (chunkNb=0; chunkNb<nbChunks; chunkNb++) cSize += chunkP[chunkNb].compressedSize;
-        ratio = (double)cSize/(double)benchedSize*100.;
+    return error;
+}
 
-        DISPLAY("%1i-%-14.14s : %9i -> %9i (%5.2f%%),%7.1f MB/s\r", loopNb, inFileName, (int)benchedSize, (int)cSize, ratio, (double)benchedSize / fastestC / 1000.);
 
-        //DISPLAY("\n"); continue;   // skip decompression
-        // Decompression
-        //{ size_t i; for (i=0; i<benchedSize; i++) orig_buff[i]=0; }     // zeroing area, for CRC checking
+//**************************************
+// Sweep
+//**************************************
+/*
+Benchmarks each block size, from BMK_SWEEP_MINBLOCK to BMK_SWEEP_MAXBLOCK (or whole file), with each tableLog,
+from BMK_SWEEP_MINLOG to the maximum supported by the library. Each point is timed for TIMELOOP/10 per iteration.
+Then displays points which are not dominated by any other one, on ratio, compression and decompression speeds.
+Note : FSE_normalizeCount() raises tableLog to represent all symbols, and lowers it beyond block size :
+such tableLogs are skipped, since they would only duplicate (and mislabel) another point.
+*/
+#define BMK_SWEEP_MINBLOCK  (1 KB)
+#define BMK_SWEEP_MAXBLOCK  (32 MB)
+#define BMK_SWEEP_MINLOG    5
+#define BMK_SWEEP_MAXPOINTS 256
 
-        nbLoops = 0;
-        milliTime = BMK_GetMilliStart();
-        while(BMK_GetMilliStart() == milliTime);
-        milliTime = BMK_GetMilliStart();
-        while(BMK_GetMilliSpan(milliTime) < TIMELOOP)
-        {
-            int total = 0;
-            for (chunkNb=0; chunkNb<nbChunks; chunkNb++)
-            {
-                total += chunkP[chunkNb].origSize;
-                chunkP[chunkNb].compressedSize = FSE_decompressU16((unsigned short*)chunkP[chunkNb].destBuffer, chunkP[chunkNb].origSize/2, chunkP[chunkNb].compressedBuffer);
-            }
-            nbLoops++;
-        }
-        milliTime = BMK_GetMilliSpan(milliTime);
+typedef struct
+{
+    int blockSize;
+    int tableLog;
+    U64 cSize;
+    double cSpeed;
+    double dSpeed;
+} BMK_point_t;
+
+static int BMK_maxTableLog(void)
+{
+    int tableLog = BMK_SWEEP_MINLOG;
+    while (FSE_sizeof_CTable(256, tableLog+1) > 0) tableLog++;
+    return tableLog;
+}
 
-        if ((double)milliTime < fastestD*nbLoops) fastestD = (double)milliTime/nbLoops;
-        DISPLAY("%1i-%-14.14s : %9i -> %9i (%5.2f%%),%7.1f MB/s ,%7.1f MB/s\r", loopNb, inFileName, (int)benchedSize, (int)cSize, ratio, (double)benchedSize / fastestC / 1000., (double)benchedSize / fastestD / 1000.);
+static int BMK_dominates(const BMK_point_t* a, const BMK_point_t* b)
+{
+    if ((a->cSize > b->cSize) || (a->cSpeed < b->cSpeed) || (a->dSpeed < b->dSpeed)) return 0;
+    return (a->cSize < b->cSize) || (a->cSpeed > b->cSpeed) || (a->dSpeed > b->dSpeed);
+}
+
+static void BMK_sweepMem(chunkParameters_t* chunkP, char* orig_buff, char* compressedBuffer, char* destBuffer,
+                         size_t benchedSize, char* inFileName)
+{
+    static BMK_point_t points[BMK_SWEEP_MAXPOINTS];
+    const int savedChunkSize = chunkSize;
+    const int maxLog = BMK_maxTableLog();
+    int nbPoints = 0, blockSize, tableLog, minLog = BMK_SWEEP_MINLOG, i, j;
+
+    {   // smallest tableLog which can represent all symbol values : tableSize > nbSymbols
+        U32 count[256];
+        const int nbSymbols = FSE_count(count, (const BYTE*)orig_buff, (int)benchedSize, 256);
+        while ((1<<minLog) <= nbSymbols) minLog++;
+    }
 
-        // CRC Checking
-        crcCheck = XXH32(chunkP[0].destBuffer, benchedSize,0);
-        if (crcOrig!=crcCheck)
+    BMK_timeLoopNs = TIMELOOP_NS / 10;
+    BMK_recordName = inFileName;
+    for (blockSize = BMK_SWEEP_MINBLOCK; blockSize <= (int)BMK_SWEEP_MAXBLOCK; blockSize *= 2)
+    {
+        const int nbChunks = BMK_initChunks(chunkP, orig_buff, compressedBuffer, destBuffer, benchedSize, blockSize);
+        const size_t blockBytes = ((size_t)blockSize < benchedSize) ? (size_t)blockSize : benchedSize;
+        int blockLog = minLog;   // largest useful tableLog for this block size
+        while ((blockLog < maxLog) && ((size_t)1<<blockLog < blockBytes)) blockLog++;
+        chunkSize = blockSize;   // for results
+        for (tableLog = minLog; (tableLog <= blockLog) && (nbPoints < BMK_SWEEP_MAXPOINTS); tableLog++)
         {
-            const char* src = chunkP[0].origBuffer;
-            const char* fin = chunkP[0].destBuffer;
-            const char* const srcStart = src;
-            while (*src==*fin) src++, fin++;
-            DISPLAY("\n!!! %14s : Invalid Checksum !!! pos %i/%i\n", inFileName, (int)(src-srcStart), benchedSize);
-            break;
+            BMK_point_t* const point = points + nbPoints++;
+            char label[32];
+            U64 cSize = 0;
+            double cTime = 0., dTime = 0.;
+            sprintf(label, "%iK,log%i", blockSize>>10, tableLog);
+            BMK_benchCodec(BMK_codecs, chunkP, nbChunks, label, (int)benchedSize, &cSize, &cTime, &dTime, 256, tableLog);   // fse
+            point->blockSize = blockSize;
+            point->tableLog = tableLog;
+            point->cSize = cSize;
+            point->cSpeed = (double)benchedSize / cTime / 1000.;
+            point->dSpeed = (double)benchedSize / dTime / 1000.;
         }
+        if ((size_t)blockSize >= benchedSize) break;   // larger blocks would give same results
     }
+    chunkSize = savedChunkSize;
+    BMK_recordName = NULL;
+    BMK_timeLoopNs = TIMELOOP_NS;
 
-    if (crcOrig==crcCheck)
+    // Pareto frontier, by increasing compressed size
+    DISPLAY("Pareto frontier of %s (ratio, compression speed, decompression speed) :\n", inFileName);
+    for (i=0; i<nbPoints; i++)
     {
-        if (ratio<100.)
-            DISPLAY("%-16.16s : %9i -> %9i (%5.2f%%),%7.1f MB/s ,%7.1f MB/s\n", inFileName, (int)benchedSize, (int)cSize, ratio, (double)benchedSize / fastestC / 1000., (double)benchedSize / fastestD / 1000.);
-        else
-            DISPLAY("%-16.16s : %9i -> %9i (%5.1f%%),%7.1f MB/s ,%7.1f MB/s \n", inFileName, (int)benchedSize, (int)cSize, ratio, (double)benchedSize / fastestC / 1000., (double)benchedSize / fastestD / 1000.);
+        const BMK_point_t* best = NULL;
+        for (j=0; j<nbPoints; j++)
+        {
+            int k, dominated = 0;
+            if (points[j].blockSize < 0) continue;   // already displayed
+            for (k=0; (k<nbPoints) && !dominated; k++) dominated = BMK_dominates(points+k, points+j);
+            if (dominated) continue;
+            if ((best==NULL) || (points[j].cSize < best->cSize)) best = points+j;
+        }
+        if (best==NULL) break;
+        DISPLAY("  %6i KB, tableLog %2i : %9llu (%5.2f%%),%7.1f MB/s ,%7.1f MB/s\n", best->blockSize>>10, best->tableLog,
+                (long long unsigned)best->cSize, (double)best->cSize / (double)benchedSize * 100., best->cSpeed, best->dSpeed);
+        points[best-points].blockSize = -best->blockSize;   // mark as displayed; still dominates others
     }
-    *totalCompressedSize    += cSize;
-    *totalCompressionTime   += fastestC;
-    *totalDecompressionTime += fastestD;
 }
 
 
-int BMK_FSE2T_compress2(void* dest, const unsigned char* src, int srcSize, int nbSymbols, int tableLog)
-{ (void)nbSymbols; (void)tableLog; return FSE2T_compress2(dest, src, srcSize, 10); }
-
+//**************************************
+// TableLogs
+//**************************************
+/*
+Benchmarks selected codecs at block size -B, with each tableLog from BMK_TABLELOGS_MINLOG to the maximum supported
+by the library (15 when compiled with FSE_MAX_MEMORY_USAGE=17, see fse_large target).
+Then displays, for each tableLog, decoding table size, ratio, and its loss versus the largest tableLog, with speeds :
+beyond 16 KB, tables no longer fit L1 cache, and FSE decoder prefetches them.
+*/
+#define BMK_TABLELOGS_MINLOG 9
 
-void BMK_benchMem(chunkParameters_t* chunkP, int nbChunks, char* inFileName, int benchedSize,
-                  U64* totalCompressedSize, double* totalCompressionTime, double* totalDecompressionTime,
-                  int nbSymbols, int memLog)
+static void BMK_tableLogsMem(chunkParameters_t* chunkP, int nbChunks, size_t benchedSize, char* inFileName)
 {
-    int loopNb, chunkNb;
-    size_t cSize=0;
-    double fastestC = 100000000., fastestD = 100000000.;
-    double ratio=0.;
-    U32 crcCheck=0;
-    U32 crcOrig;
-    int (*compressor)(void*, const unsigned char*, int, int, int);
-    int (*decompressor)(unsigned char*, int, const void*);
-
-    // Init
-    if (nbSymbols==0) { BMK_benchMemU16 (chunkP, nbChunks, inFileName, benchedSize, totalCompressedSize, totalCompressionTime, totalDecompressionTime, memLog); return; }
-    if (nbSymbols==1) { BMK_benchMemU32 (chunkP, nbChunks, inFileName, benchedSize, totalCompressedSize, totalCompressionTime, totalDecompressionTime, memLog); return; }
-    if (nbSymbols==2) { BMK_benchMemLog2(chunkP, nbChunks, inFileName, benchedSize, totalCompressedSize, totalCompressionTime, totalDecompressionTime, memLog); return; }
-    if (nbSymbols==3) { BMK_benchMem285 (chunkP, nbChunks, inFileName, benchedSize, totalCompressedSize, totalCompressionTime, totalDecompressionTime, memLog); return; }
-    crcOrig = XXH32(chunkP[0].origBuffer, benchedSize,0);
-    switch(BMK_byteCompressor)
-    {
-    case 2:
-        compressor = BMK_FSE2T_compress2;
-        decompressor = FSE2T_decompress;
-        break;
-    default:
-        compressor = FSE_compress2;
-        decompressor = FSE_decompress;
-    }
+    static BMK_point_t points[BMK_SWEEP_MAXPOINTS];
+    const int maxLog = BMK_maxTableLog();
+    int codecNb, i;
 
-    DISPLAY("\r%79s\r", "");
-    for (loopNb = 1; loopNb <= nbIterations; loopNb++)
+    BMK_recordName = inFileName;
+    for (codecNb=0; codecNb<BMK_nbSelected; codecNb++)
     {
-        int nbLoops;
-        int milliTime;
-
-        // Compression
-        DISPLAY("%1i-%-14.14s : %9i ->\r", loopNb, inFileName, benchedSize);
-        { int i; for (i=0; i<benchedSize; i++) chunkP[0].compressedBuffer[i]=(char)i; }     // warmimg up memory
+        const BMK_codec_t* const codec = BMK_selected[codecNb];
+        int nbPoints = 0, tableLog;
+        for (tableLog = BMK_TABLELOGS_MINLOG; tableLog <= maxLog; tableLog++)
+        {
+            BMK_point_t* const point = points + nbPoints++;
+            char label[32];
+            U64 cSize = 0;
+            double cTime = 0., dTime = 0.;
+            sprintf(label, "%.16s,log%i", codec->name, tableLog);
+            BMK_benchCodec(codec, chunkP, nbChunks, label, (int)benchedSize, &cSize, &cTime, &dTime, 256, tableLog);
+            point->tableLog = tableLog;
+            point->cSize = cSize;
+            point->cSpeed = (double)benchedSize / cTime / 1000.;
+            point->dSpeed = (dTime > 0.) ? (double)benchedSize / dTime / 1000. : 0.;
+        }
 
-        nbLoops = 0;
-        milliTime = BMK_GetMilliStart();
-        while(BMK_GetMilliStart() == milliTime);
-        milliTime = BMK_GetMilliStart();
-        while(BMK_GetMilliSpan(milliTime) < TIMELOOP)
+        DISPLAY("tableLogs of %s, %s, %i KB blocks :\n", inFileName, codec->name, chunkSize>>10);
+        DISPLAY("  tableLog  DTable :    ratio   loss vs log%i ,  C speed  ,  D speed\n", maxLog);
+        for (i=0; i<nbPoints; i++)
         {
-            for (chunkNb=0; chunkNb<nbChunks; chunkNb++)
-                chunkP[chunkNb].compressedSize = compressor(chunkP[chunkNb].compressedBuffer, (unsigned char*)chunkP[chunkNb].origBuffer, chunkP[chunkNb].origSize, nbSymbols, memLog);
-            nbLoops++;
+            const BMK_point_t* const p = points + i;
+            const BMK_point_t* const best = points + nbPoints-1;
+            DISPLAY("  %8i %5i KB : %7.3f%%  %+8.3f%%     ,%7.1f MB/s ,%7.1f MB/s\n", p->tableLog, FSE_sizeof_DTable(p->tableLog) >> 10,
+                    (double)p->cSize / (double)benchedSize * 100., ((double)p->cSize / (double)best->cSize - 1.) * 100., p->cSpeed, p->dSpeed);
         }
-        milliTime = BMK_GetMilliSpan(milliTime);
+    }
+    BMK_recordName = NULL;
+}
 
-        if ((double)milliTime < fastestC*nbLoops) fastestC = (double)milliTime/nbLoops;
-        cSize=0; for (chunkNb=0; chunkNb<nbChunks; chunkNb++) cSize += chunkP[chunkNb].compressedSize;
-        ratio = (double)cSize/(double)benchedSize*100.;
 
-        DISPLAY("%1i-%-14.14s : %9i -> %9i (%5.2f%%),%7.1f MB/s\r", loopNb, inFileName, (int)benchedSize, (int)cSize, ratio, (double)benchedSize / fastestC / 1000.);
+//**************************************
+// Spreads
+//**************************************
+/*
+Compares symbol spreads (see FSE_compress_spread()) at current block size and default tableLog.
+For each spread, displays ratio, loss of entropy-coded data versus source entropy (headers excluded, they don't depend on spread),
+time to build one CTable and one DTable (average over blocks, fastest of TIMELOOP/10), and speeds of its codec.
+*/
+static const char* const BMK_spreadNames[FSE_NB_SPREADS] = { "step", "sorted", "precise" };
+static const char* const BMK_spreadCodecs[FSE_NB_SPREADS] = { "fse", "fseSorted", "fsePrecise" };
 
-        //DISPLAY("\n"); continue;   // skip decompression
-        // Decompression
-        //{ size_t i; for (i=0; i<benchedSize; i++) orig_buff[i]=0; }     // zeroing area, for CRC checking
+// Tables are taken from the arena of current file
+static int BMK_spreadsMem(ARN_arena* arena, chunkParameters_t* chunkP, int nbChunks, size_t benchedSize, char* inFileName)
+{
+    const int nbBlocks = nbChunks;
+    U32 (*normalized)[256] = (U32(*)[256])ARN_alloc(arena, (size_t)nbBlocks * sizeof(*normalized));
+    int* nbSymbols = (int*)ARN_alloc(arena, (size_t)nbBlocks * sizeof(int));
+    int* tableLogs = (int*)ARN_alloc(arena, (size_t)nbBlocks * sizeof(int));
+    void* CTable = ARN_alloc(arena, FSE_sizeof_CTable(256, BMK_maxTableLog()));
+    void* DTable = ARN_alloc(arena, FSE_sizeof_DTable(BMK_maxTableLog()));
+    int spread, blockNb, nbTables = 0;
+
+    if (!normalized || !nbSymbols || !tableLogs || !CTable || !DTable)
+    {
+        DISPLAY("\nError: not enough memory!\n");
+        return 12;
+    }
 
-        nbLoops = 0;
-        milliTime = BMK_GetMilliStart();
-        while(BMK_GetMilliStart() == milliTime);
-        milliTime = BMK_GetMilliStart();
-        while(BMK_GetMilliSpan(milliTime) < TIMELOOP)
+    // Tables to build : same as FSE_compress2(), computed once
+    for (blockNb=0; blockNb<nbBlocks; blockNb++)
+    {
+        const chunkParameters_t* const chunk = chunkP + blockNb;
+        int n, tableLog = -1;
+        if (chunk->origSize > 1)
         {
-            for (chunkNb=0; chunkNb<nbChunks; chunkNb++)
-                chunkP[chunkNb].compressedSize = decompressor((unsigned char*)chunkP[chunkNb].origBuffer, chunkP[chunkNb].origSize, chunkP[chunkNb].compressedBuffer);
-            nbLoops++;
+            n = FSE_count(normalized[nbTables], (const BYTE*)chunk->origBuffer, chunk->origSize, 256);
+            if (n > 1) tableLog = FSE_normalizeCount(normalized[nbTables], 0, normalized[nbTables], chunk->origSize, n);
+            nbSymbols[nbTables] = n;
         }
-        milliTime = BMK_GetMilliSpan(milliTime);
-
-        if ((double)milliTime < fastestD*nbLoops) fastestD = (double)milliTime/nbLoops;
-        DISPLAY("%1i-%-14.14s : %9i -> %9i (%5.2f%%),%7.1f MB/s ,%7.1f MB/s\r", loopNb, inFileName, (int)benchedSize, (int)cSize, ratio, (double)benchedSize / fastestC / 1000., (double)benchedSize / fastestD / 1000.);
-
-        // CRC Checking
-        crcCheck = XXH32(chunkP[0].origBuffer, benchedSize,0);
-        if (crcOrig!=crcCheck) { DISPLAY("\n!!! WARNING !!! %14s : Invalid Checksum : %x != %x\n", inFileName, (unsigned)crcOrig, (unsigned)crcCheck); break; }
+        if (tableLog <= 0) continue;   // not entropy-coded
+        tableLogs[nbTables++] = tableLog;
     }
 
-    if (crcOrig==crcCheck)
+    BMK_recordName = inFileName;
+    DISPLAY("Spreads of %s, %i KB blocks, %i tables :\n", inFileName, chunkSize>>10, nbTables);
+    DISPLAY("   spread :    ratio   loss vs entropy , CTable build, DTable build ,  C speed  ,  D speed\n");
+    for (spread=0; spread<FSE_NB_SPREADS; spread++)
     {
-        if (ratio<100.)
-            DISPLAY("%-16.16s : %9i -> %9i (%5.2f%%),%7.1f MB/s ,%7.1f MB/s\n", inFileName, (int)benchedSize, (int)cSize, ratio, (double)benchedSize / fastestC / 1000., (double)benchedSize / fastestD / 1000.);
-        else
-            DISPLAY("%-16.16s : %9i -> %9i (%5.1f%%),%7.1f MB/s ,%7.1f MB/s \n", inFileName, (int)benchedSize, (int)cSize, ratio, (double)benchedSize / fastestC / 1000., (double)benchedSize / fastestD / 1000.);
+        const BMK_codec_t* const codec = BMK_findCodec(BMK_spreadCodecs[spread], strlen(BMK_spreadCodecs[spread]));
+        U64 fastestC = (U64)-1, fastestD = (U64)-1, start, cSize = 0, dataBytes = 0, codecSize = 0;
+        char label[32];
+        double entropy = 0., cTime = 0., dTime = 0.;
+        int pass = 0, i;
+
+        // ratio, and coding loss
+        for (blockNb=0; blockNb<nbBlocks; blockNb++)
+        {
+            const chunkParameters_t* const chunk = chunkP + blockNb;
+            int size;
+            FSE_getBlockStats()->entropy = 0.;
+            FSE_getBlockStats()->dataBytes = 0;
+            size = FSE_compress_spread(chunk->compressedBuffer, (const BYTE*)chunk->origBuffer, chunk->origSize, 256, 0, spread);
+            if (size == -1) { DISPLAY("!!! %s : error compressing block %i !!!\n", BMK_spreadNames[spread], blockNb); break; }
+            cSize += size;
+            if (FSE_getBlockStats()->dataBytes == 0) continue;
+            entropy += FSE_getBlockStats()->entropy;
+            dataBytes += FSE_getBlockStats()->dataBytes;
+        }
+
+        // table builds
+        start = BMK_getNanos();
+        while ((pass < 2) || (BMK_getNanos() - start < TIMELOOP_NS / 10))
+        {
+            U64 t0 = BMK_getNanos(), t1;
+            for (i=0; i<nbTables; i++) FSE_buildCTable_spread(CTable, normalized[i], nbSymbols[i], tableLogs[i], spread);
+            t1 = BMK_getNanos(); if (t1-t0 < fastestC) fastestC = t1-t0; t0 = t1;
+            for (i=0; i<nbTables; i++) FSE_buildDTable_spread(DTable, normalized[i], nbSymbols[i], tableLogs[i], spread);
+            t1 = BMK_getNanos(); if (t1-t0 < fastestD) fastestD = t1-t0;
+            pass++;
+        }
+
+        // speeds
+        BMK_timeLoopNs = TIMELOOP_NS / 10;
+        sprintf(label, "%.16s", codec->name);
+        BMK_benchCodec(codec, chunkP, nbChunks, label, (int)benchedSize, &codecSize, &cTime, &dTime, 256, 0);
+        BMK_timeLoopNs = TIMELOOP_NS;
+
+        DISPLAY("  %7s : %7.3f%%  %+8.3f%%         ,%8.0f ns  ,%8.0f ns   ,%7.1f MB/s ,%7.1f MB/s\n", BMK_spreadNames[spread],
+                (double)cSize / (double)benchedSize * 100.,
+                entropy > 0. ? ((double)dataBytes * 8. / entropy - 1.) * 100. : 0.,
+                (double)fastestC / (nbTables ? nbTables : 1), (double)fastestD / (nbTables ? nbTables : 1),
+                (double)benchedSize / cTime / 1000., (double)benchedSize / dTime / 1000.);
     }
-    *totalCompressedSize    += cSize;
-    *totalCompressionTime   += fastestC;
-    *totalDecompressionTime += fastestD;
+    BMK_recordName = NULL;
+
+    return 0;
 }
 
 
 int BMK_benchFiles(char** fileNamesTable, int nbFiles)
 {
     int fileIdx=0;
+    ARN_arena* arena;
     char* orig_buff;
 
     U64 totals = 0;
@@ -677,6 +1404,10 @@ int BMK_benchFiles(char** fileNamesTable, int nbFiles)
     double totald = 0.;
 
 
+    // Buffers of each file are taken from an arena, reset before next file
+    arena = ARN_create();
+    if (arena==NULL) { DISPLAY("\nError: not enough memory!\n"); return 12; }
+
     // Loop for each file
     while (fileIdx<nbFiles)
     {
@@ -685,16 +1416,19 @@ int BMK_benchFiles(char** fileNamesTable, int nbFiles)
         U64    inFileSize;
         size_t benchedSize;
         int nbChunks;
+        const int minChunkSize = BMK_sweep ? (int)BMK_SWEEP_MINBLOCK : chunkSize;
         int maxCompressedChunkSize;
         size_t readSize;
         char* compressedBuffer; int compressedBuffSize;
         char* destBuffer;
         chunkParameters_t* chunkP;
 
+        ARN_reset(arena);
+
         // Check file existence
         inFileName = fileNamesTable[fileIdx++];
         inFile = fopen( inFileName, "rb" );
-        if (inFile==NULL) { DISPLAY( "Pb opening %s\n", inFileName); return 11; }
+        if (inFile==NULL) { DISPLAY( "Pb opening %s\n", inFileName); ARN_free(arena); return 11; }
 
         // Check if file is fse compressed
         if (strstr(inFileName,".fse"))
@@ -718,47 +1452,30 @@ int BMK_benchFiles(char** fileNamesTable, int nbFiles)
 
         // Memory allocation & restrictions
         inFileSize = BMK_GetFileSize(inFileName);
-        benchedSize = (size_t) BMK_findMaxMem(inFileSize * 3) / 3;
+        benchedSize = (size_t) BMK_findMaxMem(inFileSize * 4) / 4;   // source, destination, compressed (+ headers of small blocks)
         if ((U64)benchedSize > inFileSize) benchedSize = (size_t)inFileSize;
         if (benchedSize < inFileSize) DISPLAY("Not enough memory for '%s' full size; testing %i MB only...\n", inFileName, (int)(benchedSize>>20));
 
-        // Alloc
-        chunkP = (chunkParameters_t*) malloc(((benchedSize / chunkSize)+1) * sizeof(chunkParameters_t));
-        orig_buff = (char*)malloc((size_t )benchedSize);
-        nbChunks = (int) (benchedSize / chunkSize) + 1;
-        maxCompressedChunkSize = FSE_compressBound(chunkSize);
+        // Alloc (sweep : for smallest blocks)
+        nbChunks = (int) (benchedSize / minChunkSize) + 1;
+        chunkP = (chunkParameters_t*) ARN_alloc(arena, nbChunks * sizeof(chunkParameters_t));
+        orig_buff = (char*)ARN_alloc(arena, (size_t )benchedSize);
+        maxCompressedChunkSize = FSE_compressBound(minChunkSize);
         compressedBuffSize = nbChunks * maxCompressedChunkSize;
-        compressedBuffer = (char*)malloc((size_t )compressedBuffSize);
-        destBuffer = (char*)malloc((size_t )benchedSize);
+        compressedBuffer = (char*)ARN_alloc(arena, (size_t )compressedBuffSize);
+        destBuffer = (char*)ARN_alloc(arena, (size_t )benchedSize);
 
 
-        if (!orig_buff || !compressedBuffer)
+        if (!chunkP || !orig_buff || !compressedBuffer || !destBuffer)
         {
             DISPLAY("\nError: not enough memory!\n");
-            free(orig_buff);
-            free(compressedBuffer);
-            free(chunkP);
             fclose(inFile);
+            ARN_free(arena);
             return 12;
         }
 
         // Init chunks data
-        {
-            int i;
-            size_t remaining = benchedSize;
-            char* in = orig_buff;
-            char* out = compressedBuffer;
-            char* dst = destBuffer;
-            for (i=0; i<nbChunks; i++)
-            {
-                chunkP[i].id = i;
-                chunkP[i].origBuffer = in; in += chunkSize;
-                if ((int)remaining > chunkSize) { chunkP[i].origSize = chunkSize; remaining -= chunkSize; } else { chunkP[i].origSize = (int)remaining; remaining = 0; }
-                chunkP[i].compressedBuffer = out; out += maxCompressedChunkSize;
-                chunkP[i].compressedSize = 0;
-                chunkP[i].destBuffer = dst; dst += chunkSize;
-            }
-        }
+        nbChunks = BMK_initChunks(chunkP, orig_buff, compressedBuffer, destBuffer, benchedSize, chunkSize);
 
         // Fill input buffer
         DISPLAY("Loading %s...       \r", inFileName);
@@ -768,27 +1485,64 @@ int BMK_benchFiles(char** fileNamesTable, int nbFiles)
         if (readSize != benchedSize)
         {
             DISPLAY("\nError: problem reading file '%s' (%i read, should be %i) !!    \n", inFileName, (int)readSize, (int)benchedSize);
-            free(orig_buff);
-            free(compressedBuffer);
-            free(chunkP);
+            ARN_free(arena);
             return 13;
         }
 
         // Bench
-        BMK_benchMem(chunkP, nbChunks, inFileName, (int)benchedSize, &totalz, &totalc, &totald, 256, 0);
-        totals += benchedSize;
+        if (BMK_latency)
+        {
+            int errorCode = BMK_benchLatency(arena, orig_buff, benchedSize, inFileName);
+            if (errorCode) { ARN_free(arena); return errorCode; }
+            continue;
+        }
+        if (BMK_scaling)
+        {
+            int errorCode = BMK_benchScaling(orig_buff, benchedSize, inFileName);
+            if (errorCode) { ARN_free(arena); return errorCode; }
+            continue;
+        }
+        if (BMK_sweep)
+        {
+            BMK_sweepMem(chunkP, orig_buff, compressedBuffer, destBuffer, benchedSize, inFileName);
+            continue;
+        }
+        if (BMK_tableLogs)
+        {
+            BMK_tableLogsMem(chunkP, nbChunks, benchedSize, inFileName);
+            continue;
+        }
+        if (BMK_spreads)
+        {
+            int errorCode = BMK_spreadsMem(arena, chunkP, nbChunks, benchedSize, inFileName);
+            if (errorCode) { ARN_free(arena); return errorCode; }
+            continue;
+        }
+        {
+            int codecNb;
+            for (codecNb=0; codecNb<BMK_nbSelected; codecNb++)
+            {
+                const BMK_codec_t* const codec = BMK_selected[codecNb];
+                char name[64];
+                if (BMK_nbSelected > 1) sprintf(name, "%s:%.50s", codec->name, inFileName);
+                else sprintf(name, "%.60s", inFileName);
+                BMK_recordName = inFileName;
+                BMK_benchCodec(codec, chunkP, nbChunks, name, (int)benchedSize, &totalz, &totalc, &totald, 256, 0);
+                BMK_recordName = NULL;
+                totals += benchedSize;
+            }
+        }
+        if (BMK_phases) BMK_profilePhases(arena, orig_buff, (int)benchedSize, inFileName);
 
-        free(orig_buff);
-        free(compressedBuffer);
-        free(chunkP);
     }
 
-    if (nbFiles > 1)
+    if ((nbFiles > 1) && !BMK_sweep && !BMK_tableLogs && !BMK_spreads && !BMK_scaling && !BMK_latency)
         DISPLAY("%-16.16s :%10llu ->%10llu (%5.2f%%), %6.1f MB/s , %6.1f MB/s\n", "  TOTAL", (long long unsigned int)totals, (long long unsigned int)totalz, (double)totalz/(double)totals*100., (double)totals/totalc/1000., (double)totals/totald/1000.);
 
     if (BMK_pause) { DISPLAY("press enter...\n"); getchar(); }
 
-    return 0;
+    ARN_free(arena);
+    return REP_finish() ? 1 : 0;
 }
 
 
@@ -797,6 +1551,7 @@ int BMK_benchFiles(char** fileNamesTable, int nbFiles)
 int BMK_benchFilesLZ4E(char** fileNamesTable, int nbFiles, int algoNb)
 {
     int fileIdx=0;
+    ARN_arena* arena;
     size_t blockSize = chunkSize * BLOCKRATIO;
     U64 totals = 0;
     U64 totalz = 0;
@@ -804,6 +1559,10 @@ int BMK_benchFilesLZ4E(char** fileNamesTable, int nbFiles, int algoNb)
     double totald = 0.;
 
 
+    // Buffers of each file are taken from an arena, reset before next file
+    arena = ARN_create();
+    if (arena==NULL) { DISPLAY("\nError: not enough memory!\n"); return 12; }
+
     // Loop for each file
     while (fileIdx<nbFiles)
     {
@@ -821,6 +1580,8 @@ int BMK_benchFilesLZ4E(char** fileNamesTable, int nbFiles, int algoNb)
         size_t digestedSize;
         int eType;
 
+        ARN_reset(arena);
+
         // Check file existence
         inFileName = fileNamesTable[fileIdx++];
         inFile = fopen( inFileName, "rb" );
@@ -836,24 +1597,20 @@ int BMK_benchFilesLZ4E(char** fileNamesTable, int nbFiles, int algoNb)
         }
 
         // Alloc
-        chunkP = (chunkParameters_t*) malloc(((benchedSize / blockSize)+1) * sizeof(chunkParameters_t));
-        orig_buff = (char*)malloc(benchedSize);
-        digest_buff = (char*)malloc(benchedSize);
+        chunkP = (chunkParameters_t*) ARN_alloc(arena, ((benchedSize / blockSize)+1) * sizeof(chunkParameters_t));
+        orig_buff = (char*)ARN_alloc(arena, benchedSize);
+        digest_buff = (char*)ARN_alloc(arena, benchedSize);
         nbChunks = (int) (benchedSize / blockSize) + 1;
         compressedBuffSize = nbChunks * FSE_compressBound((int)blockSize);
-        compressedBuffer = (char*)malloc((size_t)compressedBuffSize);
-        destBuffer = (char*)malloc(benchedSize);
+        compressedBuffer = (char*)ARN_alloc(arena, (size_t)compressedBuffSize);
+        destBuffer = (char*)ARN_alloc(arena, benchedSize);
 
 
-        if (!orig_buff || !compressedBuffer || !digest_buff)
+        if (!chunkP || !orig_buff || !compressedBuffer || !destBuffer || !digest_buff)
         {
             DISPLAY("\nError: not enough memory!\n");
-            free(orig_buff);
-            free(digest_buff);
-            free(compressedBuffer);
-            free(destBuffer);
-            free(chunkP);
             fclose(inFile);
+            ARN_free(arena);
             return 12;
         }
 
@@ -864,7 +1621,7 @@ int BMK_benchFilesLZ4E(char** fileNamesTable, int nbFiles, int algoNb)
 
         if (readSize != benchedSize)
         {
-            free(orig_buff); free(compressedBuffer); free(chunkP);
+            ARN_free(arena);
             DISPLAY("\nError: problem reading file '%s' !!    \n", inFileName);
             exit(13);
         }
@@ -904,35 +1661,32 @@ int BMK_benchFilesLZ4E(char** fileNamesTable, int nbFiles, int algoNb)
 
             // Bench
             {
+                const char* codecName = "fse";
                 int nbSymbols=256;
                 int memLog=0;
                 char localName[50] = {0};
                 switch(eType)
                 {
                 case et_runLength:    strcat(localName, "rl."); nbSymbols=256; memLog=12; break;
-                case et_runLength285: strcat(localName, "rzl"); nbSymbols=  3; memLog=12; break;
-                case et_runLengthU16: strcat(localName, "r16"); nbSymbols=  0; memLog=10; break;
-                case et_runLengthLN:  strcat(localName, "rLN"); nbSymbols=  2; memLog=10; break;
+                case et_runLength285: strcat(localName, "rzl"); codecName="fse285";     memLog=12; break;
+                case et_runLengthU16: strcat(localName, "r16"); codecName="fseU16";     memLog=10; break;
+                case et_runLengthLN:  strcat(localName, "rLN"); codecName="fseU16Log2"; memLog=10; break;
                 case et_lastbits:     strcat(localName, "lb."); nbSymbols= 16; memLog=12; break;
                 case et_literals:     strcat(localName, "lit.");nbSymbols=256; memLog=12; break;
                 case et_matchLength:  strcat(localName, "ml."); nbSymbols=256; memLog=12; break;
-                case et_matchLengthU16:strcat(localName,"m16"); nbSymbols=  0; memLog=10; break;
-                case et_matchLengthLog2:strcat(localName,"ml2");nbSymbols=  2; memLog=10; break;
+                case et_matchLengthU16:strcat(localName,"m16"); codecName="fseU16";     memLog=10; break;
+                case et_matchLengthLog2:strcat(localName,"ml2");codecName="fseU16Log2"; memLog=10; break;
                 case et_offset:       strcat(localName, "of."); nbSymbols= 16; memLog=12; break;
                 case et_offsetHigh:   strcat(localName, "ofh"); nbSymbols=256; memLog=11; break;
-                case et_offsetU16:    strcat(localName, "o16"); nbSymbols=  0; memLog=10; break;
-                case et_offsetU32:    strcat(localName, "o32"); nbSymbols=  1; memLog=10; break;
+                case et_offsetU16:    strcat(localName, "o16"); codecName="fseU16";     memLog=10; break;
+                case et_offsetU32:    strcat(localName, "o32"); codecName="fseU32";     memLog=10; break;
                 }
                 strcat(localName, inFileName);
-                BMK_benchMem(chunkP, nbChunks, localName, (int)digestedSize, &totalz, &totalc, &totald, nbSymbols, memLog);
+                BMK_benchCodec(BMK_findCodec(codecName, strlen(codecName)), chunkP, nbChunks, localName, (int)digestedSize, &totalz, &totalc, &totald, nbSymbols, memLog);
                 totals += digestedSize;
             }
         }
 
-        free(orig_buff);
-        free(digest_buff);
-        free(compressedBuffer);
-        free(chunkP);
     }
 
     if (nbFiles > 1)
@@ -940,201 +1694,136 @@ int BMK_benchFilesLZ4E(char** fileNamesTable, int nbFiles, int algoNb)
 
     if (BMK_pause) { DISPLAY("press enter...\n"); getchar(); }
 
-    return 0;
+    ARN_free(arena);
+    return REP_finish() ? 1 : 0;
 }
 
 
-/***************************************************
-  Benchmark using zlib's huffman
-***************************************************/
-void BMK_benchMemZLIBH(chunkParameters_t* chunkP, int nbChunks, char* inFileName, int benchedSize,
-                 U64* totalCompressedSize, double* totalCompressionTime, double* totalDecompressionTime)
-{
-    int loopNb, chunkNb;
-    size_t cSize=0;
-    double fastestC = 100000000., fastestD = 100000000.;
-    double ratio=0.;
-    U32 crcCheck=0;
-    U32 crcOrig;
-
-    crcOrig = XXH32(chunkP[0].origBuffer, benchedSize,0);
-
-    DISPLAY("\r%79s\r", "");
-    for (loopNb = 1; loopNb <= nbIterations; loopNb++)
-    {
-        int nbLoops;
-        int milliTime;
-
-        // Compression
-        DISPLAY("%1i-%-14.14s : %9i ->\r", loopNb, inFileName, benchedSize);
-        { int i; for (i=0; i<benchedSize; i++) chunkP[0].compressedBuffer[i]=(char)i; }     // warmimg up memory
-
-        nbLoops = 0;
-        milliTime = BMK_GetMilliStart();
-        while(BMK_GetMilliStart() == milliTime);
-        milliTime = BMK_GetMilliStart();
-        while(BMK_GetMilliSpan(milliTime) < TIMELOOP)
-        {
-            for (chunkNb=0; chunkNb<nbChunks; chunkNb++)
-                chunkP[chunkNb].compressedSize = ZLIBH_compress(chunkP[chunkNb].compressedBuffer, chunkP[chunkNb].origBuffer, chunkP[chunkNb].origSize);
-            nbLoops++;
-        }
-        milliTime = BMK_GetMilliSpan(milliTime);
-
-        if ((double)milliTime < fastestC*nbLoops) fastestC = (double)milliTime/nbLoops;
-        cSize=0; for (chunkNb=0; chunkNb<nbChunks; chunkNb++) cSize += chunkP[chunkNb].compressedSize;
-        ratio = (double)cSize/(double)benchedSize*100.;
-
-        DISPLAY("%1i-%-14.14s : %9i -> %9i (%5.2f%%),%7.1f MB/s\r", loopNb, inFileName, (int)benchedSize, (int)cSize, ratio, (double)benchedSize / fastestC / 1000.);
-
-        //continue;
-        // Decompression
-        //{ size_t i; for (i=0; i<benchedSize; i++) orig_buff[i]=0; }     // zeroing area, for CRC checking
+/**********************************************************************
+   BenchCore
+**********************************************************************/
 
-        nbLoops = 0;
-        milliTime = BMK_GetMilliStart();
-        while(BMK_GetMilliStart() == milliTime);
-        milliTime = BMK_GetMilliStart();
-        while(BMK_GetMilliSpan(milliTime) < TIMELOOP)
-        {
-            for (chunkNb=0; chunkNb<nbChunks; chunkNb++)
-                chunkP[chunkNb].compressedSize = ZLIBH_decompress(chunkP[chunkNb].origBuffer, chunkP[chunkNb].compressedBuffer);
-            nbLoops++;
-        }
-        milliTime = BMK_GetMilliSpan(milliTime);
+static const int BMK_coreTestSize = 256 KB;
 
-        if ((double)milliTime < fastestD*nbLoops) fastestD = (double)milliTime/nbLoops;
-        DISPLAY("%1i-%-14.14s : %9i -> %9i (%5.2f%%),%7.1f MB/s ,%7.1f MB/s\r", loopNb, inFileName, (int)benchedSize, (int)cSize, ratio, (double)benchedSize / fastestC / 1000., (double)benchedSize / fastestD / 1000.);
 
-        // CRC Checking
-        crcCheck = XXH32(chunkP[0].origBuffer, benchedSize,0);
-        if (crcOrig!=crcCheck) { DISPLAY("\n!!! WARNING !!! %14s : Invalid Checksum : %x != %x\n", inFileName, (unsigned)crcOrig, (unsigned)crcCheck); break; }
-    }
+//**************************************
+// Cold cache
+//**************************************
+/*
+Blocks are taken in turn from a working set several times larger than the last level cache,
+so that each one is read from memory, as when it arrives from network or disk.
+Between blocks, tables are flushed from all cache levels (x86 with SSE2 only; elsewhere they stay cached).
+Flushing is not timed.
+*/
+#define BMK_COLD_LLC_DEFAULT  (32 MB)
+#define BMK_COLD_LLC_RATIO    4
+#define BMK_COLD_MIN_SET      (16 MB)
 
-    if (crcOrig==crcCheck)
+static size_t BMK_lastLevelCacheSize(void)
+{
+    size_t best = 0;
+    int level = 0, i;
+    for (i=0; i<8; i++)
     {
-        if (ratio<100.)
-            DISPLAY("%-16.16s : %9i -> %9i (%5.2f%%),%7.1f MB/s ,%7.1f MB/s\n", inFileName, (int)benchedSize, (int)cSize, ratio, (double)benchedSize / fastestC / 1000., (double)benchedSize / fastestD / 1000.);
-        else
-            DISPLAY("%-16.16s : %9i -> %9i (%5.1f%%),%7.1f MB/s ,%7.1f MB/s \n", inFileName, (int)benchedSize, (int)cSize, ratio, (double)benchedSize / fastestC / 1000., (double)benchedSize / fastestD / 1000.);
+        char name[80];
+        FILE* f;
+        int cacheLevel;
+        unsigned long size;
+        char unit = 0;
+        sprintf(name, "/sys/devices/system/cpu/cpu0/cache/index%i/level", i);
+        f = fopen(name, "r");
+        if (f==NULL) break;
+        if (fscanf(f, "%i", &cacheLevel) != 1) cacheLevel = 0;
+        fclose(f);
+        sprintf(name, "/sys/devices/system/cpu/cpu0/cache/index%i/size", i);
+        f = fopen(name, "r");
+        if (f==NULL) continue;
+        if (fscanf(f, "%lu%c", &size, &unit) < 1) size = 0;
+        fclose(f);
+        if (unit=='K') size <<= 10;
+        if (unit=='M') size <<= 20;
+        if ((cacheLevel > level) || ((cacheLevel==level) && (size > best))) { level = cacheLevel; best = size; }
     }
-    *totalCompressedSize    += cSize;
-    *totalCompressionTime   += fastestC;
-    *totalDecompressionTime += fastestD;
+    return best ? best : BMK_COLD_LLC_DEFAULT;
 }
 
-
-int BMK_benchFilesZLIBH(char** fileNamesTable, int nbFiles)
+static void BMK_evict(const void* ptr, size_t size)
 {
-    int fileIdx=0;
-    char* orig_buff;
-
-    U64 totals = 0;
-    U64 totalz = 0;
-    double totalc = 0.;
-    double totald = 0.;
-
+#if BMK_CLFLUSH
+    const char* const p = (const char*)ptr;
+    size_t i;
+    for (i=0; i<size; i+=64) _mm_clflush(p+i);
+    _mm_mfence();
+#else
+    (void)ptr; (void)size;
+#endif
+}
 
-    // Loop for each file
-    while (fileIdx<nbFiles)
+static void BMK_coldLoop(BMK_samples_t* samples, int decode, char* workingSet, int nbCopies, size_t stride, int benchedSize,
+                         const void* table, size_t tableSize, int tableLog)
+{
+    const U64 start = BMK_getNanos();
+    BMK_newIteration(samples);
+    while (BMK_getNanos() - start < BMK_timeLoopNs)
     {
-        FILE*  inFile;
-        char*  inFileName;
-        U64    inFileSize;
-        size_t benchedSize;
-        int nbChunks;
-        int maxCompressedChunkSize;
-        size_t readSize;
-        char* compressedBuffer; int compressedBuffSize;
-        chunkParameters_t* chunkP;
-
-        // Check file existence
-        inFileName = fileNamesTable[fileIdx++];
-        inFile = fopen( inFileName, "rb" );
-        if (inFile==NULL) { DISPLAY( "Pb opening %s\n", inFileName); return 11; }
-
-        // Memory allocation & restrictions
-        inFileSize = BMK_GetFileSize(inFileName);
-        benchedSize = (size_t) BMK_findMaxMem(inFileSize * 2) / 2;
-        if ((U64)benchedSize > inFileSize) benchedSize = (size_t)inFileSize;
-        if (benchedSize < inFileSize) DISPLAY("Not enough memory for '%s' full size; testing %i MB only...\n", inFileName, (int)(benchedSize>>20));
-
-        // Alloc
-        chunkP = (chunkParameters_t*) malloc(((benchedSize / chunkSize)+1) * sizeof(chunkParameters_t));
-        orig_buff = (char*)malloc((size_t )benchedSize);
-        nbChunks = (int) (benchedSize / chunkSize) + 1;
-        maxCompressedChunkSize = ZLIBH_compressBound(chunkSize);
-        compressedBuffSize = nbChunks * maxCompressedChunkSize;
-        compressedBuffer = (char*)malloc((size_t )compressedBuffSize);
-
-
-        if (!orig_buff || !compressedBuffer)
-        {
-            DISPLAY("\nError: not enough memory!\n");
-            free(orig_buff);
-            free(compressedBuffer);
-            free(chunkP);
-            fclose(inFile);
-            return 12;
-        }
-
-        // Init chunks data
-        {
-            int i;
-            size_t remaining = benchedSize;
-            char* in = orig_buff;
-            char* out = compressedBuffer;
-            for (i=0; i<nbChunks; i++)
-            {
-                chunkP[i].id = i;
-                chunkP[i].origBuffer = in; in += chunkSize;
-                if ((int)remaining > chunkSize) { chunkP[i].origSize = chunkSize; remaining -= chunkSize; } else { chunkP[i].origSize = (int)remaining; remaining = 0; }
-                chunkP[i].compressedBuffer = out; out += maxCompressedChunkSize;
-                chunkP[i].compressedSize = 0;
-            }
-        }
-
-        // Fill input buffer
-        DISPLAY("Loading %s...       \r", inFileName);
-        readSize = fread(orig_buff, 1, benchedSize, inFile);
-        fclose(inFile);
-
-        if (readSize != benchedSize)
+        U64 ns = 0, nbCycles = 0;
+        int i;
+        for (i=0; i<nbCopies; i++)
         {
-            DISPLAY("\nError: problem reading file '%s' !!    \n", inFileName);
-            free(orig_buff);
-            free(compressedBuffer);
-            free(chunkP);
-            return 13;
+            char* const src = workingSet + i*stride;
+            char* const dst = src + benchedSize;
+            U64 t0, c0;
+            BMK_evict(table, tableSize);
+            c0 = BMK_getCycles(); t0 = BMK_getNanos();
+            if (decode) FSE_decompress_usingDTable((BYTE*)src, benchedSize, dst, table, tableLog);
+            else FSE_compress_usingCTable(dst, (const BYTE*)src, benchedSize, table);
+            ns += BMK_getNanos() - t0; nbCycles += BMK_getCycles() - c0;
         }
-
-        // Bench
-        BMK_benchMemZLIBH(chunkP, nbChunks, inFileName, (int)benchedSize, &totalz, &totalc, &totald);
-        totals += benchedSize;
-
-        free(orig_buff);
-        free(compressedBuffer);
-        free(chunkP);
+        BMK_addSample(samples, ns, nbCycles);
     }
-
-    if (nbFiles > 1)
-        DISPLAY("%-16.16s :%10llu ->%10llu (%5.2f%%), %6.1f MB/s , %6.1f MB/s\n", "  TOTAL", (long long unsigned int)totals, (long long unsigned int)totalz, (double)totalz/(double)totals*100., (double)totals/totalc/1000., (double)totals/totald/1000.);
-
-    if (BMK_pause) { DISPLAY("press enter...\n"); getchar(); }
-
-    return 0;
 }
 
+static void BMK_benchCore_Cold(ARN_arena* arena, char* src, int benchedSize, int cSize, const void* CTable, size_t cTableSize,
+                               const void* DTable, size_t dTableSize, int tableLog, char* inFileName, double hotC, double hotD)
+{
+    const size_t stride = ((size_t)benchedSize + FSE_compressBound(benchedSize) + 63) & ~(size_t)63;
+    size_t setSize = BMK_lastLevelCacheSize() * BMK_COLD_LLC_RATIO;
+    char* workingSet;
+    int nbCopies, i, loopNb;
+    double coldC, coldD;
+
+    if (setSize < BMK_COLD_MIN_SET) setSize = BMK_COLD_MIN_SET;
+    if (setSize > MEM_getBudget() / 2) setSize = MEM_getBudget() / 2;
+    nbCopies = (int)(setSize / stride);
+    if (nbCopies < 2) nbCopies = 2;
+    workingSet = (char*)ARN_alloc(arena, nbCopies * stride);
+    if (workingSet==NULL) { DISPLAY("%-16.16s : cold : not enough memory\n", inFileName); return; }
+    for (i=0; i<nbCopies; i++)
+    {
+        memcpy(workingSet + i*stride, src, benchedSize);
+        FSE_compress_usingCTable(workingSet + i*stride + benchedSize, (const BYTE*)src, benchedSize, CTable);
+    }
 
-
-/**********************************************************************
-   BenchCore
-**********************************************************************/
-
-static const int BMK_coreTestSize = 256 KB;
+    BMK_resetSamples(&BMK_samplesC);
+    BMK_resetSamples(&BMK_samplesD);
+    for (loopNb = 1; loopNb <= nbIterations; loopNb++)
+    {
+        DISPLAY("%1i-%-14.14s : cold, %i MB working set\r", loopNb, inFileName, (int)((nbCopies*stride)>>20));
+        BMK_coldLoop(&BMK_samplesC, 0, workingSet, nbCopies, stride, benchedSize, CTable, cTableSize, tableLog);
+        BMK_coldLoop(&BMK_samplesD, 1, workingSet, nbCopies, stride, benchedSize, DTable, dTableSize, tableLog);
+    }
+    coldC = BMK_fastestMs(&BMK_samplesC) / nbCopies;
+    coldD = BMK_fastestMs(&BMK_samplesD) / nbCopies;
+    DISPLAY("%-16.16s : cold, %3i MB working set%s : %7.1f MB/s (%+5.1f%%) ,%7.1f MB/s (%+5.1f%%)\n", inFileName,
+            (int)((nbCopies*stride)>>20), BMK_CLFLUSH ? "" : " (tables cached)",
+            (double)benchedSize / coldC / 1000., (hotC / coldC - 1.) * 100.,
+            (double)benchedSize / coldD / 1000., (hotD / coldD - 1.) * 100.);
+    BMK_displayTimings(nbCopies, (U64)benchedSize * nbCopies);
+    BMK_record("fseCoreCold", inFileName, benchedSize, tableLog, (U64)benchedSize * nbCopies, (U64)cSize * nbCopies);
+}
 
 
-static void BMK_benchCore_Mem(char* dst, char* src, int benchedSize, 
+static void BMK_benchCore_Mem(ARN_arena* arena, char* dst, char* src, int benchedSize,
                               int nbSymbols, int tableLog, char* inFileName, 
                               U64* totalCompressedSize, double* totalCompressionTime, double* totalDecompressionTime)
 {
@@ -1152,34 +1841,33 @@ static void BMK_benchCore_Mem(char* dst, char* src, int benchedSize,
     crcOrig = XXH32(src, benchedSize,0);
     nbSymbols = FSE_count(count, (BYTE*)src, benchedSize, nbSymbols);
     tableLog  = FSE_normalizeCount(count, tableLog, count, benchedSize, nbSymbols);
-    CTable = malloc( FSE_sizeof_CTable(nbSymbols, tableLog) );
+    CTable = ARN_alloc(arena, FSE_sizeof_CTable(nbSymbols, tableLog));
+    DTable = ARN_alloc(arena, FSE_sizeof_DTable(tableLog));
+    if (!CTable || !DTable) { DISPLAY("\nError: not enough memory!\n"); return; }
     FSE_buildCTable(CTable, count, nbSymbols, tableLog);
-    DTable = malloc( FSE_sizeof_DTable(tableLog) );
     FSE_buildDTable(DTable, count, nbSymbols, tableLog);
 
+    BMK_resetSamples(&BMK_samplesC);
+    BMK_resetSamples(&BMK_samplesD);
+    BMK_perfReset();
     DISPLAY("\r%79s\r", "");
     for (loopNb = 1; loopNb <= nbIterations; loopNb++)
     {
-        int nbLoops;
-        int milliTime;
+        BMK_timer_t timer;
 
         // Compression
         DISPLAY("%1i-%-14.14s : %9i ->\r", loopNb, inFileName, benchedSize);
         { int i; for (i=0; i<benchedSize; i++) dst[i]=(char)i; }     // warmimg up memory
 
-        nbLoops = 0;
-        milliTime = BMK_GetMilliStart();
-        while(BMK_GetMilliStart() == milliTime);
-        milliTime = BMK_GetMilliStart();
-        while(BMK_GetMilliSpan(milliTime) < TIMELOOP)
+        BMK_perfStart();
+        timer.running = 0;
+        while (BMK_timerLoop(&timer, &BMK_samplesC, BMK_timeLoopNs))
         {
             cSize = FSE_compress_usingCTable(dst, (BYTE*)src, benchedSize, CTable);
             //cSize = FSE_compress_usingCTable_ILP2(dst, (BYTE*)src, benchedSize, CTable);
-            nbLoops++;
         }
-        milliTime = BMK_GetMilliSpan(milliTime);
-
-        if ((double)milliTime < fastestC*nbLoops) fastestC = (double)milliTime/nbLoops;
+        BMK_perfStop(&BMK_perfC);
+        fastestC = BMK_fastestMs(&BMK_samplesC);
         ratio = (double)cSize/(double)benchedSize*100.;
 
         DISPLAY("%1i-%-14.14s : %9i -> %9i (%5.2f%%),%7.1f MB/s\r", loopNb, inFileName, (int)benchedSize, (int)cSize, ratio, (double)benchedSize / fastestC / 1000.);
@@ -1188,18 +1876,14 @@ static void BMK_benchCore_Mem(char* dst, char* src, int benchedSize,
         // Decompression
         //{ size_t i; for (i=0; i<benchedSize; i++) orig_buff[i]=0; }     // zeroing area, for CRC checking
 
-        nbLoops = 0;
-        milliTime = BMK_GetMilliStart();
-        while(BMK_GetMilliStart() == milliTime);
-        milliTime = BMK_GetMilliStart();
-        while(BMK_GetMilliSpan(milliTime) < TIMELOOP)
+        BMK_perfStart();
+        timer.running = 0;
+        while (BMK_timerLoop(&timer, &BMK_samplesD, BMK_timeLoopNs))
         {
             cSize = FSE_decompress_usingDTable((BYTE*)src, benchedSize, dst, DTable, tableLog);
-            nbLoops++;
         }
-        milliTime = BMK_GetMilliSpan(milliTime);
-
-        if ((double)milliTime < fastestD*nbLoops) fastestD = (double)milliTime/nbLoops;
+        BMK_perfStop(&BMK_perfD);
+        fastestD = BMK_fastestMs(&BMK_samplesD);
         DISPLAY("%1i-%-14.14s : %9i -> %9i (%5.2f%%),%7.1f MB/s ,%7.1f MB/s\r", loopNb, inFileName, (int)benchedSize, (int)cSize, ratio, (double)benchedSize / fastestC / 1000., (double)benchedSize / fastestD / 1000.);
 
         // CRC Checking
@@ -1214,6 +1898,15 @@ static void BMK_benchCore_Mem(char* dst, char* src, int benchedSize,
         else
             DISPLAY("%-16.16s : %9i -> %9i (%5.1f%%),%7.1f MB/s ,%7.1f MB/s \n", inFileName, (int)benchedSize, (int)cSize, ratio, (double)benchedSize / fastestC / 1000., (double)benchedSize / fastestD / 1000.);
     }
+    if (crcOrig==crcCheck)
+    {
+        BMK_displayTimings(1, (U64)benchedSize);
+        BMK_displayPerf((U64)BMK_samplesC.nb * benchedSize, (U64)BMK_samplesD.nb * benchedSize);
+        BMK_record("fseCore", inFileName, benchedSize, tableLog, (U64)benchedSize, (U64)cSize);
+    }
+    if (BMK_cold && (crcOrig==crcCheck))
+        BMK_benchCore_Cold(arena, src, benchedSize, (int)cSize, CTable, FSE_sizeof_CTable(nbSymbols, tableLog),
+                           DTable, FSE_sizeof_DTable(tableLog), tableLog, inFileName, fastestC, fastestD);
     *totalCompressedSize    += cSize;
     *totalCompressionTime   += fastestC;
     *totalDecompressionTime += fastestD;
@@ -1223,6 +1916,7 @@ static void BMK_benchCore_Mem(char* dst, char* src, int benchedSize,
 int BMK_benchCore_Files(char** fileNamesTable, int nbFiles)
 {
     int fileIdx=0;
+    ARN_arena* arena;
     char* orig_buff;
 
     U64 totals = 0;
@@ -1231,6 +1925,10 @@ int BMK_benchCore_Files(char** fileNamesTable, int nbFiles)
     double totald = 0.;
 
 
+    // Buffers of each file are taken from an arena, reset before next file
+    arena = ARN_create();
+    if (arena==NULL) { DISPLAY("\nError: not enough memory!\n"); return 12; }
+
     // Loop for each file
     while (fileIdx<nbFiles)
     {
@@ -1244,10 +1942,12 @@ int BMK_benchCore_Files(char** fileNamesTable, int nbFiles)
         char* compressedBuffer; int compressedBuffSize;
         int chunkSize = BMK_coreTestSize;
 
+        ARN_reset(arena);
+
         // Check file existence
         inFileName = fileNamesTable[fileIdx++];
         inFile = fopen( inFileName, "rb" );
-        if (inFile==NULL) { DISPLAY( "Pb opening %s\n", inFileName); return 11; }
+        if (inFile==NULL) { DISPLAY( "Pb opening %s\n", inFileName); ARN_free(arena); return 11; }
 
         // Check if file is fse compressed
         if (strstr(inFileName,".fse"))
@@ -1276,19 +1976,18 @@ int BMK_benchCore_Files(char** fileNamesTable, int nbFiles)
         DISPLAY("FSE Core Loop speed evaluation, testing %i KB ...\n", (int)(benchedSize>>10));
 
         // Alloc
-        orig_buff = (char*)malloc((size_t )benchedSize);
+        orig_buff = (char*)ARN_alloc(arena, (size_t )benchedSize);
         nbChunks = 1;
         maxCompressedChunkSize = FSE_compressBound(chunkSize);
         compressedBuffSize = nbChunks * maxCompressedChunkSize;
-        compressedBuffer = (char*)malloc((size_t )compressedBuffSize);
+        compressedBuffer = (char*)ARN_alloc(arena, (size_t )compressedBuffSize);
 
 
         if (!orig_buff || !compressedBuffer)
         {
             DISPLAY("\nError: not enough memory!\n");
-            free(orig_buff);
-            free(compressedBuffer);
             fclose(inFile);
+            ARN_free(arena);
             return 12;
         }
 
@@ -1300,17 +1999,14 @@ int BMK_benchCore_Files(char** fileNamesTable, int nbFiles)
         if (readSize != benchedSize)
         {
             DISPLAY("\nError: problem reading file '%s' (%i read, should be %i) !!    \n", inFileName, (int)readSize, (int)benchedSize);
-            free(orig_buff);
-            free(compressedBuffer);
+            ARN_free(arena);
             return 13;
         }
 
         // Bench
-        BMK_benchCore_Mem(compressedBuffer, orig_buff, (int)benchedSize, 256, 0, inFileName, &totalz, &totalc, &totald);
+        BMK_benchCore_Mem(arena, compressedBuffer, orig_buff, (int)benchedSize, 256, 0, inFileName, &totalz, &totalc, &totald);
         totals += benchedSize;
 
-        free(orig_buff);
-        free(compressedBuffer);
     }
 
     if (nbFiles > 1)
@@ -1318,5 +2014,6 @@ int BMK_benchCore_Files(char** fileNamesTable, int nbFiles)
 
     if (BMK_pause) { DISPLAY("press enter...\n"); getchar(); }
 
-    return 0;
+    ARN_free(arena);
+    return REP_finish() ? 1 : 0;
 }
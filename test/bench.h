@@ -31,13 +31,21 @@ extern "C" {
 int BMK_benchFiles(char** fileNamesTable, int nbFiles);
 int BMK_benchCore_Files(char** fileNamesTable, int nbFiles);
 int BMK_benchFilesLZ4E(char** fileNamesTable, int nbFiles, int algoNb);
-int BMK_benchFilesZLIBH(char** fileNamesTable, int nbFiles);
 
 
 // Parameters
 void BMK_SetBlocksize(int bsize);
 void BMK_SetNbIterations(int nbLoops);
-void BMK_SetByteCompressor(int id);
+int  BMK_SetCodecs(const char* names);   // comma-separated list of codec names, or "all" ; return : 0, or -1 if a name is unknown
+void BMK_listCodecs(void);
+void BMK_SetPhaseProfiling(int enabled);   // -b : also time each step of FSE, for several block sizes
+void BMK_SetScaling(int enabled);          // -b : aggregate throughput of 1 to N threads (see -T#)
+void BMK_SetColdCache(int enabled);        // core benchmark : also measure with data and tables out of cache
+void BMK_SetLatency(int enabled);          // -b : latency histogram of each call, on messages of various sizes
+void BMK_SetPerfCounters(int enabled);     // -b, core : cycles, instructions, branch and cache misses per symbol (Linux)
+void BMK_SetSweep(int enabled);            // -b : benchmark all block sizes and tableLogs, then display Pareto frontier
+void BMK_SetTableLogs(int enabled);        // -b : benchmark each tableLog at current block size, display ratio loss and speeds
+void BMK_SetSpreads(int enabled);          // -b : compare symbol spreads at current block size : loss vs entropy, table build time, speeds
 
 
 #if defined (__cplusplus)
@@ -41,9 +41,15 @@
 //***************************************************
 #include <stdlib.h>   // exit
 #include <stdio.h>    // fprintf
-#include <string.h>   // strcmp, strcat
+#include <string.h>   // strcmp, strncmp, strcat
 #include "bench.h"
 #include "fileio.h"
+#include "server.h"
+#include "batch.h"
+#include "scheduler.h"
+#include "membudget.h"
+#include "arena.h"
+#include "report.h"
 #include "lz4hce.h"   // et_final
 
 
@@ -99,11 +105,30 @@ static int usage()
     DISPLAY("Arguments :\n");
     DISPLAY("(default): core loop timing tests\n");
     DISPLAY(" -b : benchmark full mode\n");
-    DISPLAY(" -m : benchmark lowMem mode\n");
+    DISPLAY(" -m : benchmark lowMem mode (tableLog <= 9, tables < 2 KB, see FSE_compressLowMem())\n");
     DISPLAY(" -z : benchmark using zlib's huffman\n");
+    DISPLAY(" --codec=name[,name]|all : benchmark these codecs (fse, fseSafe, fseLowMem, fseSorted, fsePrecise, fse2t, zlibh), one after the other\n");
     DISPLAY(" -d : decompression (default for %s extension)\n", FSE_EXTENSION);
+    DISPLAY(" -r : process multiple files, and directories recursively, in parallel\n");
     DISPLAY(" -o : force compression\n");
     DISPLAY(" -i#: iteration loops [1-9](default : 4), benchmark mode only\n");
+    DISPLAY(" -B#: block size in KB (default : 32), benchmark mode only\n");
+    DISPLAY(" -S : benchmark all block sizes (1 KB - 32 MB) and tableLogs, display Pareto frontier\n");
+    DISPLAY(" --tablelogs : benchmark each tableLog (9 - max of library, see fse_large), with ratio loss and speeds\n");
+    DISPLAY(" --spreads : compare symbol spreads (step, sorted, precise) : loss vs entropy, table build time, speeds\n");
+    DISPLAY(" --phases : with -b, also time each step of compression and decompression, per block size\n");
+    DISPLAY(" --cold : core loop timing, also with data and tables out of cache\n");
+    DISPLAY(" --latency : latency histogram of each call, on messages of 64 bytes to block size (see -B)\n");
+    DISPLAY(" --perf : with -b or core loop timing, hardware counters per symbol (Linux perf_event_open)\n");
+    DISPLAY(" --scaling : benchmark 1 to N threads (see -T), each compressing its own copy of the file\n");
+    DISPLAY(" --format=json|csv : benchmark results to stdout, in this format\n");
+    DISPLAY(" --compare=file.json : compare benchmark results with a previous --format=json run; exit code 1 on regression\n");
+    DISPLAY(" -T#: nb of threads (default : nb of cores)\n");
+    DISPLAY(" --numa : pin threads, spread over NUMA nodes, with node-local buffers\n");
+    DISPLAY(" --hugepages : back buffers with huge pages, when available\n");
+    DISPLAY(" --mem=#: memory budget, in bytes or with K, M, G suffix (default : half of available memory)\n");
+    DISPLAY(" --serve socket  : run as a compression service on Unix socket\n");
+    DISPLAY(" --client socket : send compression/decompression to service\n");
     DISPLAY(" -h/-H : display help/long help and exit\n");
     return 0;
 }
@@ -131,6 +156,12 @@ int main(int argc, char** argv)
     int   indexFileNames=0;
     char* input_filename=0;
     char* output_filename=0;
+    char* serveSocket=0;
+    char* clientSocket=0;
+    char** inFileNames;
+    int   nbInFiles=0;
+    int   recursive=0;
+    int   result=0;
     int   nextNameIsOutput = 0;
     char  extension[] = FSE_EXTENSION;
 
@@ -140,6 +171,8 @@ int main(int argc, char** argv)
     DISPLAY(WELCOME_MESSAGE);
 
     if (argc<1) badusage();
+    inFileNames = (char**)malloc(argc * sizeof(char*));
+    if (!inFileNames) { DISPLAYLEVEL(1, "Allocation error : not enough memory\n"); return 1; }
 
     for(i = 1; i <= argc; i++)
     {
@@ -148,6 +181,50 @@ int main(int argc, char** argv)
 
         if(!argument) continue;   // Protection if argument empty
 
+        if (!strcmp(argument, "--numa"))   { SCH_setPinning(1); continue; }
+        if (!strcmp(argument, "--hugepages")) { ARN_setHugePages(1); continue; }
+        if (!strcmp(argument, "--tablelogs")) { BMK_SetTableLogs(1); bench=1; continue; }
+        if (!strcmp(argument, "--spreads")) { BMK_SetSpreads(1); bench=1; continue; }
+        if (!strcmp(argument, "--phases")) { BMK_SetPhaseProfiling(1); continue; }
+        if (!strcmp(argument, "--scaling")) { BMK_SetScaling(1); bench=1; continue; }
+        if (!strcmp(argument, "--cold")) { BMK_SetColdCache(1); bench=3; continue; }
+        if (!strcmp(argument, "--latency")) { BMK_SetLatency(1); bench=1; continue; }
+        if (!strcmp(argument, "--perf")) { BMK_SetPerfCounters(1); continue; }
+        if (!strncmp(argument, "--codec=", 8))
+        {
+            if (BMK_SetCodecs(argument+8)) { DISPLAYLEVEL(1, "Unknown codec in %s; available :", argument+8); BMK_listCodecs(); exit(1); }
+            bench=1;
+            continue;
+        }
+        if (!strcmp(argument, "--format=json")) { REP_setFormat(REP_json); continue; }
+        if (!strcmp(argument, "--format=csv"))  { REP_setFormat(REP_csv); continue; }
+        if (!strncmp(argument, "--compare=", 10))
+        {
+            if (REP_setBaseline(argument+10)) { DISPLAYLEVEL(1, "Cannot read baseline %s\n", argument+10); exit(1); }
+            continue;
+        }
+        if (!strncmp(argument, "--mem=", 6))
+        {
+            const char* size = argument+6;
+            unsigned long long budget = 0;
+            if ((*size<'0') || (*size>'9')) badusage();
+            while ((*size>='0') && (*size<='9')) budget = budget*10 + (unsigned)(*size++ - '0');
+            switch(*size)
+            {
+            case 'G': case 'g': budget <<= 10;   // fall-through
+            case 'M': case 'm': budget <<= 10;   // fall-through
+            case 'K': case 'k': budget <<= 10; size++;
+            default : ;
+            }
+            if ((*size!=0) || (budget==0)) badusage();
+            MEM_setBudget(budget);
+            continue;
+        }
+
+        // long commands, followed by a socket name
+        if (!strcmp(argument, "--serve"))  { if (i+1 >= argc) badusage(); serveSocket = argv[++i]; continue; }
+        if (!strcmp(argument, "--client")) { if (i+1 >= argc) badusage(); clientSocket = argv[++i]; bench=0; continue; }
+
         // Decode command (note : aggregated commands are allowed)
         if (argument[0]=='-')
         {
@@ -175,17 +252,17 @@ int main(int argc, char** argv)
                     // Decoding
                 case 'd': decode=1; bench=0; break;
 
+                    // Multiple files, recursive
+                case 'r': recursive=1; bench=0; break;
+
                     // Benchmark full mode
                 case 'b': bench=1; break;
 
-                    // Benchmark full mode
-                case 'm': DISPLAY("benchmark using experimental lowMem mode\n");
-                    bench=1;
-                    BMK_SetByteCompressor(2);
-                    break;
+                    // Benchmark lowMem mode (tables < 2 KB)
+                case 'm': bench=1; BMK_SetCodecs("fseLowMem"); break;
 
                     // zlib Benchmark mode
-                case 'z': bench=2; break;
+                case 'z': bench=1; BMK_SetCodecs("zlibh"); break;
 
                     // Benchmark LZ4 extracted fields (hidden)
                 case 'l': benchLZ4e=1;
@@ -196,7 +273,7 @@ int main(int argc, char** argv)
                 case 't': decode=1; output_filename=nulmark; break;
 
                     // Overwrite
-                case 'f': FIO_overwriteMode(); break;
+                case 'f': FIO_overwriteMode(); BAT_overwriteMode(); break;
 
                     // Verbose mode
                 case 'v': displayLevel=4; break;
@@ -207,11 +284,18 @@ int main(int argc, char** argv)
                     // keep source file (default anyway, so useless) (for xz/lzma compatibility)
                 case 'k': break;
 
-                    // Modify Block Properties
-                case 'B': break;   // to be completed later
+                    // Block size (benchmark only)
+                case 'B':
+                    {
+                        int bSize = 0;
+                        while ((argument[1] >='0') && (argument[1] <='9')) { bSize = bSize*10 + (argument[1] - '0'); argument++; }
+                        if ((bSize < 1) || (bSize > (1<<20))) badusage();
+                        BMK_SetBlocksize(bSize << 10);
+                    }
+                    break;
 
-                    // Modify Stream properties
-                case 'S': break;   // to be completed later
+                    // Sweep block sizes and tableLogs (benchmark only)
+                case 'S': bench=1; BMK_SetSweep(1); break;
 
                     // Modify Nb Iterations (benchmark only)
                 case 'i':
@@ -223,6 +307,15 @@ int main(int argc, char** argv)
                     }
                     break;
 
+                    // Nb of threads
+                case 'T':
+                    {
+                        int nb = 0;
+                        while ((argument[1] >='0') && (argument[1] <='9')) { nb = nb*10 + (argument[1] - '0'); argument++; }
+                        SCH_setNbThreads(nb);
+                    }
+                    break;
+
                     // Pause at the end (hidden option)
                 case 'p': fse_pause=1; break;
 
@@ -236,13 +329,20 @@ int main(int argc, char** argv)
         // following -o argument
         if (nextNameIsOutput == 1) { output_filename=argument; continue; }
 
-        // first provided filename is input
+        // first provided filename is input; others are for batch and benchmark modes
+        inFileNames[nbInFiles++] = argument;
         if (!input_filename) { input_filename=argument; indexFileNames=i; continue; }
     }
 
     // End of command line reading
     DISPLAYLEVEL(3, WELCOME_MESSAGE);
 
+    // Buffers allocated by this thread (single file, benchmark) then stay on its node
+    SCH_pinCurrentThread();
+
+    // Service mode
+    if (serveSocket) return SRV_serve(serveSocket);
+
     // No input filename ==> use stdin
     if(!input_filename) { input_filename=stdinmark; }
 
@@ -250,12 +350,20 @@ int main(int argc, char** argv)
     if (!strcmp(input_filename, stdinmark)  && IS_CONSOLE(stdin)                 ) badusage();
 
     // Check if benchmark is selected
-    if (benchLZ4e) { BMK_benchFilesLZ4E(argv+indexFileNames, argc-indexFileNames, algoNb); goto _end; }
+    if (benchLZ4e) { result = BMK_benchFilesLZ4E(argv+indexFileNames, argc-indexFileNames, algoNb); goto _end; }
 
     // Check if benchmark is selected
-    if (bench==1) { BMK_benchFiles(argv+indexFileNames, argc-indexFileNames); goto _end; }
-    if (bench==2) { BMK_benchFilesZLIBH(argv+indexFileNames, argc-indexFileNames); goto _end; }
-    if (bench==3) { BMK_benchCore_Files(argv+indexFileNames, argc-indexFileNames); goto _end; }
+    if (bench==1) { result = BMK_benchFiles(argv+indexFileNames, argc-indexFileNames); goto _end; }
+    if (bench==3) { result = BMK_benchCore_Files(argv+indexFileNames, argc-indexFileNames); goto _end; }
+
+    // Batch mode : each file into its own file
+    if ((recursive || (nbInFiles > 1)) && !clientSocket)
+    {
+        if (output_filename && strcmp(output_filename, nulmark)) { DISPLAYLEVEL(1, "Output filename cannot be used with multiple files\n"); badusage(); }
+        if (!nbInFiles) badusage();
+        result = BAT_processFiles(inFileNames, nbInFiles, decode, recursive, output_filename!=0);
+        goto _end;
+    }
 
     // No output filename ==> try to select one automatically (when possible)
     while (!output_filename)
@@ -296,10 +404,12 @@ int main(int argc, char** argv)
     if (!strcmp(input_filename, stdinmark)  && IS_CONSOLE(stdin)                 ) badusage();
     if (!strcmp(output_filename,stdoutmark) && IS_CONSOLE(stdout)                ) badusage();
 
-    if (decode) decompress_file(output_filename, input_filename);
+    if (clientSocket) SRV_request(clientSocket, decode, output_filename, input_filename);
+    else if (decode) decompress_file(output_filename, input_filename);
     else compress_file(output_filename, input_filename);
 
 _end:
+    free(inFileNames);
     if (fse_pause) waitEnter();
-    return 0;
+    return result;
 }
@@ -53,6 +53,8 @@
 #include <stdlib.h>   // malloc
 #include <string.h>   // strcmp, strlen
 #include "fileio.h"
+#include "membudget.h"
+#include "arena.h"
 #include "fse.h"
 #include "xxhash.h"
 
@@ -131,9 +133,11 @@ typedef unsigned long long  U64;
 #define FSE_MAGIC_NUMBER   0x183E2306
 
 #define CACHELINE 64
+#define HEADERSIZE               (MAGICNUMBER_SIZE+1)
 #define FSE_BLOCKSIZEID_DEFAULT  5
 #define FSE_BUFFERSIZEID_DEFAULT 5
 #define FSE_CHECKSUM_SEED        0
+#define FIO_DECODE_WINDOW        (256 KB)   // decoded data is consumed by chunks of this size, while still in cache
 
 
 //**************************************
@@ -189,12 +193,36 @@ static int   bufferSizeId = FSE_BUFFERSIZEID_DEFAULT;
 void FIO_overwriteMode() { overwrite=1; }
 
 
+//**************************************
+// Buffers
+//**************************************
+// Buffers of compress_file() and decompress_file(), kept from one file to the next
+static ARN_arena* FIO_arena = NULL;
+
+static ARN_arena* FIO_resetArena(void)
+{
+    if (FIO_arena==NULL) FIO_arena = ARN_create();
+    if (FIO_arena==NULL) EXM_THROW(21, "Allocation error : not enough memory");
+    ARN_reset(FIO_arena);
+    return FIO_arena;
+}
+
+
 //****************************
 // Functions
 //****************************
 static int          FIO_GetBlockSize_FromBlockId   (int id) { return (1 << id) KB; }
 static int          FIO_GetBufferSize_FromBufferId (int id) { return (1 << (id + 5)) KB; }
 
+// Input and output buffers must fit within a quarter of memory budget
+static size_t FIO_getBufferSize(void)
+{
+    size_t blockSize  = FIO_GetBlockSize_FromBlockId(blockSizeId);
+    size_t bufferSize = FIO_GetBufferSize_FromBufferId(bufferSizeId);
+    while ((bufferSize > blockSize) && (4*bufferSize > MEM_getBudget())) bufferSize /= 2;
+    return bufferSize;
+}
+
 
 int get_fileHandle(char* input_filename, char* output_filename, FILE** pfinput, FILE** pfoutput)
 {
@@ -276,9 +304,10 @@ int compress_file(char* output_filename, char* input_filename)
     FILE* foutput;
     size_t sizeCheck;
     size_t inputBlockSize  = FIO_GetBlockSize_FromBlockId(blockSizeId);
-    size_t inputBufferSize = FIO_GetBufferSize_FromBufferId(bufferSizeId);
+    size_t inputBufferSize = FIO_getBufferSize();
     int nbBlocksPerBuffer;
     int lastBlockDone=0;
+    ARN_arena* arena;
     void* hashCtx = XXH32_init(FSE_CHECKSUM_SEED);
 
 
@@ -288,8 +317,9 @@ int compress_file(char* output_filename, char* input_filename)
     // Allocate Memory
     if (inputBufferSize < inputBlockSize) inputBufferSize = inputBlockSize;
     nbBlocksPerBuffer = (int)((inputBufferSize + (inputBlockSize-1)) / inputBlockSize);
-    in_buff  = (char*)malloc(inputBufferSize);
-    out_buff = (char*)malloc(nbBlocksPerBuffer * FSE_compressBound((int)inputBlockSize) + CACHELINE);
+    arena = FIO_resetArena();
+    in_buff  = (char*)ARN_alloc(arena, inputBufferSize);
+    out_buff = (char*)ARN_alloc(arena, nbBlocksPerBuffer * FSE_compressBound((int)inputBlockSize) + CACHELINE);
     if (!in_buff || !out_buff) EXM_THROW(21, "Allocation error : not enough memory");
 
     // Write Archive Header
@@ -310,10 +340,7 @@ int compress_file(char* output_filename, char* input_filename)
         XXH32_update(hashCtx, in_buff, (int)inSize);
         DISPLAYLEVEL(3, "\rRead : %i MB   ", (int)(filesize>>20));
 
-        extern int stats_block_data_bytes;
-        extern int stats_block_overhead_bytes;
-        extern int stats_block_uncompressed_size;
-        extern double stats_block_entropy;
+        FSE_blockStats_t* const stats = FSE_getBlockStats();
 
         // Compress Blocks
         {
@@ -326,10 +353,10 @@ int compress_file(char* output_filename, char* input_filename)
             {
                 int errorCode;
 
-                stats_block_data_bytes = 0;
-                stats_block_overhead_bytes = 0;
-                stats_block_uncompressed_size = 0;
-                stats_block_entropy = 0.0;
+                stats->dataBytes = 0;
+                stats->overheadBytes = 0;
+                stats->uncompressedSize = 0;
+                stats->entropy = 0.0;
 
                 errorCode = compressionFunction(op, (unsigned char*)ip, (int)inputBlockSize);
                 if (errorCode==-1) EXM_THROW(22, "Compression error");
@@ -337,8 +364,8 @@ int compress_file(char* output_filename, char* input_filename)
                 ip += inputBlockSize;
 
                 fputs("Block stats:", stderr);
-                fprintf(stderr, "%d -> %d head + %d data\n", stats_block_uncompressed_size, stats_block_overhead_bytes, stats_block_data_bytes);
-                fprintf(stderr, "ideal = %.2f bytes\n", stats_block_entropy/8.0);
+                fprintf(stderr, "%d -> %d head + %d data\n", stats->uncompressedSize, stats->overheadBytes, stats->dataBytes);
+                fprintf(stderr, "ideal = %.2f bytes\n", stats->entropy/8.0);
             }
             if (((nbFullBlocks * inputBlockSize) < inSize) || (!inSize))  // last Block
             {
@@ -375,8 +402,6 @@ int compress_file(char* output_filename, char* input_filename)
         (unsigned long long) filesize, (unsigned long long) compressedfilesize, (double)compressedfilesize/filesize*100);
 
     // Close & Free
-    free(in_buff);
-    free(out_buff);
     fclose(finput);
     fclose(foutput);
 
@@ -384,24 +409,243 @@ int compress_file(char* output_filename, char* input_filename)
 }
 
 
-#define HEADERSIZE 5
+/*
+FIO_compressFrame() :
+    Same format as compress_file(), from memory to memory.
+    'dst' must be at least FIO_compressFrameBound(srcSize) large.
+    A block compression error is reported as FIO_ERROR, as compress_file() reports it (error 22).
+    A frame can also be produced piece by piece : header, segments, and checksum;
+    segments can then be compressed independently, and concatenated in order.
+*/
+size_t FIO_compressFrameBound(size_t srcSize)
+{
+    size_t blockSize  = FIO_GetBlockSize_FromBlockId(blockSizeId);
+    size_t bufferSize = FIO_getBufferSize();
+    size_t nbBlocks   = (srcSize / blockSize) + 1;
+    size_t nbBuffers  = (srcSize / bufferSize) + 2;
+    return MAGICNUMBER_SIZE+1 + srcSize + nbBlocks*(FSE_compressBound(0)) + nbBuffers*(1+1+4) + 4;
+}
+
+size_t FIO_frameSegmentUnit(void)
+{
+    size_t blockSize  = FIO_GetBlockSize_FromBlockId(blockSizeId);
+    size_t bufferSize = FIO_getBufferSize();
+    return (bufferSize < blockSize) ? blockSize : bufferSize;
+}
+
+size_t FIO_compressFrameHeader(void* dst)
+{
+    BYTE* op = (BYTE*)dst;
+    *(U32*)op = LITTLE_ENDIAN_32(FSE_MAGIC_NUMBER);
+    op[MAGICNUMBER_SIZE] = (BYTE)blockSizeId;
+    return HEADERSIZE;
+}
+
+size_t FIO_compressFrameSegment(void* dst, const void* src, size_t srcSize, int lastSegment)
+{
+    const size_t inputBlockSize  = FIO_GetBlockSize_FromBlockId(blockSizeId);
+    const size_t inputBufferSize = FIO_frameSegmentUnit();
+    const BYTE* ip = (const BYTE*)src;
+    const BYTE* const iend = ip + srcSize;
+    BYTE* op = (BYTE*)dst;
+    int lastBlockDone = !lastSegment;   // only last segment terminates the frame
+    int errorCode;
+
+    // Same buffer splitting as compress_file(), so that results are identical
+    while (1)
+    {
+        size_t inSize = (size_t)(iend-ip) < inputBufferSize ? (size_t)(iend-ip) : inputBufferSize;
+        int nbFullBlocks = (int)(inSize / inputBlockSize);
+        int i;
+        if ((inSize==0) && (lastBlockDone)) break;
+        *op++ = (BYTE)nbFullBlocks;
+        for (i=0; i<nbFullBlocks; i++)
+        {
+            errorCode = FSE_compress(op, ip, (int)inputBlockSize);
+            if (errorCode==-1) return FIO_ERROR;   // Compression error
+            op += errorCode;
+            ip += inputBlockSize;
+        }
+        if (((nbFullBlocks * inputBlockSize) < inSize) || (!inSize))  // last Block
+        {
+            int nbBytes = ((blockSizeId+10)/8) + 1;   // nb Bytes to describe last block size
+            int lastBlockSize = (int)inSize & (inputBlockSize-1);
+            if (nbFullBlocks) *op++= 0;               // Last block flag, useless if nbFullBlocks==0
+            *(U32*)op = LITTLE_ENDIAN_32((U32)lastBlockSize); op+= nbBytes;
+            errorCode = FSE_compress(op, ip, lastBlockSize);
+            if (errorCode==-1) return FIO_ERROR;   // Compression error, last block
+            op += errorCode;
+            ip += lastBlockSize;
+            lastBlockDone=1;
+        }
+    }
+
+    return op - (BYTE*)dst;
+}
+
+size_t FIO_compressFrameEnd(void* dst, unsigned checksum)
+{
+    *(U32*)dst = LITTLE_ENDIAN_32(checksum);
+    return 4;
+}
+
+size_t FIO_compressFrame(void* dst, const void* src, size_t srcSize)
+{
+    BYTE* op = (BYTE*)dst;
+    size_t segmentSize;
+    op += FIO_compressFrameHeader(op);
+    segmentSize = FIO_compressFrameSegment(op, src, srcSize, 1);
+    if (segmentSize==FIO_ERROR) return FIO_ERROR;
+    op += segmentSize;
+    op += FIO_compressFrameEnd(op, XXH32(src, (int)srcSize, FSE_CHECKSUM_SEED));
+    return op - (BYTE*)dst;
+}
+
+
+#define FIO_BLOCKHEADER_MAX (FSE_MAX_HEADERSIZE+4)   // enough to find the compressed size of any block
+
+/*
+FIO_getBlockCompressedSize() :
+    Determines the compressed size of a block, using its first 'available' bytes only.
+    return : compressed size of the block
+             or 0 if more bytes are needed to know it
+             or -1 if the block is corrupted
+*/
+static int FIO_getBlockCompressedSize(const BYTE* ip, size_t available, U32 blockSize)
+{
+    U32 counting[256];
+    int nbSymbols, tableLog, spread;
+    int headerSize;
+    U32 streamSize;
+
+    if (available < 1) return 0;
+    if (ip[0]==0) return (int)blockSize+1;   // uncompressed block
+    if (ip[0]==1) return 2;                  // single symbol
+    if ((ip[0]&3) < 2) return -1;            // unused headerId
+
+    if (available > FIO_BLOCKHEADER_MAX) available = FIO_BLOCKHEADER_MAX;
+    headerSize = FSE_readHeader_spread(counting, &nbSymbols, &tableLog, &spread, ip, (int)available);
+    if ((headerSize==-1) || ((size_t)headerSize+4 > available))
+        return (available < FIO_BLOCKHEADER_MAX) ? 0 : -1;
+
+    streamSize = (LITTLE_ENDIAN_32(*(U32*)(ip+headerSize)) & 0x3FFFFFFF) >> 3;   // see FSE_closeCompressionStream()
+    if (headerSize + streamSize > (U32)FSE_compressBound((int)blockSize)) return -1;
+    return headerSize + (int)streamSize;
+}
+
+
+/*
+   Input ring buffer
+   Items (fields and blocks) are stored contiguously, and the ring wraps around only between 2 items.
+   Data is read up to the end of current item, or FIO_BLOCKHEADER_MAX bytes beyond the start of a block
+   when peeking at its header, whichever is further. When the ring wraps, the few bytes already read
+   beyond current item (at most FIO_BLOCKHEADER_MAX) are moved to its beginning : blocks are never moved.
+*/
+typedef struct
+{
+    FILE* finput;
+    BYTE* buffer;
+    BYTE* bufferEnd;
+    BYTE* ip;        // start of current item
+    BYTE* ifill;     // end of bytes read
+} FIO_inRing;
+
+// Starts a new item of at most maxSize bytes, at a position where it fits contiguously
+static BYTE* FIO_ring_startItem(FIO_inRing* ring, BYTE* itemStart, size_t maxSize)
+{
+    ring->ip = itemStart;
+    if ((size_t)(ring->bufferEnd - ring->ip) < maxSize)
+    {
+        const size_t pending = ring->ifill - ring->ip;   // peeked beyond previous block
+        memmove(ring->buffer, ring->ip, pending);
+        ring->ip = ring->buffer;
+        ring->ifill = ring->buffer + pending;
+    }
+    return ring->ip;
+}
+
+// Makes sure up to 'size' bytes of current item are available, reading only missing ones
+// return : nb of bytes available, which is < size only when reaching end of file
+static size_t FIO_ring_fill(FIO_inRing* ring, size_t size)
+{
+    size_t available = ring->ifill - ring->ip;
+    if (available < size)
+    {
+        size_t readSize = fread(ring->ifill, 1, size - available, ring->finput);
+        if ((readSize != size - available) && ferror(ring->finput)) EXM_THROW(34, "Read error");
+        ring->ifill += readSize;
+        available += readSize;
+    }
+    return available;
+}
+
+// Reads a little-endian field of 'size' bytes
+static U32 FIO_ring_readField(FIO_inRing* ring, int size)
+{
+    const BYTE* p = FIO_ring_startItem(ring, ring->ip, 4);
+    U32 value = 0;
+    int i;
+    if (FIO_ring_fill(ring, size) < (size_t)size) EXM_THROW(34, "Read error : unexpected end of file");
+    for (i=size-1; i>=0; i--) value = (value << 8) + p[i];
+    ring->ip += size;
+    return value;
+}
+
+// Reads next block; return : pointer to the complete block, its size being provided into *cSizePtr
+static const BYTE* FIO_ring_readBlock(FIO_inRing* ring, U32 blockSize, int* cSizePtr)
+{
+    const size_t maxBlockSize = FSE_compressBound(blockSize);
+    const BYTE* const ip = FIO_ring_startItem(ring, ring->ip, (maxBlockSize > FIO_BLOCKHEADER_MAX) ? maxBlockSize : FIO_BLOCKHEADER_MAX);
+    size_t available;
+    int cSize;
+
+    // Peek at block header, in a single read : bytes beyond the block are kept for next items
+    available = FIO_ring_fill(ring, FIO_BLOCKHEADER_MAX);
+    cSize = FIO_getBlockCompressedSize(ip, available, blockSize);
+    if ((cSize==0) && (available < FIO_BLOCKHEADER_MAX)) EXM_THROW(34, "Read error : unexpected end of file");
+    if (cSize==-1) EXM_THROW(33, "Decoding error : compressed data block corrupted");
+
+    if (FIO_ring_fill(ring, cSize) < (size_t)cSize) EXM_THROW(34, "Read error : unexpected end of file");
+    ring->ip += cSize;
+    *cSizePtr = cSize;
+    return ip;
+}
+
+
+typedef struct
+{
+    FILE* foutput;
+    void* hashCtx;
+} FIO_fileSink;
+
+static int FIO_fileSink_write(void* opaque, const unsigned char* decoded, int size)
+{
+    FIO_fileSink* const fileSink = (FIO_fileSink*)opaque;
+    size_t sizeCheck = fwrite(decoded, 1, size, fileSink->foutput);
+    if (sizeCheck != (size_t)size) EXM_THROW(34, "Write error : unable to write data block to destination file");
+    XXH32_update(fileSink->hashCtx, decoded, size);
+    return 0;
+}
+
+
 unsigned long long decompress_file(char* output_filename, char* input_filename)
 {
     FILE* finput, *foutput;
     U64   filesize = 0;
     char  header[HEADERSIZE];
-    char* in_buff;
     char* out_buff;
-    char* ip;
-    char* ifill;
-    char* iend;
+    int   windowSize;
+    FIO_inRing ring;
+    FIO_fileSink fileSink;
     U32   blockSize;
     int   blockSizeId;
     size_t sizeCheck;
     U32   magicNumber;
     U32*  magicNumberP = (U32*) header;
     size_t inputBufferSize;
-    int nbFullBlocks = 0;
+    int nbFullBlocks;
+    int lastBlock = 0;
+    ARN_arena* arena;
     void* hashCtx = XXH32_init(FSE_CHECKSUM_SEED);
 
 
@@ -419,98 +663,481 @@ unsigned long long decompress_file(char* output_filename, char* input_filename)
     blockSize = FIO_GetBlockSize_FromBlockId(blockSizeId);
 
     // Allocate Memory
-    inputBufferSize = FIO_GetBufferSize_FromBufferId(bufferSizeId);
-    if (inputBufferSize < 2* blockSize) inputBufferSize = 2*blockSize;   // Minimum input buffer size
-    in_buff  = (char*)malloc(inputBufferSize);
-    out_buff = (char*)malloc(blockSize);
-    if (!in_buff || !out_buff) EXM_THROW(33, "Allocation error : not enough memory");
-    ip = in_buff;
-    ifill = ip;
-    iend = ip + inputBufferSize;
+    inputBufferSize = FIO_getBufferSize();
+    if (inputBufferSize < 2*(size_t)FSE_compressBound(blockSize) + HEADERSIZE) inputBufferSize = 2*FSE_compressBound(blockSize) + HEADERSIZE;   // Minimum input buffer size
+    ring.finput = finput;
+    arena = FIO_resetArena();
+    ring.buffer = (BYTE*)ARN_alloc(arena, inputBufferSize);
+    ring.bufferEnd = ring.buffer + inputBufferSize;
+    ring.ip = ring.ifill = ring.buffer;
+    windowSize = (blockSize < FIO_DECODE_WINDOW) ? blockSize : FIO_DECODE_WINDOW;
+    out_buff = (char*)ARN_alloc(arena, windowSize);
+    if (!ring.buffer || !out_buff) EXM_THROW(33, "Allocation error : not enough memory");
+    fileSink.foutput = foutput;
+    fileSink.hashCtx = hashCtx;
 
     // Main Loop
-    while (1)
+    while (!lastBlock)
     {
-        size_t toReadSize, readSize;
-
-        // Fill input buffer
-        toReadSize = iend-ifill;
-        readSize = fread(ifill, 1, toReadSize, finput);
-        if ((readSize != toReadSize) && ferror(finput)) EXM_THROW(34, "Read error");
+        nbFullBlocks = FIO_ring_readField(&ring, 1);
+        if (!nbFullBlocks)
+        {
+            int nbBytes = ((blockSizeId+10)/8)+1;   // Nb Bytes to describe last block size
+            nbFullBlocks = 1;
+            lastBlock = 1;
+            blockSize = FIO_ring_readField(&ring, nbBytes);
+            if (blockSize > (U32)FIO_GetBlockSize_FromBlockId(blockSizeId)) EXM_THROW(33, "Decoding error : last block size corrupted");
+        }
 
-        // Decode while enough data
-        while (iend-ip > FSE_compressBound(blockSize))
+        for ( ; nbFullBlocks; nbFullBlocks--)
         {
-            size_t sizeCheck;
-            int errorCode;
-            if (nbFullBlocks == 0)
-            {
-                nbFullBlocks = *ip++;
-                if (!nbFullBlocks) goto _lastBlock;   // goto last block
-            }
-            errorCode = FSE_decompress((unsigned char*)out_buff, blockSize, ip);
-            if (errorCode == -1) EXM_THROW(33, "Decoding error : compressed data block corrupted");
-            ip += errorCode;
+            int cSize;
+            const BYTE* ip = FIO_ring_readBlock(&ring, blockSize, &cSize);
+            int errorCode = FSE_decompress_toSink(out_buff, windowSize, blockSize, ip, cSize, FIO_fileSink_write, &fileSink);
+            if (errorCode != cSize) EXM_THROW(33, "Decoding error : compressed data block corrupted");
             filesize += blockSize;
-            nbFullBlocks--;
+        }
+    }
+
+    // CRC verification
+    {
+        U32 CRCsaved = FIO_ring_readField(&ring, 4);
+        U32 CRCcalculated = XXH32_digest(hashCtx);
+        if (CRCsaved != CRCcalculated) EXM_THROW(35, "CRC error : wrong checksum, corrupted data");
+    }
+
+    DISPLAYLEVEL(2, "\r%79s\r", "");
+    DISPLAYLEVEL(2,"Decoded %llu bytes\n", (long long unsigned)filesize);
+
+    // Free
+    fclose(finput);
+    fclose(foutput);
+
+    return filesize;
+}
+
+
+/*********************************************************
+   Frame segments
+*********************************************************/
+int FIO_readFrameHeader(FILE* finput)
+{
+    BYTE header[HEADERSIZE];
+    if (fread(header, 1, HEADERSIZE, finput) != HEADERSIZE) return -1;
+    if (LITTLE_ENDIAN_32(*(U32*)header) != FSE_MAGIC_NUMBER) return -1;
+    if (header[MAGICNUMBER_SIZE] > 0xF) return -1;
+    return header[MAGICNUMBER_SIZE];
+}
+
+// Makes sure 'needed' bytes of segment are available, reading only missing ones
+// return : nb of bytes available, which is < needed only when reaching end of file (or on allocation error)
+static size_t FIO_segment_fill(FIO_frameSegment* segment, FILE* finput, size_t needed)
+{
+    if (segment->filled >= needed) return segment->filled;
+    if (segment->capacity < needed)
+    {
+        size_t newCapacity = (needed < 2*segment->capacity) ? 2*segment->capacity : needed;
+        BYTE* newBuffer = (BYTE*)realloc(segment->buffer, newCapacity);
+        if (newBuffer==NULL) return segment->filled;
+        segment->buffer = newBuffer;
+        segment->capacity = newCapacity;
+    }
+    segment->filled += fread(segment->buffer + segment->filled, 1, needed - segment->filled, finput);
+    return segment->filled;
+}
+
+static U32 FIO_readLE(const BYTE* p, int size)
+{
+    U32 value = 0;
+    int i;
+    for (i=size-1; i>=0; i--) value = (value << 8) + p[i];
+    return value;
+}
+
+int FIO_readFrameSegment(FIO_frameSegment* segment, const FIO_frameSegment* previous, FILE* finput, int blockSizeId, size_t targetSize)
+{
+    const U32 blockSize = FIO_GetBlockSize_FromBlockId(blockSizeId);
+    const int nbBytes = ((blockSizeId+10)/8)+1;   // Nb Bytes to describe last block size
+    size_t pos = 0;
+
+    segment->size = segment->filled = 0;
+    segment->decodedSize = 0;
+    segment->last = 0;
+
+    // Bytes read beyond previous segment
+    if ((previous!=NULL) && (previous->filled > previous->size))
+    {
+        size_t carry = previous->filled - previous->size;
+        if (segment->capacity < carry)
+        {
+            free(segment->buffer);
+            segment->buffer = (BYTE*)malloc(carry);
+            segment->capacity = (segment->buffer==NULL) ? 0 : carry;
+            if (segment->buffer==NULL) return -1;
+        }
+        memcpy(segment->buffer, previous->buffer + previous->size, carry);
+        segment->filled = carry;
+    }
+
+    while ((!segment->last) && (segment->decodedSize < targetSize))
+    {
+        U32 regenSize = blockSize;
+        int nbFullBlocks;
+
+        if (FIO_segment_fill(segment, finput, pos+1) < pos+1) return -1;
+        nbFullBlocks = segment->buffer[pos++];
+        if (!nbFullBlocks)
+        {
+            if (FIO_segment_fill(segment, finput, pos+nbBytes) < pos+nbBytes) return -1;
+            regenSize = FIO_readLE(segment->buffer+pos, nbBytes);
+            pos += nbBytes;
+            if (regenSize > blockSize) return -1;
+            nbFullBlocks = 1;
+            segment->last = 1;
+        }
 
-            sizeCheck = fwrite(out_buff, 1, blockSize, foutput);
-            if (sizeCheck != blockSize) EXM_THROW(34, "Write error : unable to write data block to destination file");
-            XXH32_update(hashCtx, out_buff, blockSize);
+        for ( ; nbFullBlocks; nbFullBlocks--)
+        {
+            size_t available = FIO_segment_fill(segment, finput, pos+FIO_BLOCKHEADER_MAX) - pos;
+            int cSize = FIO_getBlockCompressedSize(segment->buffer+pos, available, regenSize);
+            if (cSize<=0) return -1;   // corrupted, or truncated
+            if (FIO_segment_fill(segment, finput, pos+cSize) < pos+cSize) return -1;
+            pos += cSize;
+            segment->decodedSize += regenSize;
         }
 
-        // move remaining data to beginning of buffer
+        if (segment->last)
         {
-            size_t toCopy = iend-ip;
-            memcpy(in_buff, ip, toCopy);
-            ifill = in_buff + toCopy;
-            ip = in_buff;
+            if (FIO_segment_fill(segment, finput, pos+4) < pos+4) return -1;
+            segment->checksum = FIO_readLE(segment->buffer+pos, 4);
+            pos += 4;
         }
+        segment->size = pos;
     }
 
-_lastBlock:
+    return 0;
+}
+
+int FIO_decodeFrameSegment(void* dst, const FIO_frameSegment* segment, int blockSizeId)
+{
+    const U32 blockSize = FIO_GetBlockSize_FromBlockId(blockSizeId);
+    const int nbBytes = ((blockSizeId+10)/8)+1;
+    const BYTE* ip = segment->buffer;
+    const BYTE* const iend = ip + segment->size - (segment->last ? 4 : 0);
+    BYTE* op = (BYTE*)dst;
+
+    // Block sizes were checked by FIO_readFrameSegment()
+    while (ip < iend)
     {
-        int errorCode;
-        int nbBytes = ((blockSizeId+10)/8)+1;   // Nb Bytes to describe last block size
-        U32 lastBlockSize = LITTLE_ENDIAN_32(*(U32*)ip);
-        U32 mask;
-        ip += nbBytes;
-        switch(nbBytes)
+        U32 regenSize = blockSize;
+        int nbFullBlocks = *ip++;
+        if (!nbFullBlocks)
         {
-        case 2: mask = 0xFFFF; break;
-        case 3: mask = 0xFFFFFF; break;
-        default:
-        case 4: mask = 0xFFFFFFFF;
+            regenSize = FIO_readLE(ip, nbBytes);
+            ip += nbBytes;
+            nbFullBlocks = 1;
+        }
+        for ( ; nbFullBlocks; nbFullBlocks--)
+        {
+            int cSize = FIO_getBlockCompressedSize(ip, iend-ip, regenSize);
+            if (FSE_decompress_safe(op, (int)regenSize, ip, cSize) != cSize) return -1;
+            ip += cSize;
+            op += regenSize;
         }
-        lastBlockSize &= mask;
+    }
+
+    return 0;
+}
+
+void FIO_freeFrameSegment(FIO_frameSegment* segment)
+{
+    free(segment->buffer);
+    memset(segment, 0, sizeof(*segment));
+}
+
+
+/*********************************************************
+   Streaming decompression
+*********************************************************/
+#define FIO_DTABLECACHE_SIZE 8   // nb of DTables kept by a FSE_DStream (direct-mapped, indexed by header hash)
+
+typedef struct
+{
+    int    headerSize;       // 0 : empty entry
+    int    tableLog;
+    BYTE   header[FIO_BLOCKHEADER_MAX];
+    void*  DTable;
+    int    DTableCapacity;
+} FIO_DTableCacheEntry;
+
+typedef enum { ds_header, ds_nbBlocks, ds_lastBlockSize, ds_block, ds_checksum, ds_done, ds_error } FIO_DStream_stage;
+
+struct FSE_DStream_s
+{
+    FIO_DStream_stage stage;
+    int    blockSizeId;
+    U32    blockSize;
+    int    nbFullBlocks;
+    int    lastBlock;
+    U32    regenSize;        // uncompressed size of the block being received
+    int    cSize;            // compressed size of the block being received, 0 while unknown
+    BYTE   field[HEADERSIZE];   // largest fixed-size field
+    size_t fieldFilled;
+    BYTE*  stageBuffer;      // only used when a block straddles 2 fragments
+    size_t stageCapacity;
+    size_t staged;
+    BYTE*  out_buff;
+    U32    windowSize;
+    U32    outCapacity;
+    FSE_DStream_output output;
+    void*  opaque;
+    XXH32_stateSpace_t hashState;
+    FIO_DTableCacheEntry DTableCache[FIO_DTABLECACHE_SIZE];
+};
+
+
+FSE_DStream* FSE_createDStream(FSE_DStream_output outputFunction, void* opaque)
+{
+    FSE_DStream* dstream = (FSE_DStream*)calloc(1, sizeof(FSE_DStream));
+    if (dstream==NULL) return NULL;
+    dstream->output = outputFunction;
+    dstream->opaque = opaque;
+    FSE_resetDStream(dstream);
+    return dstream;
+}
+
+
+void FSE_resetDStream(FSE_DStream* dstream)
+{
+    dstream->stage = ds_header;
+    dstream->nbFullBlocks = 0;
+    dstream->lastBlock = 0;
+    dstream->cSize = 0;
+    dstream->fieldFilled = 0;
+    dstream->staged = 0;
+    XXH32_resetState(&(dstream->hashState), FSE_CHECKSUM_SEED);
+}
 
-        errorCode = FSE_decompress((unsigned char*)out_buff, lastBlockSize, ip);
-        if (errorCode == -1) EXM_THROW(33, "Decoding error : last block failed");
-        ip += errorCode;
-        filesize += lastBlockSize;
 
-        sizeCheck = fwrite(out_buff, 1, lastBlockSize, foutput);
-        if (sizeCheck != lastBlockSize) EXM_THROW(34, "Write error : unable to write data block to destination file");
-        XXH32_update(hashCtx, out_buff, lastBlockSize);
+void FSE_freeDStream(FSE_DStream* dstream)
+{
+    int i;
+    if (dstream==NULL) return;
+    for (i=0; i<FIO_DTABLECACHE_SIZE; i++) free(dstream->DTableCache[i].DTable);
+    free(dstream->stageBuffer);
+    free(dstream->out_buff);
+    free(dstream);
+}
+
+
+/* Collects a fixed-size field, which may be split across fragments.
+   return : pointer to the complete field, or NULL if more input is needed */
+static const BYTE* FIO_DStream_getField(FSE_DStream* dstream, const BYTE** ipPtr, const BYTE* iend, size_t fieldSize)
+{
+    const BYTE* ip = *ipPtr;
+    size_t toCopy;
+    if ((dstream->fieldFilled==0) && ((size_t)(iend-ip) >= fieldSize))
+    {
+        *ipPtr = ip + fieldSize;   // fully present : no copy
+        return ip;
     }
+    toCopy = fieldSize - dstream->fieldFilled;
+    if (toCopy > (size_t)(iend-ip)) toCopy = iend-ip;
+    memcpy(dstream->field + dstream->fieldFilled, ip, toCopy);
+    dstream->fieldFilled += toCopy;
+    *ipPtr = ip + toCopy;
+    if (dstream->fieldFilled < fieldSize) return NULL;
+    dstream->fieldFilled = 0;
+    return dstream->field;
+}
 
-    // CRC verification
+
+static int FIO_DStream_sink(void* opaque, const unsigned char* decoded, int size)
+{
+    FSE_DStream* const dstream = (FSE_DStream*)opaque;
+    XXH32_update(&(dstream->hashState), decoded, size);
+    return dstream->output(dstream->opaque, decoded, size);
+}
+
+
+/* Provides the DTable of a compressed block header, building it only if it's not already cached.
+   return : cache entry, or NULL if the header is corrupted */
+static FIO_DTableCacheEntry* FIO_DStream_getDTable(FSE_DStream* dstream, const BYTE* block, int cSize)
+{
+    U32 counting[256];
+    int nbSymbols, tableLog, spread;
+    FIO_DTableCacheEntry* entry;
+    int headerSize = FSE_readHeader_spread(counting, &nbSymbols, &tableLog, &spread, block, cSize);
+    if ((headerSize==-1) || (headerSize > FIO_BLOCKHEADER_MAX)) return NULL;
+
+    entry = dstream->DTableCache + (XXH32(block, headerSize, 0) % FIO_DTABLECACHE_SIZE);
+    if ((entry->headerSize==headerSize) && !memcmp(entry->header, block, headerSize)) return entry;   // cache hit
+
+    entry->headerSize = 0;
+    if (entry->DTableCapacity < FSE_sizeof_DTable(tableLog))
     {
-        U32 CRCsaved = *(U32*)ip;
-        U32 CRCcalculated = XXH32_digest(hashCtx);
-        if (CRCsaved != CRCcalculated) EXM_THROW(35, "CRC error : wrong checksum, corrupted data");
+        free(entry->DTable);
+        entry->DTableCapacity = FSE_sizeof_DTable(tableLog);
+        entry->DTable = malloc(entry->DTableCapacity);
+        if (entry->DTable==NULL) { entry->DTableCapacity = 0; return NULL; }
     }
+    if (FSE_buildDTable_spread(entry->DTable, counting, nbSymbols, tableLog, spread) == -1) return NULL;
+    memcpy(entry->header, block, headerSize);
+    entry->headerSize = headerSize;
+    entry->tableLog = tableLog;
+    return entry;
+}
 
-    DISPLAYLEVEL(2, "\r%79s\r", "");
-    DISPLAYLEVEL(2,"Decoded %llu bytes\n", (long long unsigned)filesize);
 
-    // Free
-    free(in_buff);
-    free(out_buff);
-    fclose(finput);
-    fclose(foutput);
+static int FIO_DStream_decodeBlock(FSE_DStream* dstream, const BYTE* block)
+{
+    int errorCode;
+    if ((block[0]&3)>=2)   // FSE block : reuse a cached DTable if possible
+    {
+        FIO_DTableCacheEntry* entry = FIO_DStream_getDTable(dstream, block, dstream->cSize);
+        if (entry==NULL) return -1;
+        errorCode = FSE_decompress_usingDTable_toSink(dstream->out_buff, (int)dstream->windowSize, (int)dstream->regenSize,
+                                                      block + entry->headerSize, dstream->cSize - entry->headerSize,
+                                                      entry->DTable, entry->tableLog, FIO_DStream_sink, dstream);
+        if (errorCode != dstream->cSize - entry->headerSize) return -1;
+    }
+    else
+    {
+        errorCode = FSE_decompress_toSink(dstream->out_buff, (int)dstream->windowSize, (int)dstream->regenSize, block, dstream->cSize, FIO_DStream_sink, dstream);
+        if (errorCode != dstream->cSize) return -1;
+    }
+    dstream->cSize = 0;
+    dstream->stage = dstream->lastBlock ? ds_checksum : ds_nbBlocks;
+    return 0;
+}
 
-    return filesize;
+
+static int FIO_DStream_nextBlock(FSE_DStream* dstream, const BYTE** ipPtr, const BYTE* const iend)
+{
+    const BYTE* ip = *ipPtr;
+    size_t toCopy;
+
+    // Block entirely present within current fragment : decode in place
+    if (dstream->staged==0)
+    {
+        dstream->cSize = FIO_getBlockCompressedSize(ip, iend-ip, dstream->regenSize);
+        if (dstream->cSize==-1) return -1;
+        if ((dstream->cSize>0) && ((size_t)(iend-ip) >= (size_t)dstream->cSize))
+        {
+            *ipPtr = ip + dstream->cSize;
+            return FIO_DStream_decodeBlock(dstream, ip);
+        }
+    }
+
+    // Block straddles fragments : buffer it
+    if (dstream->cSize==0)
+    {
+        // size still unknown : provisionally copy just enough to determine it
+        size_t provisional = FIO_BLOCKHEADER_MAX - dstream->staged;
+        if (provisional > (size_t)(iend-ip)) provisional = iend-ip;
+        memcpy(dstream->stageBuffer + dstream->staged, ip, provisional);
+        dstream->cSize = FIO_getBlockCompressedSize(dstream->stageBuffer, dstream->staged + provisional, dstream->regenSize);
+        if (dstream->cSize==-1) return -1;
+        if (dstream->cSize==0)
+        {
+            dstream->staged += provisional;
+            *ipPtr = iend;
+            return 0;
+        }
+    }
+    toCopy = dstream->cSize - dstream->staged;
+    if (toCopy > (size_t)(iend-ip)) toCopy = iend-ip;
+    memcpy(dstream->stageBuffer + dstream->staged, ip, toCopy);
+    dstream->staged += toCopy;
+    *ipPtr = ip + toCopy;
+    if (dstream->staged < (size_t)dstream->cSize) return 0;
+    dstream->staged = 0;
+    return FIO_DStream_decodeBlock(dstream, dstream->stageBuffer);
 }
 
 
+int FSE_DStream_update(FSE_DStream* dstream, const void* src, size_t srcSize)
+{
+    const BYTE* ip = (const BYTE*)src;
+    const BYTE* const iend = ip + srcSize;
+    const BYTE* field;
+
+    while (1)
+    {
+        switch(dstream->stage)
+        {
+        case ds_header:
+            field = FIO_DStream_getField(dstream, &ip, iend, HEADERSIZE);
+            if (field==NULL) return 1;
+            if (LITTLE_ENDIAN_32(*(U32*)field) != FSE_MAGIC_NUMBER) goto _error;
+            dstream->blockSizeId = field[4];
+            if (dstream->blockSizeId > 0xF) goto _error;
+            dstream->blockSize = FIO_GetBlockSize_FromBlockId(dstream->blockSizeId);
+            dstream->windowSize = (dstream->blockSize < FIO_DECODE_WINDOW) ? dstream->blockSize : FIO_DECODE_WINDOW;
+            if (dstream->stageCapacity < (size_t)FSE_compressBound((int)dstream->blockSize))   // buffers are kept across resets
+            {
+                free(dstream->stageBuffer);
+                dstream->stageCapacity = FSE_compressBound((int)dstream->blockSize);
+                dstream->stageBuffer = (BYTE*)malloc(dstream->stageCapacity);
+            }
+            if (dstream->outCapacity < dstream->windowSize)
+            {
+                free(dstream->out_buff);
+                dstream->outCapacity = dstream->windowSize;
+                dstream->out_buff = (BYTE*)malloc(dstream->outCapacity);
+            }
+            if (!dstream->stageBuffer || !dstream->out_buff) { dstream->stageCapacity = dstream->outCapacity = 0; goto _error; }
+            dstream->stage = ds_nbBlocks;
+            break;
+
+        case ds_nbBlocks:
+            if (dstream->nbFullBlocks == 0)
+            {
+                if (ip==iend) return 1;
+                dstream->nbFullBlocks = *ip++;
+                if (!dstream->nbFullBlocks) { dstream->stage = ds_lastBlockSize; break; }
+            }
+            dstream->nbFullBlocks--;
+            dstream->regenSize = dstream->blockSize;
+            dstream->stage = ds_block;
+            break;
+
+        case ds_lastBlockSize:
+            {
+                int nbBytes = ((dstream->blockSizeId+10)/8)+1;   // Nb Bytes to describe last block size
+                int i;
+                field = FIO_DStream_getField(dstream, &ip, iend, nbBytes);
+                if (field==NULL) return 1;
+                dstream->regenSize = 0;
+                for (i=nbBytes-1; i>=0; i--) dstream->regenSize = (dstream->regenSize << 8) + field[i];
+                if (dstream->regenSize > dstream->blockSize) goto _error;
+                dstream->lastBlock = 1;
+                dstream->stage = ds_block;
+                break;
+            }
+
+        case ds_block:
+            if (FIO_DStream_nextBlock(dstream, &ip, iend)) goto _error;
+            if (dstream->stage==ds_block) return 1;   // block incomplete, fragment exhausted
+            break;
+
+        case ds_checksum:
+            field = FIO_DStream_getField(dstream, &ip, iend, 4);
+            if (field==NULL) return 1;
+            if (LITTLE_ENDIAN_32(*(U32*)field) != XXH32_intermediateDigest(&(dstream->hashState))) goto _error;
+            dstream->stage = ds_done;
+            break;
+
+        case ds_done:
+            return 0;
+
+        default:
+        case ds_error:
+            return -1;
+        }
+    }
+
+_error:
+    dstream->stage = ds_error;
+    return -1;
+}
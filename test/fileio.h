@@ -27,6 +27,13 @@ extern "C" {
 #endif
 
 
+//**************************************
+// Includes
+//**************************************
+#include <stddef.h>   // size_t
+#include <stdio.h>    // FILE
+
+
 //**************************************
 // Special input/output constants
 //**************************************
@@ -55,6 +62,103 @@ void FIO_overwriteMode();
 //**************************************
 int compress_file (char* outfilename, char* infilename);
 unsigned long long decompress_file (char* outfilename, char* infilename);
+int get_fileHandle(char* input_filename, char* output_filename, FILE** pfinput, FILE** pfoutput);
+
+
+//**************************************
+// Memory functions
+//**************************************
+#define FIO_ERROR ((size_t)-1)   // result of FIO_compressFrame() and FIO_compressFrameSegment() when a block can't be compressed
+size_t FIO_compressFrameBound(size_t srcSize);
+size_t FIO_compressFrame(void* dst, const void* src, size_t srcSize);
+/*
+FIO_compressFrame():
+    Same as compress_file(), from 'src' to 'dst' : produces a complete stream, which can be decoded by decompress_file() or FSE_DStream.
+    'dst' must be at least FIO_compressFrameBound(srcSize) large.
+    'srcSize' must be < 2 GB.
+    return : size of the stream written into 'dst', or FIO_ERROR
+*/
+
+
+//**************************************
+// Frame segments
+//**************************************
+size_t FIO_frameSegmentUnit(void);
+size_t FIO_compressFrameHeader (void* dst);
+size_t FIO_compressFrameSegment(void* dst, const void* src, size_t srcSize, int lastSegment);
+size_t FIO_compressFrameEnd    (void* dst, unsigned checksum);
+/*
+A frame can be produced piece by piece, so that its segments are compressed independently (in parallel) :
+    header, then segments in order, then end (checksum = XXH32() of all source data).
+    The result is identical to FIO_compressFrame() of the whole source.
+    All segments but the last must have a size multiple of FIO_frameSegmentUnit().
+    The last one can have any size, including 0.
+    Segment 'dst' must be at least FIO_compressFrameBound(srcSize) large.
+    FIO_compressFrameSegment() returns the size written into 'dst', or FIO_ERROR.
+*/
+
+typedef struct
+{
+    unsigned char* buffer;
+    size_t capacity;
+    size_t size;                    // compressed size of segment
+    size_t filled;                  // bytes read : those beyond 'size' belong to next segment
+    unsigned long long decodedSize;
+    int    last;                    // segment ends the frame : 'checksum' is provided
+    unsigned checksum;
+} FIO_frameSegment;
+
+int  FIO_readFrameHeader   (FILE* finput);
+int  FIO_readFrameSegment  (FIO_frameSegment* segment, const FIO_frameSegment* previous, FILE* finput, int blockSizeId, size_t targetSize);
+int  FIO_decodeFrameSegment(void* dst, const FIO_frameSegment* segment, int blockSizeId);
+void FIO_freeFrameSegment  (FIO_frameSegment* segment);
+/*
+Conversely, a frame can be cut into segments, which are decoded independently.
+FIO_readFrameHeader():
+    return : blockSizeId of the frame, or -1 if header is invalid
+FIO_readFrameSegment():
+    Reads the next segment of the frame, made of complete groups of blocks, until at least 'targetSize' decoded bytes, or end of frame.
+    'segment' must be zero-initialized before first use; its buffer is kept and grown as needed.
+    'previous' is the segment read before this one, or NULL for the first one :
+    bytes read beyond it are moved into 'segment'. 'previous' may still be decoded meanwhile.
+    Block sizes are checked, so a truncated or corrupted frame is detected here.
+    return : 0, or -1 on error
+FIO_decodeFrameSegment():
+    Decodes segment->decodedSize bytes into 'dst'.
+    Decoded data must still be checked against segment->checksum, provided by last segment.
+    return : 0, or -1 if data is corrupted
+*/
+
+
+//**************************************
+// Streaming decompression
+//**************************************
+typedef struct FSE_DStream_s FSE_DStream;
+typedef int (*FSE_DStream_output)(void* opaque, const void* decoded, size_t size);
+
+FSE_DStream* FSE_createDStream (FSE_DStream_output outputFunction, void* opaque);
+int          FSE_DStream_update(FSE_DStream* dstream, const void* src, size_t srcSize);
+void         FSE_resetDStream  (FSE_DStream* dstream);
+void         FSE_freeDStream   (FSE_DStream* dstream);
+/*
+FSE_DStream_update():
+    Feeds the next fragment of a compressed stream (same format as decompress_file()).
+    Fragments can have any size, including 0, and be cut anywhere.
+    Each block is decoded as soon as its last byte is received, and handed over to outputFunction()
+    by chunks of up to 256 KB, so that decoded data is consumed while still in cache.
+    outputFunction() must return 0 to continue; any other value aborts decoding.
+    Fragments are decoded directly from their source memory whenever possible :
+    only a block or field straddling 2 fragments is buffered, in a buffer of FSE_compressBound(blockSize) bytes.
+    Compressed data is considered untrusted : blocks are decoded using FSE_decompress_toSink().
+    Chunks of a corrupted block may be handed over before the corruption is detected.
+    return : 1 when more input is expected
+             0 when the stream is complete and its checksum verified (remaining input is ignored)
+             -1 on error (corrupted data, wrong checksum, allocation failure, or aborted by outputFunction)
+FSE_resetDStream():
+    Prepares 'dstream' to receive a new stream, whatever the state of the previous one.
+    Buffers are kept, as well as the DTables of recently seen block headers :
+    a long-lived FSE_DStream decodes blocks sharing a header without rebuilding their DTable.
+*/
 
 
 #if defined (__cplusplus)
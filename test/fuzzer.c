@@ -35,6 +35,10 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include <sys/timeb.h> // timeb
 #include "fse.h"
 #include "xxhash.h"
+#include "fileio.h"    // FSE_DStream
+#if defined(FSE_TEST_DISPATCH)
+extern int FSE_testPortable;   // defined by fse.c, test only
+#endif
 
 
 //****************************************************************
@@ -61,6 +65,7 @@ typedef unsigned long long  U64;
 //******************************
 // Constants
 //******************************
+#define KB *(1<<10)
 #define MB *(1<<20)
 #define BUFFERSIZE ((1 MB) - 1)
 #define FUZ_NB_TESTS  65536
@@ -113,6 +118,44 @@ static unsigned int FUZ_rand (unsigned int* src)
 }
 
 
+// Sink for FSE_decompress_toSink() : rebuilds a hash of decoded data
+static int FUZ_hashSink (void* opaque, const unsigned char* decoded, int size)
+{
+    XXH32_update (opaque, decoded, size);
+    return 0;
+}
+
+
+typedef struct
+{
+    const BYTE* expected;
+    size_t size;
+    size_t pos;
+    int    corrupted;
+} FUZ_streamCheck;
+
+static int FUZ_streamSink (void* opaque, const void* decoded, size_t size)
+{
+    FUZ_streamCheck* const check = (FUZ_streamCheck*)opaque;
+    if ((size > check->size - check->pos) || memcmp (decoded, check->expected + check->pos, size)) check->corrupted = 1;
+    else check->pos += size;
+    return 0;
+}
+
+// Random fragment size : often 0 or 1, sometimes tiny, sometimes up to ~128 KB
+static size_t FUZ_fragmentSize (U32* seed)
+{
+    const U32 r = FUZ_rand (seed);
+    switch (r & 3)
+    {
+    case 0: return 0;
+    case 1: return 1;
+    case 2: return (r >> 2) & 15;
+    default: return (r >> 2) & 0x1FFFF;
+    }
+}
+
+
 static void generate (void* buffer, size_t buffSize, double p, U32* seed)
 {
     char table[PROBATABLESIZE];
@@ -178,6 +221,115 @@ static void FUZ_tests (U32 seed, U32 startTestNb)
     generate (bufferSrc, BUFFERSIZE, 0.1, &seed);
     generateNoise (bufferNoise, BUFFERSIZE, &seed);
 
+    /* full alphabet at small tableLogs : table must be raised to represent all 256 symbols */
+    {
+        BYTE fullAlphabet[8 KB];
+        U32 LMTable[FSE_LOWMEM_TABLESIZE/4];
+        int skewed, i, result, sizeCompressed;
+        for (skewed=0; skewed<2; skewed++)
+        {
+            for (i=0; i<(int)sizeof(fullAlphabet); i++)
+                fullAlphabet[i] = skewed ? (BYTE)((i&7) ? 0 : i>>3) : (BYTE)i;   // skewed : a symbol beyond FSE_LOWMEM_MAX_COUNT
+            for (tableLog=5; tableLog<=9; tableLog++)
+            {
+                sizeCompressed = FSE_compress2 (bufferDst, fullAlphabet, sizeof(fullAlphabet), 0, tableLog);
+                result = FSE_decompress_safe (bufferVerif, sizeof(fullAlphabet), bufferDst, sizeCompressed);
+                if ((sizeCompressed == -1) || (result != sizeCompressed) || memcmp (bufferVerif, fullAlphabet, sizeof(fullAlphabet)))
+                    DISPLAY ("Full alphabet failed at tableLog %i ! \n", tableLog);
+                sizeCompressed = FSE_compressLowMem (bufferDst, fullAlphabet, sizeof(fullAlphabet), tableLog, LMTable);
+                result = FSE_decompressLowMem (bufferVerif, sizeof(fullAlphabet), bufferDst, sizeCompressed, LMTable);
+                if ((sizeCompressed == -1) || (result != sizeCompressed) || memcmp (bufferVerif, fullAlphabet, sizeof(fullAlphabet)))
+                    DISPLAY ("Full alphabet low memory failed at tableLog %i ! \n", tableLog);
+            }
+        }
+    }
+
+    /* streaming decoder : frames fed by fragments of random sizes, cut anywhere */
+    {
+        const size_t srcSize = 600 KB;   // several blocks, compressed and (from noise) raw
+        BYTE* const src = (BYTE*) malloc (srcSize);
+        BYTE* const frame = (BYTE*) malloc (FIO_compressFrameBound (srcSize));
+        FUZ_streamCheck check;
+        FSE_DStream* const dstream = FSE_createDStream (FUZ_streamSink, &check);
+        U32 fragmentSeed = seed;   // main series is left untouched
+        int round;
+        if (!src || !frame || !dstream) { DISPLAY ("Not enough memory for streaming test ! \n"); exit (1); }
+        memcpy (src, bufferSrc, srcSize - 100 KB);
+        memcpy (src + srcSize - 100 KB, bufferNoise, 100 KB);
+        for (round=0; round<8; round++)
+        {
+            const size_t frameSize = FIO_compressFrame (frame, src, srcSize);
+            const size_t fedSize = (round&1) ? frameSize - 1 - (FUZ_rand (&fragmentSeed) % (frameSize-1)) : frameSize;   // odd rounds : truncated
+            size_t fed = 0;
+            int result = 1;
+            if (frameSize == FIO_ERROR) { DISPLAY ("Frame compression failed ! \n"); break; }
+            memset (&check, 0, sizeof(check));
+            check.expected = src;
+            check.size = srcSize;
+            FSE_resetDStream (dstream);
+            while ((result==1) && (fed < fedSize))
+            {
+                size_t fragment = FUZ_fragmentSize (&fragmentSeed);
+                if (fragment > fedSize - fed) fragment = fedSize - fed;
+                result = FSE_DStream_update (dstream, frame + fed, fragment);
+                fed += fragment;
+            }
+            if (check.corrupted)
+                DISPLAY ("Streaming decoder : decoded data corrupted (round %i) ! \n", round);
+            if (fedSize == frameSize)
+            {
+                if ((result != 0) || (check.pos != srcSize))
+                    DISPLAY ("Streaming decoder : fragmented frame not decoded (round %i, result %i) ! \n", round, result);
+            }
+            else if (result == 0)
+                DISPLAY ("Streaming decoder : truncated frame reported complete (round %i, %i / %i bytes) ! \n", round, (int)fedSize, (int)frameSize);
+
+            // corrupted checksum : error, even when received 1 byte at a time
+            frame[frameSize-1] ^= 1;
+            FSE_resetDStream (dstream);
+            memset (&check, 0, sizeof(check));
+            check.expected = src;
+            check.size = srcSize;
+            for (fed=frameSize-5, result = FSE_DStream_update (dstream, frame, fed); (result==1) && (fed<frameSize); fed++)
+                result = FSE_DStream_update (dstream, frame + fed, 1);
+            if (result != -1)
+                DISPLAY ("Streaming decoder : wrong checksum not detected (round %i) ! \n", round);
+        }
+        FSE_freeDStream (dstream);
+        free (frame);
+        free (src);
+    }
+
+#if defined(FSE_TEST_DISPATCH)
+    /* cpu dispatch : both variants must produce identical streams, and decode each other's */
+    {
+        static const int sizes[] = { 1 KB, 64 KB, BUFFERSIZE };
+        int s, encoder, decoder, result, sizeCompressed, refSize = 0;
+        U32 refHash = 0;
+        for (s=0; s<(int)(sizeof(sizes)/sizeof(sizes[0])); s++)
+        for (encoder=0; encoder<2; encoder++)
+        {
+            FSE_testPortable = encoder;
+            sizeCompressed = FSE_compress2 (bufferDst, bufferSrc, sizes[s], 0, 0);
+            if (sizeCompressed == -1) { DISPLAY ("Dispatch : compression failed (portable=%i, %i bytes) ! \n", encoder, sizes[s]); continue; }
+            if (encoder==0) { refSize = sizeCompressed; refHash = XXH32 (bufferDst, sizeCompressed, 0); }
+            else if ((sizeCompressed != refSize) || (XXH32 (bufferDst, sizeCompressed, 0) != refHash))
+                DISPLAY ("Dispatch : compressed streams differ (%i bytes) ! \n", sizes[s]);
+            for (decoder=0; decoder<2; decoder++)
+            {
+                FSE_testPortable = decoder;
+                result = FSE_decompress_safe (bufferVerif, sizes[s], bufferDst, sizeCompressed);
+                if ((result != sizeCompressed) || memcmp (bufferVerif, bufferSrc, sizes[s]))
+                    DISPLAY ("Dispatch : safe decoding failed (encoder portable=%i, decoder portable=%i, %i bytes) ! \n", encoder, decoder, sizes[s]);
+                result = FSE_decompress (bufferVerif, sizes[s], bufferDst);
+                if ((result != sizeCompressed) || memcmp (bufferVerif, bufferSrc, sizes[s]))
+                    DISPLAY ("Dispatch : decoding failed (encoder portable=%i, decoder portable=%i, %i bytes) ! \n", encoder, decoder, sizes[s]);
+            }
+        }
+        FSE_testPortable = 0;
+    }
+#endif
+
     if (startTestNb)
     {
         U32 i;
@@ -233,6 +385,69 @@ static void FUZ_tests (U32 seed, U32 startTestNb)
                     U32 hashEnd = XXH32 (bufferVerif, sizeOrig, 0);
                     if (hashEnd != hashOrig) DISPLAY ("Data corrupted !! \n");
                 }
+                {
+                    /* decoding into a sink, using a small window */
+                    int windowSize = (hashOrig & 0xFFF) + 2;
+                    void* hashCtx = XXH32_init (0);
+                    result = FSE_decompress_toSink (bufferVerif, windowSize, sizeOrig, bufferDst, sizeCompressed, FUZ_hashSink, hashCtx);
+                    if (result != sizeCompressed)
+                        DISPLAY ("Decompression into sink failed ! \n");
+                    if (XXH32_digest (hashCtx) != hashOrig)
+                        DISPLAY ("Data decoded into sink corrupted !! \n");
+                }
+                {
+                    /* segmented input and output : same result as contiguous buffers */
+                    FSE_iovec segments[3];
+                    int cut1 = (hashOrig >> 12) % sizeOrig;
+                    int cut2 = cut1 + ((hashOrig >> 4) % (sizeOrig - cut1 + 1));
+                    segments[0].ptr = bufferTest;        segments[0].len = cut1;
+                    segments[1].ptr = bufferTest + cut1; segments[1].len = cut2 - cut1;
+                    segments[2].ptr = bufferTest + cut2; segments[2].len = sizeOrig - cut2;
+                    result = FSE_compressv (bufferVerif, segments, 3);
+                    if ((result != sizeCompressed) || memcmp (bufferVerif, bufferDst, sizeCompressed))
+                        DISPLAY ("Segmented compression differs ! \n");
+                    segments[0].ptr = bufferVerif;
+                    segments[1].ptr = bufferVerif + cut1;
+                    segments[2].ptr = bufferVerif + cut2;
+                    result = FSE_decompressv (segments, 3, bufferDst, sizeCompressed);
+                    if ((result != sizeCompressed) || (XXH32 (bufferVerif, sizeOrig, 0) != hashOrig))
+                        DISPLAY ("Segmented decompression failed ! \n");
+                }
+                if (sizeCompressed > 1)
+                {
+                    /* truncated input must be detected */
+                    int sizeTruncated = hashOrig % sizeCompressed;
+                    result = FSE_decompress_safe (bufferVerif, sizeOrig, bufferDst, sizeTruncated);
+                    if (result != -1)
+                        DISPLAY ("Truncated input not detected !\n");
+                }
+                {
+                    /* low memory engine : all tables within a small workspace */
+                    U32 LMTable[FSE_LOWMEM_TABLESIZE/4];
+                    int tableLogLM = (hashOrig >> 20) % (FSE_LOWMEM_MAX_TABLELOG+1);   // 0 : default
+                    sizeCompressed = FSE_compressLowMem (bufferDst, bufferTest, sizeOrig, tableLogLM, LMTable);
+                    if (sizeCompressed == -1)
+                        DISPLAY ("Low memory compression failed ! \n");
+                    result = FSE_decompressLowMem (bufferVerif, sizeOrig, bufferDst, sizeCompressed, LMTable);
+                    if ((result != sizeCompressed) || (XXH32 (bufferVerif, sizeOrig, 0) != hashOrig))
+                        DISPLAY ("Low memory decompression failed ! \n");
+                    if (sizeCompressed > 1)
+                    {
+                        result = FSE_decompressLowMem (bufferVerif, sizeOrig, bufferDst, hashOrig % sizeCompressed, LMTable);
+                        if (result != -1)
+                            DISPLAY ("Truncated low memory input not detected !\n");
+                    }
+                }
+                {
+                    /* explicit spread : stored into header, followed by decoders */
+                    int spread = 1 + (hashOrig >> 24) % (FSE_NB_SPREADS-1);
+                    sizeCompressed = FSE_compress_spread (bufferDst, bufferTest, sizeOrig, 0, 0, spread);
+                    if (sizeCompressed == -1)
+                        DISPLAY ("Compression with spread %i failed ! \n", spread);
+                    result = FSE_decompress_safe (bufferVerif, sizeOrig, bufferDst, sizeCompressed);
+                    if ((result != sizeCompressed) || (XXH32 (bufferVerif, sizeOrig, 0) != hashOrig))
+                        DISPLAY ("Decompression with spread %i failed ! \n", spread);
+                }
             }
         }
 
@@ -0,0 +1,205 @@
+/*
+  membudget.c - global memory budget, for FSE
+  Copyright (C) Yann Collet 2013-2014
+  GPL v2 License
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License along
+  with this program; if not, write to the Free Software Foundation, Inc.,
+  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+  You can contact the author at :
+  - Public forum : https://groups.google.com/forum/#!forum/lz4c
+*/
+/*
+  Note : this is stand-alone program.
+  It is not part of FSE compression library, it is a user program of the FSE library.
+  The license of FSE library is BSD.
+  The license of this program is GPLv2.
+*/
+
+
+//**************************************
+// Compiler Options
+//**************************************
+#define _POSIX_C_SOURCE 200809L   // sysconf, clock_gettime
+#if defined(__linux__)
+#  define _GNU_SOURCE             // _SC_PHYS_PAGES
+#endif
+
+
+//**************************************
+// Includes
+//**************************************
+#include <stdio.h>    // fopen, fscanf (cgroup limit)
+#if !defined(_WIN32)
+#  include <unistd.h> // sysconf
+#endif
+#include "membudget.h"
+#include "scheduler.h"
+
+
+//**************************************
+// Basic Types
+//**************************************
+#if defined (__STDC_VERSION__) && __STDC_VERSION__ >= 199901L   // C99
+# include <stdint.h>
+typedef uint64_t U64;
+#else
+typedef unsigned long long  U64;
+#endif
+
+
+//**************************************
+// Constants
+//**************************************
+#define KB *(1U<<10)
+#define MB *(1U<<20)
+#define GB *(1U<<30)
+
+#define MEM_DEFAULT_BUDGET  (1 GB)   // when available memory cannot be determined
+#define MEM_MIN_BUDGET      (1 MB)
+#define MEM_WAIT_MS         1        // waiting threads of the pool look for tasks to run at this interval
+
+
+//**************************************
+// Local Parameters
+//**************************************
+static U64 budget = 0;   // 0 = automatic
+static U64 autoBudget = 0;
+static size_t inUse = 0;
+
+
+//**************************************
+// Budget
+//**************************************
+void MEM_setBudget(unsigned long long newBudget) { budget = newBudget; }
+
+// return : limit found in file 'fileName', or 0 ("max", or no such file)
+static U64 MEM_readLimit(const char* fileName)
+{
+    FILE* f = fopen(fileName, "r");
+    unsigned long long limit = 0;
+    if (f==NULL) return 0;
+    if (fscanf(f, "%llu", &limit) != 1) limit = 0;
+    fclose(f);
+    return limit;
+}
+
+static U64 MEM_availableMemory(void)
+{
+    U64 available = 0;
+#if defined(_SC_PHYS_PAGES) && defined(_SC_PAGESIZE)
+    {
+        long nbPages = sysconf(_SC_PHYS_PAGES);
+        long pageSize = sysconf(_SC_PAGESIZE);
+        if ((nbPages > 0) && (pageSize > 0)) available = (U64)nbPages * (U64)pageSize;
+    }
+#endif
+#if defined(__linux__)
+    {
+        static const char* const limitFiles[] = { "/sys/fs/cgroup/memory.max",                       // cgroup v2
+                                                  "/sys/fs/cgroup/memory/memory.limit_in_bytes" };   // cgroup v1
+        int i;
+        for (i=0; i<2; i++)
+        {
+            U64 limit = MEM_readLimit(limitFiles[i]);
+            if ((limit > 0) && ((available==0) || (limit < available))) available = limit;
+        }
+    }
+#endif
+    return available;
+}
+
+size_t MEM_getBudget(void)
+{
+    U64 result = budget;
+    if (result==0)
+    {
+        if (autoBudget==0)
+        {
+            autoBudget = MEM_availableMemory() / 2;
+            if (autoBudget==0) autoBudget = MEM_DEFAULT_BUDGET;
+        }
+        result = autoBudget;
+    }
+    if (result < MEM_MIN_BUDGET) result = MEM_MIN_BUDGET;
+    if (result > (size_t)-1 / 2) result = (size_t)-1 / 2;   // 32-bits
+    return (size_t)result;
+}
+
+
+#if defined(_WIN32)
+
+// Single thread : accounting only, reservations never wait
+void MEM_acquire(size_t size) { inUse += size; }
+int  MEM_tryAcquire(size_t size) { inUse += size; return 1; }
+void MEM_release(size_t size) { inUse -= size; }
+
+#else
+
+#include <pthread.h>
+#include <time.h>      // clock_gettime
+
+static pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t  released = PTHREAD_COND_INITIALIZER;
+
+// must be called with mutex locked
+static int MEM_reserve(size_t size)
+{
+    if ((inUse > 0) && (inUse + size > MEM_getBudget())) return 0;
+    inUse += size;
+    return 1;
+}
+
+int MEM_tryAcquire(size_t size)
+{
+    int result;
+    pthread_mutex_lock(&mutex);
+    result = MEM_reserve(size);
+    pthread_mutex_unlock(&mutex);
+    return result;
+}
+
+void MEM_acquire(size_t size)
+{
+    const int worker = (SCH_workerId() >= 0);
+    pthread_mutex_lock(&mutex);
+    while (!MEM_reserve(size))
+    {
+        if (worker)
+        {
+            // Tasks releasing memory may be queued behind this thread : run some, instead of sleeping
+            struct timespec deadline;
+            pthread_mutex_unlock(&mutex);
+            if (SCH_help()) { pthread_mutex_lock(&mutex); continue; }
+            clock_gettime(CLOCK_REALTIME, &deadline);
+            deadline.tv_nsec += MEM_WAIT_MS * 1000000;
+            if (deadline.tv_nsec >= 1000000000) { deadline.tv_sec++; deadline.tv_nsec -= 1000000000; }
+            pthread_mutex_lock(&mutex);
+            if (!MEM_reserve(size)) pthread_cond_timedwait(&released, &mutex, &deadline);
+            else break;
+        }
+        else pthread_cond_wait(&released, &mutex);
+    }
+    pthread_mutex_unlock(&mutex);
+}
+
+void MEM_release(size_t size)
+{
+    pthread_mutex_lock(&mutex);
+    inUse -= size;
+    pthread_cond_broadcast(&released);
+    pthread_mutex_unlock(&mutex);
+}
+
+#endif   // _WIN32
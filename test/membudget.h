@@ -0,0 +1,71 @@
+/*
+  membudget.h - global memory budget - header
+  Copyright (C) Yann Collet 2013-2014
+  GPL v2 License
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License along
+  with this program; if not, write to the Free Software Foundation, Inc.,
+  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+  You can contact the author at :
+  - Public forum : https://groups.google.com/forum/#!forum/lz4c
+*/
+#pragma once
+
+#if defined (__cplusplus)
+extern "C" {
+#endif
+
+
+//**************************************
+// Includes
+//**************************************
+#include <stddef.h>   // size_t
+
+
+//**************************************
+// Parameters
+//**************************************
+void   MEM_setBudget(unsigned long long budget);   // 0 = automatic (default)
+size_t MEM_getBudget(void);
+/*
+The budget bounds the memory used for data buffers by all modes : sizes of buffers, nb of threads
+and nb of blocks in flight are derived from it, instead of probing how much malloc() accepts
+(which, within a container, can exceed its limit and get the process killed rather than fail).
+MEM_getBudget():
+    return : budget set by MEM_setBudget(), or by default half of available memory,
+             which is the smallest of physical memory and of the cgroup limit (if any)
+*/
+
+
+//**************************************
+// Accounting
+//**************************************
+void MEM_acquire   (size_t size);
+int  MEM_tryAcquire(size_t size);
+void MEM_release   (size_t size);
+/*
+MEM_acquire():
+    Reserves 'size' bytes of the budget before allocating them. Blocks while the budget is exhausted,
+    until enough is released (backpressure on producers). A thread of the pool (see scheduler.h) runs
+    queued tasks while waiting. A request larger than the whole budget is granted once nothing else is reserved.
+MEM_tryAcquire():
+    Same, without blocking. return : 1 if reserved, 0 otherwise
+MEM_release():
+    Returns bytes reserved by MEM_acquire() or MEM_tryAcquire().
+*/
+
+
+#if defined (__cplusplus)
+}
+#endif
@@ -0,0 +1,153 @@
+/*
+  perfcount.c - hardware performance counters, for FSE benchmark
+  Copyright (C) Yann Collet 2013-2014
+  GPL v2 License
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License along
+  with this program; if not, write to the Free Software Foundation, Inc.,
+  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+  You can contact the author at :
+  - Public forum : https://groups.google.com/forum/#!forum/lz4c
+*/
+/*
+  Note : this is stand-alone program.
+  It is not part of FSE compression library, it is a user program of the FSE library.
+  The license of FSE library is BSD.
+  The license of this program is GPLv2.
+*/
+
+
+//**************************************
+// Compiler Options
+//**************************************
+#if defined(__linux__)
+#  define _GNU_SOURCE             // syscall
+#endif
+
+
+//**************************************
+// Includes
+//**************************************
+#include <string.h>   // memset
+#include "perfcount.h"
+
+#if defined(__linux__)
+#  include <unistd.h>             // syscall, read, close
+#  include <sys/ioctl.h>          // ioctl
+#  include <sys/syscall.h>        // SYS_perf_event_open
+#  include <linux/perf_event.h>
+#  define PRF_LINUX 1
+#else
+#  define PRF_LINUX 0
+#endif
+
+
+//**************************************
+// Local Parameters
+//**************************************
+static const char* const names[PRF_nbCounters] = { "cycles", "instructions", "branch-misses", "L1D-misses", "LLC-misses" };
+
+const char* PRF_name(PRF_counter counter) { return names[counter]; }
+
+
+#if PRF_LINUX
+
+static int fds[PRF_nbCounters] = { -1, -1, -1, -1, -1 };
+
+typedef struct
+{
+    unsigned long long value;
+    unsigned long long timeEnabled;
+    unsigned long long timeRunning;
+} PRF_reading_t;
+
+static PRF_reading_t startReadings[PRF_nbCounters];
+
+static int PRF_openCounter(PRF_counter counter)
+{
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.disabled = 0;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    switch(counter)
+    {
+    case PRF_cycles:       attr.type = PERF_TYPE_HARDWARE; attr.config = PERF_COUNT_HW_CPU_CYCLES; break;
+    case PRF_instructions: attr.type = PERF_TYPE_HARDWARE; attr.config = PERF_COUNT_HW_INSTRUCTIONS; break;
+    case PRF_branchMisses: attr.type = PERF_TYPE_HARDWARE; attr.config = PERF_COUNT_HW_BRANCH_MISSES; break;
+    case PRF_L1DMisses:    attr.type = PERF_TYPE_HW_CACHE;
+                           attr.config = PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16); break;
+    case PRF_LLCMisses:    attr.type = PERF_TYPE_HARDWARE; attr.config = PERF_COUNT_HW_CACHE_MISSES; break;
+    default: return -1;
+    }
+    return (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);   // calling thread, any CPU
+}
+
+int PRF_open(void)
+{
+    int i, nb = 0;
+    for (i=0; i<PRF_nbCounters; i++)
+    {
+        if (fds[i] < 0) fds[i] = PRF_openCounter((PRF_counter)i);
+        nb += (fds[i] >= 0);
+    }
+    return nb;
+}
+
+void PRF_close(void)
+{
+    int i;
+    for (i=0; i<PRF_nbCounters; i++) if (fds[i] >= 0) { close(fds[i]); fds[i] = -1; }
+}
+
+int PRF_available(PRF_counter counter) { return fds[counter] >= 0; }
+
+static void PRF_read(int i, PRF_reading_t* reading)
+{
+    if (read(fds[i], reading, sizeof(*reading)) != (ssize_t)sizeof(*reading)) memset(reading, 0, sizeof(*reading));
+}
+
+void PRF_start(void)
+{
+    int i;
+    for (i=0; i<PRF_nbCounters; i++) if (fds[i] >= 0) PRF_read(i, startReadings+i);
+}
+
+void PRF_stop(PRF_counts_t* counts)
+{
+    int i;
+    for (i=0; i<PRF_nbCounters; i++)
+    {
+        PRF_reading_t end;
+        double value;
+        if (fds[i] < 0) continue;
+        PRF_read(i, &end);
+        value = (double)(end.value - startReadings[i].value);
+        if ((end.timeRunning > startReadings[i].timeRunning) && (end.timeRunning - startReadings[i].timeRunning < end.timeEnabled - startReadings[i].timeEnabled))
+            value *= (double)(end.timeEnabled - startReadings[i].timeEnabled) / (double)(end.timeRunning - startReadings[i].timeRunning);   // multiplexed
+        counts->value[i] += (unsigned long long)value;
+    }
+}
+
+#else
+
+int  PRF_open(void) { return 0; }
+void PRF_close(void) {}
+int  PRF_available(PRF_counter counter) { (void)counter; return 0; }
+void PRF_start(void) {}
+void PRF_stop(PRF_counts_t* counts) { (void)counts; }
+
+#endif   // PRF_LINUX
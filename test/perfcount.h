@@ -0,0 +1,59 @@
+/*
+  perfcount.h - hardware performance counters - header
+  Copyright (C) Yann Collet 2013-2014
+  GPL v2 License
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License along
+  with this program; if not, write to the Free Software Foundation, Inc.,
+  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+  You can contact the author at :
+  - Public forum : https://groups.google.com/forum/#!forum/lz4c
+*/
+#pragma once
+
+#if defined (__cplusplus)
+extern "C" {
+#endif
+
+
+//**************************************
+// Counters
+//**************************************
+typedef enum { PRF_cycles, PRF_instructions, PRF_branchMisses, PRF_L1DMisses, PRF_LLCMisses, PRF_nbCounters } PRF_counter;
+
+typedef struct
+{
+    unsigned long long value[PRF_nbCounters];
+} PRF_counts_t;
+
+int  PRF_open(void);
+void PRF_close(void);
+int  PRF_available(PRF_counter counter);
+const char* PRF_name(PRF_counter counter);
+void PRF_start(void);
+void PRF_stop(PRF_counts_t* counts);
+/*
+Counters measure calling thread only, in user mode (Linux perf_event_open()).
+PRF_open():
+    Opens all counters supported by the system. Each one is independent : some may be missing
+    (virtual machines, perf_event_paranoid, other OS), others are still counted.
+    return : nb of available counters (0 : none, counting functions then do nothing)
+PRF_stop():
+    Adds counts since PRF_start() into 'counts'. Values are scaled when the kernel multiplexes counters.
+*/
+
+
+#if defined (__cplusplus)
+}
+#endif
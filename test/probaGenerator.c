@@ -29,18 +29,49 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 //******************************
 // Include
 //******************************
-#include <stdlib.h>   // malloc
-#include <stdio.h>    // printf
-#include <string.h>   // memset
-#include <math.h>     // log
+#include <stdlib.h>   // malloc, strtod
+#include <stdio.h>    // fprintf, fwrite
+#include <string.h>   // strcmp
+#include <math.h>     // log, pow
+
+#if defined(MSDOS) || defined(OS2) || defined(WIN32) || defined(_WIN32) || defined(__CYGWIN__)
+#  include <fcntl.h>    // _O_BINARY
+#  include <io.h>       // _setmode, _isatty
+#  define SET_BINARY_MODE(file) _setmode(_fileno(file), _O_BINARY)
+#else
+#  define SET_BINARY_MODE(file)
+#endif
+
+
+//******************************
+// Basic Types
+//******************************
+#if defined (__STDC_VERSION__) && __STDC_VERSION__ >= 199901L   // C99
+# include <stdint.h>
+typedef uint8_t  BYTE;
+typedef uint16_t U16;
+typedef uint32_t U32;
+typedef uint64_t U64;
+#else
+typedef unsigned char       BYTE;
+typedef unsigned short      U16;
+typedef unsigned int        U32;
+typedef unsigned long long  U64;
+#endif
 
 
 //******************************
 // Constants
 //******************************
-#define MB *(1<<20)
-#define BUFFERSIZE ((1 MB) - 1)
-#define PROBATABLESIZE 4096
+#define KB *(1U<<10)
+#define MB *(1U<<20)
+#define BUFFERSIZE (1 MB)
+#define DEFAULT_SIZE ((1 MB) - 1)
+#define PROBATABLELOG 12                     // byte distributions
+#define PROBATABLESIZE (1<<PROBATABLELOG)
+#define WIDETABLELOG 16                      // sparse U16/U32 alphabets
+#define MAX_ALPHABET 4096
+#define DEFAULT_SEGMENT (64 KB)
 
 
 //**************************************
@@ -55,6 +86,19 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 //***************************************************
 static char* programName;
 static int   displayLevel = 2;   // 0 : no display  // 1: errors  // 2 : + result + interaction + warnings ;  // 3 : + progression;  // 4 : + information
+static const char stdoutmark[] = "stdout";
+
+typedef enum { pg_geometric, pg_zipf, pg_markov, pg_piecewise, pg_u16, pg_u32 } distribution_t;
+
+typedef struct
+{
+    distribution_t distribution;
+    double p;              // geometric
+    double exponent;       // zipf, markov, u16, u32
+    int    alphabetSize;   // u16, u32
+    U64    segmentSize;    // piecewise
+    U64    seed;
+} params_t;
 
 
 //******************************
@@ -63,9 +107,21 @@ static int   displayLevel = 2;   // 0 : no display  // 1: errors  // 2 : + resul
 static int usage()
 {
     DISPLAY("Usage :\n");
-    DISPLAY("%s P%%\n", programName);
+    DISPLAY("%s [arg] [P%%]\n", programName);
+    DISPLAY("Arguments :\n");
+    DISPLAY(" P%%             : geometric distribution, each symbol having probability P of remaining ones (default)\n");
+    DISPLAY(" --zipf=S       : Zipf distribution of 256 symbols, exponent S (ex : 1.2)\n");
+    DISPLAY(" --markov=S     : Markov chain of order 1 : after each symbol, a Zipf distribution of exponent S over its own permutation\n");
+    DISPLAY(" --piecewise=#  : statistics change every # bytes (K, M, G suffixes ; default : 64K)\n");
+    DISPLAY(" --u16=N[,S]    : 2-bytes values, N distinct ones spread over whole range, with Zipf frequencies (default S : 1.0)\n");
+    DISPLAY(" --u32=N[,S]    : same, with 4-bytes values\n");
+    DISPLAY(" --seed=#       : same seed, same output (default : 0)\n");
+    DISPLAY(" -s#            : output size, in bytes (K, M, G suffixes ; default : 1 MB - 1)\n");
+    DISPLAY(" -o file        : output file (default : proba.bin ; %s : standard output)\n", stdoutmark);
+    DISPLAY(" -p             : pause at the end\n");
     DISPLAY("Exemple :\n");
     DISPLAY("%s 70%%\n", programName);
+    DISPLAY("%s --zipf=1.1 -s4G --seed=3 -o zipf.bin\n", programName);
     return 0;
 }
 
@@ -73,72 +129,372 @@ static int badusage()
 {
     DISPLAYLEVEL(1, "Incorrect parameters\n");
     if (displayLevel >= 1) usage();
-    DISPLAY("Press enter to exit \n");
-    getchar();
     exit(1);
 }
 
-static void generate(void* buffer, size_t buffSize, double p)
+static U64 readSize(const char** s)
 {
-    char table[PROBATABLESIZE];
-    int remaining = PROBATABLESIZE;
-    int pos = 0;
-    int s = 0;
-    char* op = (char*) buffer;
-    char* oend = op + buffSize;
+    U64 result = 0;
+    if ((**s<'0') || (**s>'9')) badusage();
+    while ((**s>='0') && (**s<='9')) result = result*10 + (unsigned)(*(*s)++ - '0');
+    switch (**s)
+    {
+    case 'G': case 'g': result <<= 10;   // fall-through
+    case 'M': case 'm': result <<= 10;   // fall-through
+    case 'K': case 'k': result <<= 10; (*s)++; break;
+    default: break;
+    }
+    return result;
+}
 
-    DISPLAY("\nGenerating %i MB with P=%.2f%%\n", (int)(buffSize >> 20), p*100);
+static double readDouble(const char** s)
+{
+    char* end;
+    const double result = strtod(*s, &end);
+    if (end == *s) badusage();
+    *s = end;
+    return result;
+}
 
-    // Build Table
-    while (remaining)
+
+//******************************
+// Random
+//******************************
+// 64-bits LCG : deterministic on all platforms, unlike rand()
+static U32 PG_rand(U64* state)
+{
+    *state = (*state * 6364136223846793005ULL) + 1442695040888963407ULL;
+    return (U32)(*state >> 32);
+}
+
+// within [0,1[
+static double PG_randUnit(U64* state) { return (double)PG_rand(state) / 4294967296.; }
+
+static void PG_permutation(BYTE* perm, U64* state)
+{
+    int i;
+    for (i=0; i<256; i++) perm[i] = (BYTE)i;
+    for (i=255; i>0; i--)
     {
-        int n = (int)(remaining * p);
+        const int j = (int)(PG_rand(state) % (U32)(i+1));
+        const BYTE tmp = perm[i]; perm[i] = perm[j]; perm[j] = tmp;
+    }
+}
+
+
+//******************************
+// Distributions
+//******************************
+static void PG_geometric(double* proba, double p)
+{
+    double remaining = 1.;
+    int s;
+    if (p <= 0.) { for (s=0; s<256; s++) proba[s] = 1./256; return; }
+    for (s=0; s<255; s++) { proba[s] = remaining * p; remaining -= proba[s]; }
+    proba[255] = remaining;
+}
+
+static void PG_zipf(double* proba, int nbSymbols, double exponent)
+{
+    double total = 0.;
+    int s;
+    for (s=0; s<nbSymbols; s++) total += proba[s] = 1. / pow((double)(s+1), exponent);
+    for (s=0; s<nbSymbols; s++) proba[s] /= total;
+}
+
+/*
+Sampling table : each symbol occupies a number of cells proportional to its probability,
+so that a uniform random index selects it with this probability.
+A symbol whose share rounds to zero cells is never generated : as in the original generator,
+the series stops there instead of spreading a tail over the whole alphabet.
+return : entropy of the table, in bits per symbol (values are expected distinct)
+*/
+static double PG_buildTable(void* table, int tableLog, int width, const double* proba, const U32* values, int nbSymbols)
+{
+    const int tableSize = 1 << tableLog;
+    double cumul = 0., entropy = 0.;
+    int pos = 0, s;
+    for (s=0; (s<nbSymbols) && (pos<tableSize); s++)
+    {
+        const U32 value = values ? values[s] : (U32)s;
         int end;
-        if (!n) n=1;
-        end = pos + n;
-        while (pos<end) table[pos++]=(char)s;
-        s++;
-        remaining -= n;
+        cumul += proba[s];
+        end = (int)(cumul * tableSize + 0.5);
+        if ((end > tableSize) || (s == nbSymbols-1)) end = tableSize;
+        if (end <= pos) continue;
+        entropy -= (double)(end-pos) / tableSize * log((double)(end-pos) / tableSize) / log(2.);
+        if (width==1) while (pos<end) ((BYTE*)table)[pos++] = (BYTE)value;
+        else while (pos<end) ((U32*)table)[pos++] = value;
     }
+    return entropy;
+}
+
 
-    // Fill buffer
-    while (op<oend)
+//******************************
+// Generator
+//******************************
+typedef struct
+{
+    params_t params;
+    U64    rand;
+    U64    pos;                         // in bytes, since beginning of output
+    BYTE   prev;                        // markov
+    BYTE*  byteTables;                  // geometric, zipf, piecewise : 1 table ; markov : 256 tables
+    U32*   wideTable;                   // u16, u32
+    double entropy;                     // bits per symbol, 0 if unknown
+} generator_t;
+
+static void PG_newSegment(generator_t* g)
+{
+    // Random alphabet size, exponent and symbol order : another source, as when a file contains several kinds of data
+    double proba[256];
+    U32 values[256];
+    BYTE perm[256];
+    const int nbSymbols = 2 + (int)(PG_rand(&g->rand) % 255);
+    const double exponent = 0.5 + 1.5 * PG_randUnit(&g->rand);
+    int s;
+    PG_permutation(perm, &g->rand);
+    for (s=0; s<nbSymbols; s++) values[s] = perm[s];
+    PG_zipf(proba, nbSymbols, exponent);
+    PG_buildTable(g->byteTables, PROBATABLELOG, 1, proba, values, nbSymbols);
+    DISPLAYLEVEL(4, "segment at %llu : %i symbols, exponent %.2f \n", (unsigned long long)g->pos, nbSymbols, exponent);
+}
+
+static int PG_init(generator_t* g, const params_t* params)
+{
+    double proba[MAX_ALPHABET];
+    memset(g, 0, sizeof(*g));
+    g->params = *params;
+    g->rand = params->seed ^ 0x9E3779B97F4A7C15ULL;
+    PG_rand(&g->rand);
+
+    switch (params->distribution)
     {
-        const int r = rand() & (PROBATABLESIZE-1);
-        *op++ = table[r];
+    case pg_geometric:
+    case pg_zipf:
+        g->byteTables = (BYTE*)malloc(PROBATABLESIZE);
+        if (g->byteTables==NULL) return -1;
+        if (params->distribution==pg_geometric) PG_geometric(proba, params->p);
+        else PG_zipf(proba, 256, params->exponent);
+        g->entropy = PG_buildTable(g->byteTables, PROBATABLELOG, 1, proba, NULL, 256);
+        break;
+
+    case pg_markov:
+        {
+            BYTE perm[256];
+            U32 values[256];
+            int c, s;
+            g->byteTables = (BYTE*)malloc(256 * PROBATABLESIZE);
+            if (g->byteTables==NULL) return -1;
+            PG_zipf(proba, 256, params->exponent);
+            for (c=0; c<256; c++)
+            {
+                PG_permutation(perm, &g->rand);
+                for (s=0; s<256; s++) values[s] = perm[s];
+                g->entropy = PG_buildTable(g->byteTables + c*PROBATABLESIZE, PROBATABLELOG, 1, proba, values, 256);
+            }
+            // conditional entropy : same table, permuted, after each symbol
+            break;
+        }
+
+    case pg_piecewise:
+        g->byteTables = (BYTE*)malloc(PROBATABLESIZE);
+        if (g->byteTables==NULL) return -1;
+        PG_newSegment(g);
+        break;
+
+    case pg_u16:
+    case pg_u32:
+        {
+            const U32 mask = (params->distribution==pg_u16) ? 0xFFFF : 0xFFFFFFFF;
+            U32 values[MAX_ALPHABET];
+            int s, i;
+            g->wideTable = (U32*)malloc(sizeof(U32) << WIDETABLELOG);
+            if (g->wideTable==NULL) return -1;
+            for (s=0; s<params->alphabetSize; s++)
+            {
+                // distinct values ; ranks are not ordered by value
+                do { values[s] = PG_rand(&g->rand) & mask; for (i=0; (i<s) && (values[i]!=values[s]); i++) {} } while (i<s);
+            }
+            PG_zipf(proba, params->alphabetSize, params->exponent);
+            g->entropy = PG_buildTable(g->wideTable, WIDETABLELOG, 4, proba, values, params->alphabetSize);
+            break;
+        }
     }
+    return 0;
 }
 
+static void PG_free(generator_t* g)
+{
+    free(g->byteTables);
+    free(g->wideTable);
+}
 
-void createSampleFile(char* filename, double p)
+// 'size' must be a multiple of symbol size
+static void PG_generate(generator_t* g, void* buffer, size_t size)
 {
-    FILE* foutput = fopen( filename, "wb" );
-    void* buffer = malloc(BUFFERSIZE);
-    generate(buffer, BUFFERSIZE, p);
-    fwrite(buffer, 1, BUFFERSIZE, foutput);
-    fclose(foutput);
-    DISPLAY("File %s generated\n", filename);
+    BYTE* op = (BYTE*)buffer;
+    BYTE* const oend = op + size;
+
+    switch (g->params.distribution)
+    {
+    case pg_geometric:
+    case pg_zipf:
+        while (op<oend) *op++ = g->byteTables[PG_rand(&g->rand) >> (32-PROBATABLELOG)];
+        break;
+
+    case pg_markov:
+        {
+            BYTE prev = g->prev;
+            while (op<oend) *op++ = prev = g->byteTables[(prev << PROBATABLELOG) + (PG_rand(&g->rand) >> (32-PROBATABLELOG))];
+            g->prev = prev;
+            break;
+        }
+
+    case pg_piecewise:
+        while (op<oend)
+        {
+            const U64 segmentSize = g->params.segmentSize;
+            const U64 segmentEnd = (g->pos / segmentSize + 1) * segmentSize;
+            BYTE* const end = ((U64)(oend-op) > segmentEnd - g->pos) ? op + (segmentEnd - g->pos) : oend;
+            g->pos += end-op;
+            while (op<end) *op++ = g->byteTables[PG_rand(&g->rand) >> (32-PROBATABLELOG)];
+            if (g->pos == segmentEnd) PG_newSegment(g);
+        }
+        return;
+
+    case pg_u16:
+        while (op<oend)
+        {
+            const U32 value = g->wideTable[PG_rand(&g->rand) >> (32-WIDETABLELOG)];
+            op[0] = (BYTE)value; op[1] = (BYTE)(value>>8);   // little endian
+            op += 2;
+        }
+        break;
+
+    case pg_u32:
+        while (op<oend)
+        {
+            const U32 value = g->wideTable[PG_rand(&g->rand) >> (32-WIDETABLELOG)];
+            op[0] = (BYTE)value; op[1] = (BYTE)(value>>8); op[2] = (BYTE)(value>>16); op[3] = (BYTE)(value>>24);
+            op += 4;
+        }
+        break;
+    }
+    g->pos += size;
 }
 
 
-int main(int argc, char** argv) 
+static const char* PG_describe(char* buffer, const params_t* params)
 {
-    char* n;
-    double proba = 0.;
-    char  filename[] = "proba.bin";
+    switch (params->distribution)
+    {
+    case pg_geometric: sprintf(buffer, "P=%.2f%%", params->p*100); break;
+    case pg_zipf:      sprintf(buffer, "Zipf, exponent %.2f", params->exponent); break;
+    case pg_markov:    sprintf(buffer, "Markov order 1, Zipf exponent %.2f", params->exponent); break;
+    case pg_piecewise: sprintf(buffer, "piecewise-stationary, segments of %llu bytes", (unsigned long long)params->segmentSize); break;
+    case pg_u16:       sprintf(buffer, "U16, %i values, Zipf exponent %.2f", params->alphabetSize, params->exponent); break;
+    case pg_u32:       sprintf(buffer, "U32, %i values, Zipf exponent %.2f", params->alphabetSize, params->exponent); break;
+    }
+    return buffer;
+}
 
-    programName = argv[0];
-    printf("Binary file generator\n");
-    if (argc<2) badusage();
 
-    n = argv[1];
-    if ((*n>='0') && (*n<='9')) { proba += *n-'0'; n++; }
-    if ((*n>='0') && (*n<='9')) { proba*=10; proba += *n-'0'; n++; }
-    proba /= 100;
+/*
+Output is produced by blocks of BUFFERSIZE, hence any size can be generated with little memory.
+For a given seed, output does not depend on block size : a shorter file is a prefix of a longer one.
+*/
+int createSampleFile(const char* filename, const params_t* params, U64 size)
+{
+    const int symbolSize = (params->distribution==pg_u16) ? 2 : (params->distribution==pg_u32) ? 4 : 1;
+    const int isStdout = !strcmp(filename, stdoutmark);
+    generator_t g;
+    FILE* foutput;
+    void* buffer;
+    U64 remaining;
+    char description[100];
 
-    createSampleFile(filename, proba);
+    size -= size % symbolSize;
+    remaining = size;
+    if (isStdout) { foutput = stdout; SET_BINARY_MODE(stdout); }
+    else foutput = fopen( filename, "wb" );
+    if (foutput==NULL) { DISPLAYLEVEL(1, "Pb opening %s\n", filename); return 1; }
+    buffer = malloc(BUFFERSIZE);
+    if ((buffer==NULL) || PG_init(&g, params)) { DISPLAYLEVEL(1, "Allocation error : not enough memory\n"); return 1; }
 
-    DISPLAY("Press enter to exit \n");
-    getchar();
+    DISPLAYLEVEL(2, "Generating %llu bytes, %s, seed %llu\n", (unsigned long long)size, PG_describe(description, params), (unsigned long long)params->seed);
+    if (g.entropy > 0.) DISPLAYLEVEL(2, "Entropy : %.4f bits per symbol (%.2f%% of %i bits)\n", g.entropy, g.entropy / (symbolSize*8) * 100, symbolSize*8);
+    while (remaining)
+    {
+        const size_t blockSize = (remaining < BUFFERSIZE) ? (size_t)remaining : BUFFERSIZE;
+        PG_generate(&g, buffer, blockSize);
+        if (fwrite(buffer, 1, blockSize, foutput) != blockSize) { DISPLAYLEVEL(1, "Write error : cannot write %s\n", filename); return 1; }
+        remaining -= blockSize;
+        if (((size-remaining) % (64 MB)) == 0) DISPLAYLEVEL(3, "\r%llu MB   ", (unsigned long long)((size-remaining)>>20));
+    }
+    DISPLAYLEVEL(3, "\r%79s\r", "");
+
+    PG_free(&g);
+    free(buffer);
+    if (!isStdout) fclose(foutput);
+    DISPLAYLEVEL(2, "File %s generated\n", filename);
     return 0;
-}
\ No newline at end of file
+}
+
+
+int main(int argc, char** argv)
+{
+    params_t params;
+    U64 size = DEFAULT_SIZE;
+    const char* filename = "proba.bin";
+    int i, result, pause = 0;
+
+    programName = argv[0];
+    memset(&params, 0, sizeof(params));
+    params.distribution = pg_geometric;
+    params.exponent = 1.;
+    params.segmentSize = DEFAULT_SEGMENT;
+
+    for (i=1; i<argc; i++)
+    {
+        const char* argument = argv[i];
+
+        if (!strncmp(argument, "--zipf=", 7))      { argument += 7; params.distribution = pg_zipf; params.exponent = readDouble(&argument); continue; }
+        if (!strncmp(argument, "--markov=", 9))    { argument += 9; params.distribution = pg_markov; params.exponent = readDouble(&argument); continue; }
+        if (!strncmp(argument, "--piecewise=", 12)) { argument += 12; params.distribution = pg_piecewise; params.segmentSize = readSize(&argument); if (!params.segmentSize) badusage(); continue; }
+        if (!strncmp(argument, "--seed=", 7))      { argument += 7; params.seed = readSize(&argument); continue; }
+        if (!strncmp(argument, "--u16=", 6) || !strncmp(argument, "--u32=", 6))
+        {
+            params.distribution = (argument[3]=='1') ? pg_u16 : pg_u32;
+            argument += 6;
+            params.alphabetSize = (int)readSize(&argument);
+            if ((params.alphabetSize < 1) || (params.alphabetSize > MAX_ALPHABET)) { DISPLAYLEVEL(1, "Nb of values must be within [1-%i]\n", MAX_ALPHABET); exit(1); }
+            if (*argument==',') { argument++; params.exponent = readDouble(&argument); }
+            continue;
+        }
+        if (!strcmp(argument, "-o"))  { if (i+1 >= argc) badusage(); filename = argv[++i]; continue; }
+        if (!strcmp(argument, "-p"))  { pause = 1; continue; }
+        if (!strcmp(argument, "-h"))  { usage(); return 0; }
+        if (!strncmp(argument, "-s", 2)) { argument += 2; size = readSize(&argument); continue; }
+
+        // Legacy : P%
+        if ((*argument>='0') && (*argument<='9'))
+        {
+            double proba = 0.;
+            const char* n = argument;
+            if ((*n>='0') && (*n<='9')) { proba += *n-'0'; n++; }
+            if ((*n>='0') && (*n<='9')) { proba*=10; proba += *n-'0'; n++; }
+            params.distribution = pg_geometric;
+            params.p = proba / 100;
+            continue;
+        }
+        badusage();
+    }
+    if (argc<2) badusage();
+
+    DISPLAYLEVEL(2, "Binary file generator\n");
+    result = createSampleFile(filename, &params, size);
+
+    if (pause) { DISPLAY("Press enter to exit \n"); getchar(); }
+    return result;
+}
@@ -0,0 +1,380 @@
+/*
+  report.c - machine-readable benchmark results, and comparison, for FSE
+  Copyright (C) Yann Collet 2013-2014
+  GPL v2 License
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License along
+  with this program; if not, write to the Free Software Foundation, Inc.,
+  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+  You can contact the author at :
+  - Public forum : https://groups.google.com/forum/#!forum/lz4c
+*/
+/*
+  Note : this is stand-alone program.
+  It is not part of FSE compression library, it is a user program of the FSE library.
+  The license of FSE library is BSD.
+  The license of this program is GPLv2.
+*/
+
+
+//**************************************
+// Compiler Options
+//**************************************
+#define _CRT_SECURE_NO_WARNINGS   // fopen (Visual)
+
+
+//**************************************
+// Includes
+//**************************************
+#include <stdlib.h>   // malloc, realloc, strtod
+#include <stdio.h>    // fprintf, fopen
+#include <string.h>   // strlen, strcmp, memcpy
+#include <math.h>     // sqrt
+#include "report.h"
+
+
+//**************************************
+// Constants
+//**************************************
+#define REP_MIN_LOSS  0.02   // smaller slowdowns are not reported, even when significant
+#define REP_NOISE     0.05   // threshold when variance cannot be estimated
+
+
+//**************************************
+// Macros
+//**************************************
+#define DISPLAY(...) fprintf(stderr, __VA_ARGS__)
+
+
+//**************************************
+// Local Parameters
+//**************************************
+static REP_format format = REP_none;
+static REP_result_t* results = NULL;
+static int nbResults = 0;
+static int capacity = 0;
+static REP_result_t* baseline = NULL;
+static int nbBaseline = 0;
+
+void REP_setFormat(REP_format newFormat) { format = newFormat; }
+
+
+//**************************************
+// Storage
+//**************************************
+static char* REP_strdup(const char* s, size_t length)
+{
+    char* copy = (char*)malloc(length+1);
+    if (copy==NULL) return NULL;
+    memcpy(copy, s, length);
+    copy[length] = 0;
+    return copy;
+}
+
+// return : 0, or -1 if allocation fails
+static int REP_append(REP_result_t** table, int* nb, int* tableCapacity, const REP_result_t* result)
+{
+    REP_result_t* entry;
+    if (*nb == *tableCapacity)
+    {
+        int newCapacity = *tableCapacity ? *tableCapacity * 2 : 16;
+        REP_result_t* newTable = (REP_result_t*)realloc(*table, newCapacity * sizeof(REP_result_t));
+        if (newTable==NULL) return -1;
+        *table = newTable;
+        *tableCapacity = newCapacity;
+    }
+    entry = *table + *nb;
+    *entry = *result;
+    entry->fileName = REP_strdup(result->fileName, strlen(result->fileName));
+    entry->codec = REP_strdup(result->codec, strlen(result->codec));
+    if ((entry->fileName==NULL) || (entry->codec==NULL)) { free((void*)entry->fileName); free((void*)entry->codec); return -1; }
+    (*nb)++;
+    return 0;
+}
+
+static void REP_freeTable(REP_result_t** table, int* nb)
+{
+    int i;
+    for (i=0; i<*nb; i++) { free((void*)(*table)[i].fileName); free((void*)(*table)[i].codec); }
+    free(*table);
+    *table = NULL;
+    *nb = 0;
+}
+
+void REP_add(const REP_result_t* result)
+{
+    if ((format==REP_none) && (baseline==NULL)) return;
+    if (REP_append(&results, &nbResults, &capacity, result)) DISPLAY("Warning : not enough memory to store results\n");
+}
+
+
+//**************************************
+// Output
+//**************************************
+static void REP_writeJsonString(const char* s)
+{
+    printf("\"");
+    for ( ; *s; s++)
+    {
+        if ((*s=='"') || (*s=='\\')) printf("\\%c", *s);
+        else if ((unsigned char)*s < 0x20) printf("\\u%04x", (unsigned char)*s);
+        else putchar(*s);
+    }
+    printf("\"");
+}
+
+static void REP_writeSamples(const double* samples, int nb, const char* separator)
+{
+    int i;
+    for (i=0; i<nb; i++) printf("%s%.2f", i ? separator : "", samples[i]);
+}
+
+static double REP_ratio(const REP_result_t* r) { return r->srcSize ? (double)r->cSize / (double)r->srcSize * 100. : 0.; }
+
+static void REP_writeJson(void)
+{
+    int i;
+    printf("[\n");
+    for (i=0; i<nbResults; i++)
+    {
+        const REP_result_t* const r = results + i;
+        printf("{\"file\":"); REP_writeJsonString(r->fileName);
+        printf(",\"codec\":"); REP_writeJsonString(r->codec);
+        printf(",\"blockSize\":%i,\"tableLog\":%i,\"srcSize\":%llu,\"cSize\":%llu,\"ratio\":%.4f,\"cSpeed\":%.2f,\"dSpeed\":%.2f",
+               r->blockSize, r->tableLog, r->srcSize, r->cSize, REP_ratio(r), r->cSpeed, r->dSpeed);
+        printf(",\"cSamples\":["); REP_writeSamples(r->cSamples, r->nbCSamples, ",");
+        printf("],\"dSamples\":["); REP_writeSamples(r->dSamples, r->nbDSamples, ",");
+        printf("]}%s\n", (i+1<nbResults) ? "," : "");
+    }
+    printf("]\n");
+}
+
+static void REP_writeCsv(void)
+{
+    int i;
+    printf("file,codec,blockSize,tableLog,srcSize,cSize,ratio,cSpeed,dSpeed,cSamples,dSamples\n");
+    for (i=0; i<nbResults; i++)
+    {
+        const REP_result_t* const r = results + i;
+        const char* c;
+        printf("\"");
+        for (c=r->fileName; *c; c++) { if (*c=='"') putchar('"'); putchar(*c); }
+        printf("\",%s,%i,%i,%llu,%llu,%.4f,%.2f,%.2f,", r->codec, r->blockSize, r->tableLog, r->srcSize, r->cSize, REP_ratio(r), r->cSpeed, r->dSpeed);
+        REP_writeSamples(r->cSamples, r->nbCSamples, ";");
+        printf(",");
+        REP_writeSamples(r->dSamples, r->nbDSamples, ";");
+        printf("\n");
+    }
+}
+
+
+//**************************************
+// Baseline
+//**************************************
+/*
+Reads files written by REP_writeJson() (one object per line).
+Unknown keys are ignored, so files edited by hand or by other tools remain readable if they keep this layout.
+*/
+
+// return : position just after "key": within object [p, end[, or NULL
+static const char* REP_findKey(const char* p, const char* end, const char* key)
+{
+    const size_t length = strlen(key);
+    for ( ; p + length + 3 <= end; p++)
+        if ((p[0]=='"') && !memcmp(p+1, key, length) && (p[length+1]=='"') && (p[length+2]==':')) return p + length + 3;
+    return NULL;
+}
+
+// return : length of decoded string, written into 'dst' (size 'dstSize'), or -1
+static int REP_readString(char* dst, size_t dstSize, const char* p, const char* end)
+{
+    size_t length = 0;
+    if ((p==NULL) || (*p++!='"')) return -1;
+    while ((p<end) && (*p!='"'))
+    {
+        char c = *p++;
+        if ((c=='\\') && (p<end))
+        {
+            c = *p++;
+            if ((c=='u') && (p+4<=end)) { char hex[5]; memcpy(hex, p, 4); hex[4]=0; c = (char)strtol(hex, NULL, 16); p += 4; }
+        }
+        if (length+1 < dstSize) dst[length++] = c;
+    }
+    dst[length] = 0;
+    return (p<end) ? (int)length : -1;
+}
+
+static double REP_readNumber(const char* p) { return p ? strtod(p, NULL) : 0.; }
+
+static int REP_readArray(double* samples, const char* p, const char* end)
+{
+    int nb = 0;
+    if ((p==NULL) || (*p++!='[')) return 0;
+    while ((p<end) && (*p!=']') && (nb<REP_MAX_SAMPLES))
+    {
+        char* next;
+        samples[nb] = strtod(p, &next);
+        if (next==p) break;
+        nb++;
+        p = next;
+        if (*p==',') p++;
+    }
+    return nb;
+}
+
+int REP_setBaseline(const char* fileName)
+{
+    FILE* f = fopen(fileName, "rb");
+    char* content;
+    long size;
+    int baselineCapacity = 0;
+    const char* p;
+    if (f==NULL) return -1;
+    fseek(f, 0, SEEK_END);
+    size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    content = (char*)malloc(size+1);
+    if ((content==NULL) || (fread(content, 1, size, f) != (size_t)size)) { free(content); fclose(f); return -1; }
+    fclose(f);
+    content[size] = 0;
+
+    REP_freeTable(&baseline, &nbBaseline);
+    for (p=strchr(content, '{'); p!=NULL; p=strchr(p, '{'))
+    {
+        const char* const end = strchr(p, '\n') ? strchr(p, '\n') : content + size;
+        char name[1024], codec[64];
+        REP_result_t r;
+        if ((REP_readString(name, sizeof(name), REP_findKey(p, end, "file"), end) >= 0)
+         && (REP_readString(codec, sizeof(codec), REP_findKey(p, end, "codec"), end) >= 0))
+        {
+            r.fileName = name;
+            r.codec = codec;
+            r.blockSize  = (int)REP_readNumber(REP_findKey(p, end, "blockSize"));
+            r.tableLog   = (int)REP_readNumber(REP_findKey(p, end, "tableLog"));
+            r.srcSize    = (unsigned long long)REP_readNumber(REP_findKey(p, end, "srcSize"));
+            r.cSize      = (unsigned long long)REP_readNumber(REP_findKey(p, end, "cSize"));
+            r.cSpeed     = REP_readNumber(REP_findKey(p, end, "cSpeed"));
+            r.dSpeed     = REP_readNumber(REP_findKey(p, end, "dSpeed"));
+            r.nbCSamples = REP_readArray(r.cSamples, REP_findKey(p, end, "cSamples"), end);
+            r.nbDSamples = REP_readArray(r.dSamples, REP_findKey(p, end, "dSamples"), end);
+            if (REP_append(&baseline, &nbBaseline, &baselineCapacity, &r)) break;
+        }
+        p = end;
+    }
+    free(content);
+    if (baseline==NULL) baseline = (REP_result_t*)malloc(sizeof(REP_result_t));   // empty, but set
+    return 0;
+}
+
+
+//**************************************
+// Comparison
+//**************************************
+// One-sided Student t critical values, at 1%, for 1 to 10 degrees of freedom
+static const double REP_tTable[11] = { 0., 31.82, 6.965, 4.541, 3.747, 3.365, 3.143, 2.998, 2.896, 2.821, 2.764 };
+
+static double REP_tCritical(double df)
+{
+    if (df < 1.) df = 1.;
+    if (df <= 10.) return REP_tTable[(int)df];   // rounded down : conservative
+    if (df <= 20.) return 2.528 + (20.-df) * (2.764-2.528) / 10.;
+    if (df <= 30.) return 2.457 + (30.-df) * (2.528-2.457) / 10.;
+    return 2.326;
+}
+
+static void REP_meanVar(const double* samples, int nb, double* mean, double* var)
+{
+    int i;
+    double sum = 0., sq = 0.;
+    for (i=0; i<nb; i++) sum += samples[i];
+    *mean = sum / nb;
+    for (i=0; i<nb; i++) sq += (samples[i] - *mean) * (samples[i] - *mean);
+    *var = (nb > 1) ? sq / (nb-1) : 0.;
+}
+
+/*
+return : 1 if 'current' samples are significantly slower than 'base' ones.
+         'loss' receives relative slowdown of means (negative for a speedup), 't' the Welch statistic (0 if not computed)
+*/
+static int REP_isSlower(const double* base, int nbBase, const double* current, int nbCurrent, double* loss, double* t)
+{
+    double meanB, varB, meanC, varC, se2;
+    REP_meanVar(base, nbBase, &meanB, &varB);
+    REP_meanVar(current, nbCurrent, &meanC, &varC);
+    *loss = (meanB > 0.) ? (meanB - meanC) / meanB : 0.;
+    *t = 0.;
+    if ((nbBase < 2) || (nbCurrent < 2)) return *loss > REP_NOISE;
+    if (*loss <= REP_MIN_LOSS) return 0;
+    se2 = varB/nbBase + varC/nbCurrent;
+    if (se2 <= 0.) return 1;   // no variance at all : difference is real
+    *t = (meanB - meanC) / sqrt(se2);
+    {
+        // Welch-Satterthwaite degrees of freedom
+        const double a = varB/nbBase, b = varC/nbCurrent;
+        const double df = se2*se2 / (a*a/(nbBase-1) + b*b/(nbCurrent-1));
+        return *t > REP_tCritical(df);
+    }
+}
+
+static int REP_compare(void)
+{
+    int i, nbCompared = 0, nbRegressions = 0;
+    DISPLAY("\nComparison with baseline (%i results) :\n", nbBaseline);
+    for (i=0; i<nbResults; i++)
+    {
+        const REP_result_t* const r = results + i;
+        const REP_result_t* b = NULL;
+        int j, phase, regression = 0;
+        for (j=0; j<nbBaseline; j++)
+            if (!strcmp(baseline[j].fileName, r->fileName) && !strcmp(baseline[j].codec, r->codec)
+              && (baseline[j].blockSize==r->blockSize) && (baseline[j].tableLog==r->tableLog)) { b = baseline+j; break; }
+        if (b==NULL) continue;
+        nbCompared++;
+        DISPLAY("%-16.16s %-10.10s %6i KB, log %2i : ", r->fileName, r->codec, r->blockSize>>10, r->tableLog);
+        if ((r->srcSize==b->srcSize) && (r->cSize > b->cSize))
+        {
+            DISPLAY("size %+.3f%% ", ((double)r->cSize - (double)b->cSize) / (double)b->cSize * 100.);
+            regression = 1;
+        }
+        for (phase=0; phase<2; phase++)
+        {
+            const double* const bs = phase ? b->dSamples : b->cSamples;
+            const double* const cs = phase ? r->dSamples : r->cSamples;
+            const int nbB = phase ? b->nbDSamples : b->nbCSamples;
+            const int nbC = phase ? r->nbDSamples : r->nbCSamples;
+            double loss, t;
+            int slower;
+            if (!nbB || !nbC) continue;
+            slower = REP_isSlower(bs, nbB, cs, nbC, &loss, &t);
+            DISPLAY("%s %+6.1f%%%s ", phase ? "D" : "C", -loss*100., slower ? " (slower)" : "");
+            regression |= slower;
+        }
+        DISPLAY("%s\n", regression ? "REGRESSION" : "ok");
+        nbRegressions += regression;
+    }
+    DISPLAY("%i regression(s) in %i compared results\n", nbRegressions, nbCompared);
+    return nbRegressions;
+}
+
+int REP_finish(void)
+{
+    int nbRegressions = 0;
+    if (format==REP_json) REP_writeJson();
+    if (format==REP_csv) REP_writeCsv();
+    fflush(stdout);
+    if (baseline) nbRegressions = REP_compare();
+    REP_freeTable(&results, &nbResults);
+    capacity = 0;
+    return nbRegressions;
+}
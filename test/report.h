@@ -0,0 +1,85 @@
+/*
+  report.h - machine-readable benchmark results, and comparison - header
+  Copyright (C) Yann Collet 2013-2014
+  GPL v2 License
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License along
+  with this program; if not, write to the Free Software Foundation, Inc.,
+  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+  You can contact the author at :
+  - Public forum : https://groups.google.com/forum/#!forum/lz4c
+*/
+#pragma once
+
+#if defined (__cplusplus)
+extern "C" {
+#endif
+
+
+//**************************************
+// Parameters
+//**************************************
+typedef enum { REP_none, REP_json, REP_csv } REP_format;
+
+void REP_setFormat  (REP_format format);
+int  REP_setBaseline(const char* fileName);
+/*
+REP_setFormat():
+    Results are written to stdout, once all files are benchmarked (human-readable display stays on stderr).
+REP_setBaseline():
+    Results are compared with those of a previous run, saved with REP_json format.
+    return : 0, or -1 if file cannot be read
+*/
+
+
+//**************************************
+// Results
+//**************************************
+#define REP_MAX_SAMPLES 9   // one per iteration
+
+typedef struct
+{
+    const char* fileName;
+    const char* codec;
+    int    blockSize;
+    int    tableLog;           // 0 = default
+    unsigned long long srcSize;
+    unsigned long long cSize;
+    double cSpeed;             // MB/s, fastest of all samples
+    double dSpeed;             // MB/s, 0 if not measured
+    int    nbCSamples;
+    int    nbDSamples;
+    double cSamples[REP_MAX_SAMPLES];   // MB/s, fastest of each iteration
+    double dSamples[REP_MAX_SAMPLES];
+} REP_result_t;
+
+void REP_add   (const REP_result_t* result);
+int  REP_finish(void);
+/*
+REP_add():
+    Stores a copy of 'result'.
+REP_finish():
+    Writes stored results in selected format, then compares them with baseline, if any.
+    A result is a regression when its compressed size is larger than baseline's,
+    or when its compression or decompression speed is significantly lower :
+    one-sided Welch t-test at 1%, on per-iteration samples, and slower by more than REP_MIN_LOSS.
+    With a single sample on either side, the t-test is replaced by a REP_NOISE threshold.
+    Stored results are then released.
+    return : nb of regressions (0 when there is no baseline)
+*/
+
+
+#if defined (__cplusplus)
+}
+#endif
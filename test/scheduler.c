@@ -0,0 +1,536 @@
+/*
+  scheduler.c - work-stealing task scheduler, for FSE
+  Copyright (C) Yann Collet 2013-2014
+  GPL v2 License
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License along
+  with this program; if not, write to the Free Software Foundation, Inc.,
+  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+  You can contact the author at :
+  - Public forum : https://groups.google.com/forum/#!forum/lz4c
+*/
+/*
+  Note : this is stand-alone program.
+  It is not part of FSE compression library, it is a user program of the FSE library.
+  The license of FSE library is BSD.
+  The license of this program is GPLv2.
+*/
+
+
+//**************************************
+// Compiler Options
+//**************************************
+#define _POSIX_C_SOURCE 200809L   // sysconf
+#if defined(__linux__)
+#  define _GNU_SOURCE             // sched_getaffinity, pthread_setaffinity_np, sched_getcpu
+#endif
+
+
+//**************************************
+// Includes
+//**************************************
+#include <stdio.h>    // fopen, fscanf (topology)
+#include <stdlib.h>   // malloc, free
+#include "scheduler.h"
+
+
+//**************************************
+// Constants
+//**************************************
+#define SCH_MAX_THREADS   256
+#define SCH_DEQUE_MIN     64    // initial capacity of deques, power of 2
+#define SCH_STEAL_MAX     32    // max nb of tasks moved by one steal
+#define SCH_MAX_CPUS      1024
+#define SCH_MAX_NODES     64
+
+
+//**************************************
+// Local Parameters
+//**************************************
+static int nbThreads = 0;
+static int maxThreads = 0;
+static int pinning = 0;
+
+
+//**************************************
+// Group
+//**************************************
+struct SCH_group_s
+{
+    SCH_group* parent;
+    size_t     pending;   // queued or running tasks
+    int        error;
+};
+
+SCH_group* SCH_createGroup(SCH_group* parent)
+{
+    SCH_group* group = (SCH_group*)malloc(sizeof(SCH_group));
+    if (group==NULL) return NULL;
+    group->parent = parent;
+    group->pending = 0;
+    group->error = 0;
+    return group;
+}
+
+void SCH_freeGroup(SCH_group* group) { free(group); }
+
+static int SCH_groupError(const SCH_group* group)
+{
+    for ( ; group!=NULL; group=group->parent)
+        if (group->error) return group->error;
+    return 0;
+}
+
+
+#if defined(_WIN32)
+
+// No thread : tasks are run as soon as submitted, by the calling thread
+void SCH_setNbThreads(int nb) { (void)nb; }
+void SCH_limitThreads(int max) { (void)max; }
+int  SCH_getNbThreads(void) { return 1; }
+int  SCH_getNbCores(void) { return 1; }
+int  SCH_help(void) { return 0; }
+int  SCH_workerId(void) { return 0; }
+void SCH_setPinning(int enabled) { (void)enabled; }
+int  SCH_getPinning(void) { return 0; }
+int  SCH_getNbNodes(void) { return 1; }
+int  SCH_workerNode(int workerId) { (void)workerId; return 0; }
+int  SCH_pinCurrentThread(void) { return 0; }
+int  SCH_isCancelled(const SCH_group* group) { return SCH_groupError(group); }
+
+int SCH_submit(SCH_group* group, SCH_function function, void* arg)
+{
+    if (!SCH_isCancelled(group))
+    {
+        int errorCode = function(arg);
+        if (errorCode) SCH_cancel(group, errorCode);
+    }
+    return 0;
+}
+
+int SCH_wait(SCH_group* group, size_t maxPending) { (void)maxPending; return SCH_isCancelled(group); }
+
+void SCH_cancel(SCH_group* group, int errorCode)
+{
+    if (!group->error) group->error = errorCode;
+}
+
+#else
+
+#include <pthread.h>
+#include <unistd.h>   // sysconf
+#if defined(__linux__)
+#  include <sched.h>  // cpu_set_t
+#endif
+
+
+//**************************************
+// NUMA topology
+//**************************************
+// Allowed CPUs, ordered so that consecutive workers alternate between nodes
+static int   nbNodes = 1;
+static int   nbOrderedCpus = 0;
+static short cpuNode[SCH_MAX_CPUS];
+static short cpuOrder[SCH_MAX_CPUS];
+static pthread_once_t topologyOnce = PTHREAD_ONCE_INIT;
+
+#if defined(__linux__)
+
+// Reads a list such as "0-3,8-11"; return : 1 if file exists
+static int SCH_readCpuList(const char* fileName, int node)
+{
+    FILE* f = fopen(fileName, "r");
+    int first, last;
+    if (f==NULL) return 0;
+    while (fscanf(f, "%d", &first)==1)
+    {
+        int c = fgetc(f);
+        last = first;
+        if ((c=='-') && (fscanf(f, "%d", &last)==1)) c = fgetc(f);
+        for ( ; first<=last; first++) if ((first>=0) && (first<SCH_MAX_CPUS)) cpuNode[first] = (short)node;
+        if (c!=',') break;
+    }
+    fclose(f);
+    return 1;
+}
+
+static void SCH_readTopology(void)
+{
+    cpu_set_t allowed;
+    char fileName[64];
+    int node, cpu, round;
+
+    for (node=0; node<SCH_MAX_NODES; node++)
+    {
+        sprintf(fileName, "/sys/devices/system/node/node%i/cpulist", node);
+        if (SCH_readCpuList(fileName, node)) nbNodes = node+1;
+    }
+    if (sched_getaffinity(0, sizeof(allowed), &allowed)) return;   // no pinning possible
+
+    // Round-robin on nodes : rank 'round' CPU of each node, in turn
+    for (round=0; nbOrderedCpus < CPU_COUNT(&allowed); round++)
+        for (node=0; node<nbNodes; node++)
+        {
+            int rank = 0;
+            for (cpu=0; cpu<SCH_MAX_CPUS; cpu++)
+            {
+                if (!CPU_ISSET(cpu, &allowed) || (cpuNode[cpu]!=node)) continue;
+                if (rank++ == round) { cpuOrder[nbOrderedCpus++] = (short)cpu; break; }
+            }
+        }
+}
+
+static int SCH_pinTo(int cpu)
+{
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+}
+
+static int SCH_currentCpu(void) { return sched_getcpu(); }
+
+#else
+
+static void SCH_readTopology(void) {}
+static int  SCH_pinTo(int cpu) { (void)cpu; return -1; }
+static int  SCH_currentCpu(void) { return -1; }
+
+#endif
+
+int SCH_getNbNodes(void)
+{
+    pthread_once(&topologyOnce, SCH_readTopology);
+    return nbNodes;
+}
+
+int SCH_pinCurrentThread(void)
+{
+    int cpu;
+    if (!pinning) return 0;
+    pthread_once(&topologyOnce, SCH_readTopology);
+    cpu = SCH_currentCpu();
+    if ((cpu < 0) || (cpu >= SCH_MAX_CPUS) || SCH_pinTo(cpu)) return 0;
+    return cpuNode[cpu];
+}
+
+
+//**************************************
+// Pool
+//**************************************
+typedef struct
+{
+    SCH_function function;
+    void*        arg;
+    SCH_group*   group;
+} SCH_task_t;
+
+// Owner pushes and pops at bottom (newest); thieves steal from top (oldest)
+typedef struct
+{
+    pthread_mutex_t mutex;
+    SCH_task_t* tasks;     // circular buffer
+    size_t capacity;       // power of 2
+    size_t top;
+    size_t bottom;
+} SCH_deque_t;
+
+typedef struct
+{
+    int             nbWorkers;
+    pthread_t*      threads;
+    SCH_deque_t*    deques;     // one per worker, plus one shared by threads outside the pool
+    pthread_key_t   workerKey;  // worker index + 1
+    int*            workerNode;
+    pthread_mutex_t mutex;      // protects group counters, and nbQueued
+    pthread_cond_t  changed;    // a task was queued or completed
+    size_t          nbQueued;   // can briefly exceed the real count, while a task is being taken
+} SCH_pool_t;
+
+static SCH_pool_t* pool = NULL;
+static pthread_once_t poolOnce = PTHREAD_ONCE_INIT;
+
+
+static int SCH_deque_init(SCH_deque_t* deque)
+{
+    pthread_mutex_init(&deque->mutex, NULL);
+    deque->capacity = SCH_DEQUE_MIN;
+    deque->tasks = (SCH_task_t*)malloc(deque->capacity * sizeof(SCH_task_t));
+    deque->top = deque->bottom = 0;
+    return deque->tasks==NULL;
+}
+
+static int SCH_deque_push(SCH_deque_t* deque, const SCH_task_t* tasks, size_t nbTasks)
+{
+    size_t i;
+    pthread_mutex_lock(&deque->mutex);
+    while (deque->bottom - deque->top + nbTasks > deque->capacity)
+    {
+        SCH_task_t* newTasks = (SCH_task_t*)malloc(2 * deque->capacity * sizeof(SCH_task_t));
+        if (newTasks==NULL) { pthread_mutex_unlock(&deque->mutex); return -1; }
+        for (i=deque->top; i<deque->bottom; i++) newTasks[i & (2*deque->capacity-1)] = deque->tasks[i & (deque->capacity-1)];
+        free(deque->tasks);
+        deque->tasks = newTasks;
+        deque->capacity *= 2;
+    }
+    for (i=0; i<nbTasks; i++) deque->tasks[(deque->bottom+i) & (deque->capacity-1)] = tasks[i];
+    deque->bottom += nbTasks;
+    pthread_mutex_unlock(&deque->mutex);
+    return 0;
+}
+
+static int SCH_deque_pop(SCH_deque_t* deque, SCH_task_t* task)
+{
+    int found = 0;
+    pthread_mutex_lock(&deque->mutex);
+    if (deque->bottom != deque->top)
+    {
+        deque->bottom--;
+        *task = deque->tasks[deque->bottom & (deque->capacity-1)];
+        found = 1;
+    }
+    pthread_mutex_unlock(&deque->mutex);
+    return found;
+}
+
+// Takes half of the tasks (rounded up), oldest first; return : nb of tasks taken
+static size_t SCH_deque_stealHalf(SCH_deque_t* deque, SCH_task_t* tasks)
+{
+    size_t nb, i;
+    pthread_mutex_lock(&deque->mutex);
+    nb = (deque->bottom - deque->top + 1) / 2;
+    if (nb > SCH_STEAL_MAX) nb = SCH_STEAL_MAX;
+    for (i=0; i<nb; i++) tasks[i] = deque->tasks[(deque->top+i) & (deque->capacity-1)];
+    deque->top += nb;
+    pthread_mutex_unlock(&deque->mutex);
+    return nb;
+}
+
+
+static void* SCH_workerLoop(void* arg);
+
+int SCH_getNbCores(void)
+{
+    int nbCores = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    return (nbCores > 0) ? nbCores : 1;
+}
+
+static void SCH_startPool(void)
+{
+    SCH_pool_t* newPool = (SCH_pool_t*)calloc(1, sizeof(SCH_pool_t));
+    int nbWorkers = nbThreads;
+    int i;
+
+    if (newPool==NULL) return;
+    if (nbWorkers <= 0) nbWorkers = SCH_getNbCores();
+    if ((maxThreads > 0) && (nbWorkers > maxThreads)) nbWorkers = maxThreads;
+    if (nbWorkers <= 0) nbWorkers = 1;
+    if (nbWorkers > SCH_MAX_THREADS) nbWorkers = SCH_MAX_THREADS;
+    newPool->nbWorkers = nbWorkers;
+    newPool->threads = (pthread_t*)malloc(nbWorkers * sizeof(pthread_t));
+    newPool->deques = (SCH_deque_t*)calloc(nbWorkers+1, sizeof(SCH_deque_t));
+    newPool->workerNode = (int*)calloc(nbWorkers, sizeof(int));
+    if ((newPool->threads==NULL) || (newPool->deques==NULL) || (newPool->workerNode==NULL)) return;
+    if (pinning)
+    {
+        pthread_once(&topologyOnce, SCH_readTopology);
+        if (nbOrderedCpus)
+            for (i=0; i<nbWorkers; i++) newPool->workerNode[i] = cpuNode[cpuOrder[i % nbOrderedCpus]];
+    }
+    for (i=0; i<=nbWorkers; i++) if (SCH_deque_init(newPool->deques+i)) return;
+    if (pthread_key_create(&newPool->workerKey, NULL)) return;
+    pthread_mutex_init(&newPool->mutex, NULL);
+    pthread_cond_init(&newPool->changed, NULL);
+
+    pool = newPool;
+    for (i=0; i<nbWorkers; i++)
+        if (pthread_create(newPool->threads+i, NULL, SCH_workerLoop, (void*)(size_t)i))
+        {
+            if (i==0) pool = NULL;   // cannot work at all
+            newPool->nbWorkers = i;
+            break;
+        }
+}
+
+static SCH_pool_t* SCH_getPool(void)
+{
+    pthread_once(&poolOnce, SCH_startPool);
+    return pool;
+}
+
+
+//**************************************
+// Parameters
+//**************************************
+void SCH_setNbThreads(int nb) { nbThreads = nb; }
+void SCH_limitThreads(int max) { maxThreads = max; }
+void SCH_setPinning(int enabled) { pinning = enabled; }
+int  SCH_getPinning(void) { return pinning; }
+
+int SCH_getNbThreads(void)
+{
+    SCH_pool_t* const p = SCH_getPool();
+    return (p==NULL) ? 0 : p->nbWorkers;
+}
+
+int SCH_workerId(void)
+{
+    if (pool==NULL) return -1;
+    return (int)(size_t)pthread_getspecific(pool->workerKey) - 1;
+}
+
+int SCH_workerNode(int workerId)
+{
+    if ((pool==NULL) || (workerId<0) || (workerId>=pool->nbWorkers)) return 0;
+    return pool->workerNode[workerId];
+}
+
+
+//**************************************
+// Tasks
+//**************************************
+void SCH_cancel(SCH_group* group, int errorCode)
+{
+    if (pool==NULL) { if (!group->error) group->error = errorCode; return; }
+    pthread_mutex_lock(&pool->mutex);
+    if (!group->error) group->error = errorCode;
+    pthread_mutex_unlock(&pool->mutex);
+}
+
+int SCH_isCancelled(const SCH_group* group)
+{
+    int errorCode;
+    if (pool==NULL) return SCH_groupError(group);
+    pthread_mutex_lock(&pool->mutex);
+    errorCode = SCH_groupError(group);
+    pthread_mutex_unlock(&pool->mutex);
+    return errorCode;
+}
+
+int SCH_submit(SCH_group* group, SCH_function function, void* arg)
+{
+    SCH_pool_t* const p = SCH_getPool();
+    SCH_task_t task;
+    int id;
+    if (p==NULL) return -1;
+
+    task.function = function;
+    task.arg = arg;
+    task.group = group;
+    id = SCH_workerId();
+    if (id < 0) id = p->nbWorkers;   // shared deque
+
+    pthread_mutex_lock(&p->mutex);
+    if (SCH_deque_push(p->deques+id, &task, 1)) { pthread_mutex_unlock(&p->mutex); return -1; }
+    group->pending++;
+    p->nbQueued++;
+    pthread_cond_broadcast(&p->changed);
+    pthread_mutex_unlock(&p->mutex);
+    return 0;
+}
+
+// return : 1 if a task was found, from own deque first, then by stealing
+static int SCH_takeTask(int id, SCH_task_t* task)
+{
+    SCH_task_t stolen[SCH_STEAL_MAX];
+    int nbDeques = pool->nbWorkers + 1;
+    int pass, i;
+
+    if (SCH_deque_pop(pool->deques+id, task)) goto _found;
+
+    // Victims on same node first (the shared deque belongs to all nodes)
+    for (pass=0; pass<2; pass++)
+    for (i=1; i<nbDeques; i++)
+    {
+        const int victim = (id+i) % nbDeques;
+        const int sameNode = (victim==pool->nbWorkers) || (pool->workerNode[victim]==pool->workerNode[id]);
+        size_t nb;
+        if (sameNode == pass) continue;
+        nb = SCH_deque_stealHalf(pool->deques + victim, stolen);
+        if (nb==0) continue;
+        *task = stolen[nb-1];   // newest stolen task is run first, as would have been the case on its owner
+        if (nb > 1) SCH_deque_push(pool->deques+id, stolen, nb-1);   // cannot fail : deque is empty, hence large enough
+        goto _found;
+    }
+    return 0;
+
+_found:
+    pthread_mutex_lock(&pool->mutex);
+    pool->nbQueued--;
+    pthread_mutex_unlock(&pool->mutex);
+    return 1;
+}
+
+static void SCH_runTask(SCH_task_t* task)
+{
+    int errorCode = SCH_isCancelled(task->group);   // cancelled tasks are skipped
+    if (!errorCode) errorCode = task->function(task->arg);
+    pthread_mutex_lock(&pool->mutex);
+    if (errorCode && !task->group->error) task->group->error = errorCode;
+    task->group->pending--;
+    pthread_cond_broadcast(&pool->changed);
+    pthread_mutex_unlock(&pool->mutex);
+}
+
+int SCH_help(void)
+{
+    const int id = SCH_workerId();
+    SCH_task_t task;
+    if ((id < 0) || !SCH_takeTask(id, &task)) return 0;
+    SCH_runTask(&task);
+    return 1;
+}
+
+int SCH_wait(SCH_group* group, size_t maxPending)
+{
+    const int id = SCH_workerId();
+    int errorCode;
+    if (pool==NULL) return SCH_groupError(group);
+
+    pthread_mutex_lock(&pool->mutex);
+    while (group->pending > maxPending)
+    {
+        SCH_task_t task;
+        if (id >= 0)
+        {
+            // Help : tasks of the group, or any other one
+            pthread_mutex_unlock(&pool->mutex);
+            if (SCH_takeTask(id, &task)) { SCH_runTask(&task); pthread_mutex_lock(&pool->mutex); continue; }
+            pthread_mutex_lock(&pool->mutex);
+            if ((group->pending > maxPending) && (pool->nbQueued==0)) pthread_cond_wait(&pool->changed, &pool->mutex);
+        }
+        else pthread_cond_wait(&pool->changed, &pool->mutex);
+    }
+    errorCode = SCH_groupError(group);
+    pthread_mutex_unlock(&pool->mutex);
+    return errorCode;
+}
+
+static void* SCH_workerLoop(void* arg)
+{
+    const int id = (int)(size_t)arg;
+    pthread_setspecific(pool->workerKey, (void*)(size_t)(id+1));
+    if (pinning && nbOrderedCpus) SCH_pinTo(cpuOrder[id % nbOrderedCpus]);   // memory first touched by this thread is then allocated on its node
+    while (1)
+    {
+        SCH_task_t task;
+        if (SCH_takeTask(id, &task)) { SCH_runTask(&task); continue; }
+        pthread_mutex_lock(&pool->mutex);
+        while (pool->nbQueued==0) pthread_cond_wait(&pool->changed, &pool->mutex);
+        pthread_mutex_unlock(&pool->mutex);
+    }
+    return NULL;
+}
+
+#endif   // _WIN32
@@ -0,0 +1,112 @@
+/*
+  scheduler.h - work-stealing task scheduler - header
+  Copyright (C) Yann Collet 2013-2014
+  GPL v2 License
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License along
+  with this program; if not, write to the Free Software Foundation, Inc.,
+  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+  You can contact the author at :
+  - Public forum : https://groups.google.com/forum/#!forum/lz4c
+*/
+#pragma once
+
+#if defined (__cplusplus)
+extern "C" {
+#endif
+
+
+//**************************************
+// Includes
+//**************************************
+#include <stddef.h>   // size_t
+
+
+//**************************************
+// Parameters
+//**************************************
+void SCH_setNbThreads(int nbThreads);   // 0 = nb of online cores (default); must be set before first use
+void SCH_limitThreads(int maxThreads);  // upper limit, typically derived from memory budget; must be set before first use
+int  SCH_getNbThreads(void);
+int  SCH_getNbCores(void);
+int  SCH_workerId(void);
+void SCH_setPinning(int enabled);       // pins threads of the pool, spread over NUMA nodes; must be set before first use
+int  SCH_getPinning(void);
+int  SCH_getNbNodes(void);
+int  SCH_workerNode(int workerId);
+int  SCH_pinCurrentThread(void);
+/*
+All parallel paths share a single pool of threads, started on first use.
+SCH_workerId():
+    return : index of calling thread within the pool, in [0, SCH_getNbThreads()[
+             or -1 if it does not belong to the pool.
+    Tasks can use it to select per-thread resources.
+Pinning :
+    Each thread of the pool is bound to one allowed CPU, consecutive threads alternating between NUMA nodes (Linux only).
+    Memory is allocated on the node of the thread which first writes into it (first-touch policy) :
+    buffers used by a single task should be allocated, or at least first written, by the thread running it.
+    Idle threads steal from threads of their own node first.
+SCH_getNbNodes():
+    return : nb of NUMA nodes (1 when unknown)
+SCH_workerNode():
+    return : node of a thread of the pool (0 when not pinned)
+SCH_pinCurrentThread():
+    When pinning is enabled, binds calling thread to the CPU it is running on, so that it keeps using local memory.
+    return : node of this CPU (0 when pinning is disabled)
+*/
+
+
+//**************************************
+// Tasks
+//**************************************
+typedef struct SCH_group_s SCH_group;
+typedef int (*SCH_function)(void* arg);
+
+SCH_group* SCH_createGroup(SCH_group* parent);
+void       SCH_freeGroup  (SCH_group* group);
+int        SCH_submit     (SCH_group* group, SCH_function function, void* arg);
+int        SCH_wait       (SCH_group* group, size_t maxPending);
+void       SCH_cancel     (SCH_group* group, int errorCode);
+int        SCH_isCancelled(const SCH_group* group);
+int        SCH_help       (void);
+/*
+A task is a function, belonging to a group. It returns 0 on success, or an error code.
+SCH_createGroup():
+    'parent' can be NULL. Cancelling a group cancels all its descendants.
+    return : NULL if allocation fails
+SCH_submit():
+    Queues a task. Tasks can submit other tasks (nested tasks), typically into a group of their own.
+    Tasks submitted by a thread of the pool are queued into its own deque, and run first by it (newest first).
+    Idle threads steal half of the oldest tasks of another thread.
+    return : 0, or -1 if the pool cannot be started
+SCH_wait():
+    Waits until at most 'maxPending' tasks of 'group' are queued or running. maxPending==0 waits for all of them.
+    A thread of the pool runs other tasks while waiting, so nested waits cannot exhaust the pool.
+    A group must be waited for completely before being freed.
+    return : 0, or the error code which cancelled the group
+SCH_cancel():
+    Tasks of the group (and of its descendants) which did not start yet are skipped.
+    Running ones can check SCH_isCancelled() to stop early.
+    A task returning an error code cancels its own group, with this error code. First error code is kept.
+SCH_isCancelled():
+    return : error code which cancelled the group or one of its ancestors, or 0
+SCH_help():
+    Runs one queued task, if calling thread belongs to the pool. Used to wait for a resource without blocking the pool.
+    return : 1 if a task was run, 0 otherwise
+*/
+
+
+#if defined (__cplusplus)
+}
+#endif
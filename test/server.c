@@ -0,0 +1,509 @@
+/*
+  server.c - local compression service, for FSE
+  Copyright (C) Yann Collet 2013-2014
+  GPL v2 License
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License along
+  with this program; if not, write to the Free Software Foundation, Inc.,
+  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+  You can contact the author at :
+  - Public forum : https://groups.google.com/forum/#!forum/lz4c
+*/
+/*
+  Note : this is stand-alone program.
+  It is not part of FSE compression library, it is a user program of the FSE library.
+  The license of FSE library is BSD.
+  The license of this program is GPLv2.
+*/
+
+
+//**************************************
+// Compiler Options
+//**************************************
+#define _POSIX_C_SOURCE 200809L   // sigaction, fileno
+
+
+//**************************************
+// Includes
+//**************************************
+#include <stdio.h>    // fprintf, fopen, fread
+#include <stdlib.h>   // malloc, realloc
+#include <string.h>   // memcpy, strlen
+#include "server.h"
+#include "fileio.h"
+#include "scheduler.h"
+
+
+//**************************************
+// Basic Types
+//**************************************
+#if defined (__STDC_VERSION__) && __STDC_VERSION__ >= 199901L   // C99
+# include <stdint.h>
+typedef uint8_t  BYTE;
+typedef uint32_t U32;
+typedef uint64_t U64;
+#else
+typedef unsigned char       BYTE;
+typedef unsigned int        U32;
+typedef unsigned long long  U64;
+#endif
+
+
+//**************************************
+// Constants
+//**************************************
+#define KB *(1U<<10)
+#define MB *(1U<<20)
+#define GB *(1U<<30)
+
+#define SRV_HEADERSIZE       9
+#define SRV_MAX_PAYLOAD      (1 GB)
+#define SRV_BACKLOG          64
+#define SRV_CMD_COMPRESS     'C'
+#define SRV_CMD_DECOMPRESS   'D'
+#define SRV_STATUS_OK        0
+#define SRV_STATUS_ERROR     1
+
+
+//**************************************
+// Macros
+//**************************************
+#define DISPLAY(...)         fprintf(stderr, __VA_ARGS__)
+#define DISPLAYLEVEL(l, ...) if (displayLevel>=l) { DISPLAY(__VA_ARGS__); }
+
+
+//**************************************
+// Local Parameters
+//**************************************
+static int displayLevel = 2;   // 0 : no display  // 1: errors  // 2 : + result + interaction + warnings ;  // 3 : + progression;  // 4 : + information
+
+
+//**************************************
+// Exceptions
+//**************************************
+#define EXM_THROW(error, ...)                                             \
+{                                                                         \
+    DISPLAYLEVEL(1, "Error %i : ", error);                                \
+    DISPLAYLEVEL(1, __VA_ARGS__);                                         \
+    DISPLAYLEVEL(1, "\n");                                                \
+    exit(error);                                                          \
+}
+
+
+//**************************************
+// Parameters
+//**************************************
+#if defined(_WIN32)
+
+int SRV_serve(const char* socketName)
+{
+    (void)socketName;
+    DISPLAYLEVEL(1, "Service mode requires Unix sockets : not supported on this platform\n");
+    return 1;
+}
+
+int SRV_request(const char* socketName, int decode, char* output_filename, char* input_filename)
+{
+    (void)socketName; (void)decode; (void)output_filename; (void)input_filename;
+    DISPLAYLEVEL(1, "Service mode requires Unix sockets : not supported on this platform\n");
+    return 1;
+}
+
+#else
+
+#include <errno.h>       // errno, EINTR
+#include <fcntl.h>       // fcntl, O_NONBLOCK
+#include <poll.h>        // poll
+#include <pthread.h>     // pthread_mutex_t
+#include <signal.h>      // sigaction
+#include <unistd.h>      // close, unlink, pipe
+#include <sys/socket.h>
+#include <sys/stat.h>    // stat, S_ISSOCK
+#include <sys/un.h>      // sockaddr_un
+
+
+//**************************************
+// Helper functions
+//**************************************
+static void SRV_writeLE64(BYTE* p, U64 value)
+{
+    int i;
+    for (i=0; i<8; i++) p[i] = (BYTE)(value >> (8*i));
+}
+
+static U64 SRV_readLE64(const BYTE* p)
+{
+    U64 value = 0;
+    int i;
+    for (i=7; i>=0; i--) value = (value << 8) + p[i];
+    return value;
+}
+
+// return : 0 when all bytes are received, -1 on error or end of connection
+static int SRV_recvAll(int fd, void* buffer, size_t size)
+{
+    BYTE* p = (BYTE*)buffer;
+    while (size)
+    {
+        ssize_t r = recv(fd, p, size, 0);
+        if (r==0) return -1;
+        if (r<0) { if (errno==EINTR) continue; return -1; }
+        p += r;
+        size -= (size_t)r;
+    }
+    return 0;
+}
+
+static int SRV_sendAll(int fd, const void* buffer, size_t size)
+{
+    const BYTE* p = (const BYTE*)buffer;
+    while (size)
+    {
+        ssize_t r = send(fd, p, size, 0);
+        if (r<0) { if (errno==EINTR) continue; return -1; }
+        p += r;
+        size -= (size_t)r;
+    }
+    return 0;
+}
+
+// Grows a buffer when needed; its content is not preserved. Buffer is never NULL, even for size 0.
+static int SRV_reserve(BYTE** buffer, size_t* capacity, size_t size)
+{
+    if (size==0) size=1;
+    if (*capacity >= size) return 0;
+    free(*buffer);
+    *buffer = (BYTE*)malloc(size);
+    *capacity = (*buffer==NULL) ? 0 : size;
+    return (*buffer==NULL) ? -1 : 0;
+}
+
+static int SRV_openSocket(const char* socketName, struct sockaddr_un* addr)
+{
+    int fd;
+    if (strlen(socketName) >= sizeof(addr->sun_path)) EXM_THROW(61, "Socket name too long : %s", socketName);
+    memset(addr, 0, sizeof(*addr));
+    addr->sun_family = AF_UNIX;
+    strcpy(addr->sun_path, socketName);
+    fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd<0) EXM_THROW(62, "Cannot create socket");
+    return fd;
+}
+
+
+//**************************************
+// Workers
+//**************************************
+// Requests are tasks of the shared pool; each thread of the pool has its own worker state
+typedef struct
+{
+    BYTE*  inBuff;
+    size_t inCapacity;
+    BYTE*  outBuff;
+    size_t outCapacity;
+    size_t outSize;
+    int    outError;
+    FSE_DStream* dstream;   // kept from one request to the next : warm buffers and DTable cache
+    U64    nbRequests;
+} SRV_worker_t;
+
+static SRV_worker_t* SRV_workers = NULL;
+
+static volatile sig_atomic_t SRV_stop = 0;
+static void SRV_signalHandler(int sig) { (void)sig; SRV_stop = 1; }
+
+
+// FSE_DStream output : appends decoded data to outBuff
+static int SRV_appendOutput(void* opaque, const void* decoded, size_t size)
+{
+    SRV_worker_t* const worker = (SRV_worker_t*)opaque;
+    if (worker->outSize + size > SRV_MAX_PAYLOAD) { worker->outError = 1; return 1; }
+    if (worker->outSize + size > worker->outCapacity)
+    {
+        size_t newCapacity = (worker->outCapacity * 2 > worker->outSize + size) ? worker->outCapacity * 2 : worker->outSize + size;
+        BYTE* newBuff = (BYTE*)realloc(worker->outBuff, newCapacity);
+        if (newBuff==NULL) { worker->outError = 1; return 1; }
+        worker->outBuff = newBuff;
+        worker->outCapacity = newCapacity;
+    }
+    memcpy(worker->outBuff + worker->outSize, decoded, size);
+    worker->outSize += size;
+    return 0;
+}
+
+
+// return : status of the answer
+static int SRV_processRequest(SRV_worker_t* worker, int command, size_t size)
+{
+    worker->outSize = 0;
+    worker->outError = 0;
+    if (command == SRV_CMD_COMPRESS)
+    {
+        if (SRV_reserve(&worker->outBuff, &worker->outCapacity, FIO_compressFrameBound(size))) return SRV_STATUS_ERROR;
+        worker->outSize = FIO_compressFrame(worker->outBuff, worker->inBuff, size);
+        if (worker->outSize==FIO_ERROR) { worker->outSize = 0; return SRV_STATUS_ERROR; }
+        return SRV_STATUS_OK;
+    }
+
+    // SRV_CMD_DECOMPRESS
+    if (worker->dstream==NULL) worker->dstream = FSE_createDStream(SRV_appendOutput, worker);
+    if (worker->dstream==NULL) return SRV_STATUS_ERROR;
+    FSE_resetDStream(worker->dstream);
+    if (FSE_DStream_update(worker->dstream, worker->inBuff, size) != 0) return SRV_STATUS_ERROR;   // corrupted or incomplete
+    return worker->outError ? SRV_STATUS_ERROR : SRV_STATUS_OK;
+}
+
+
+// Serves one request of a connection
+// return : 0 if the connection remains open, 1 if it must be closed
+static int SRV_serveRequest(SRV_worker_t* worker, int fd)
+{
+    BYTE header[SRV_HEADERSIZE];
+    U64  size;
+    int  command, status;
+
+    if (SRV_recvAll(fd, header, SRV_HEADERSIZE)) return 1;   // end of connection
+    command = header[0];
+    size = SRV_readLE64(header+1);
+    if ( ((command != SRV_CMD_COMPRESS) && (command != SRV_CMD_DECOMPRESS))
+      || (size > SRV_MAX_PAYLOAD)
+      || SRV_reserve(&worker->inBuff, &worker->inCapacity, (size_t)size) )
+    {
+        header[0] = SRV_STATUS_ERROR;
+        SRV_writeLE64(header+1, 0);
+        SRV_sendAll(fd, header, SRV_HEADERSIZE);
+        return 1;   // cannot resynchronize
+    }
+    if (SRV_recvAll(fd, worker->inBuff, (size_t)size)) return 1;
+
+    status = SRV_processRequest(worker, command, (size_t)size);
+    if (status != SRV_STATUS_OK) worker->outSize = 0;
+    header[0] = (BYTE)status;
+    SRV_writeLE64(header+1, worker->outSize);
+    if (SRV_sendAll(fd, header, SRV_HEADERSIZE)) return 1;
+    if (SRV_sendAll(fd, worker->outBuff, worker->outSize)) return 1;
+    worker->nbRequests++;
+    DISPLAYLEVEL(4, "%c request : %u bytes => %u bytes\n", command, (U32)size, (U32)worker->outSize);
+    return 0;
+}
+
+
+//**************************************
+// Connections
+//**************************************
+/*
+Idle connections are watched by the accepting thread, with poll() : they hold no thread of the pool.
+When a request arrives, the connection becomes busy, and the request is submitted as a task.
+Once answered, the task hands the connection back (or closes it), and wakes the accepting thread through a pipe.
+*/
+typedef enum { SRV_idle, SRV_busy, SRV_closed } SRV_connectionState;
+
+typedef struct
+{
+    int fd;
+    SRV_connectionState state;   // protected by SRV_mutex
+} SRV_connection_t;
+
+static pthread_mutex_t SRV_mutex = PTHREAD_MUTEX_INITIALIZER;
+static int SRV_wakeFd[2] = { -1, -1 };   // read end, write end
+
+static void SRV_setState(SRV_connection_t* connection, SRV_connectionState state)
+{
+    const BYTE wake = 0;
+    pthread_mutex_lock(&SRV_mutex);
+    connection->state = state;
+    pthread_mutex_unlock(&SRV_mutex);
+    if (write(SRV_wakeFd[1], &wake, 1)) {}   // pipe full : accepting thread is already due to wake up
+}
+
+static int SRV_requestTask(void* arg)
+{
+    SRV_connection_t* const connection = (SRV_connection_t*)arg;
+    if (SRV_serveRequest(SRV_workers + SCH_workerId(), connection->fd))
+    {
+        close(connection->fd);
+        SRV_setState(connection, SRV_closed);
+    }
+    else SRV_setState(connection, SRV_idle);
+    return 0;
+}
+
+
+//**************************************
+// Service functions
+//**************************************
+int SRV_serve(const char* socketName)
+{
+    struct sockaddr_un addr;
+    struct sigaction action;
+    struct stat st;
+    SCH_group* requests;
+    SRV_connection_t** connections = NULL;
+    struct pollfd* fds = NULL;
+    int nbOpen = 0, capacity = 0;
+    int listenFd;
+    int nbWorkers;
+    U64 nbConnections = 0;
+
+    // Socket : only a stale socket can be replaced, never a regular file
+    listenFd = SRV_openSocket(socketName, &addr);
+    if ((stat(socketName, &st)==0) && S_ISSOCK(st.st_mode)) unlink(socketName);
+    if (bind(listenFd, (struct sockaddr*)&addr, sizeof(addr))) EXM_THROW(63, "Cannot bind socket %s", socketName);
+    if (listen(listenFd, SRV_BACKLOG)) EXM_THROW(64, "Cannot listen on socket %s", socketName);
+    if (pipe(SRV_wakeFd)) EXM_THROW(60, "Cannot create pipe");
+    fcntl(SRV_wakeFd[0], F_SETFL, O_NONBLOCK);
+    fcntl(SRV_wakeFd[1], F_SETFL, O_NONBLOCK);
+
+    // Signals : interrupt poll() to stop; clients closing early must not kill the service
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = SRV_signalHandler;
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGINT, &action, NULL);
+    sigaction(SIGTERM, &action, NULL);
+    signal(SIGPIPE, SIG_IGN);
+
+    // Workers
+    nbWorkers = SCH_getNbThreads();
+    if (nbWorkers==0) EXM_THROW(66, "Cannot create worker threads");
+    SRV_workers = (SRV_worker_t*)calloc(nbWorkers, sizeof(SRV_worker_t));
+    requests = SCH_createGroup(NULL);
+    if ((SRV_workers==NULL) || (requests==NULL)) EXM_THROW(65, "Allocation error : not enough memory");
+    DISPLAYLEVEL(2, "Serving on %s with %i threads (Ctrl-C to stop)\n", socketName, nbWorkers);
+
+    // Main loop : fds[0] is the listening socket, fds[1] the wake-up pipe, then open connections
+    while (!SRV_stop)
+    {
+        int nbFds, i;
+
+        if (nbOpen+2 > capacity)
+        {
+            capacity = 2*capacity + 16;
+            connections = (SRV_connection_t**)realloc(connections, capacity * sizeof(SRV_connection_t*));
+            fds = (struct pollfd*)realloc(fds, capacity * sizeof(struct pollfd));
+            if ((connections==NULL) || (fds==NULL)) EXM_THROW(65, "Allocation error : not enough memory");
+        }
+        fds[0].fd = listenFd;
+        fds[1].fd = SRV_wakeFd[0];
+        pthread_mutex_lock(&SRV_mutex);
+        for (i=0; i<nbOpen; )
+        {
+            if (connections[i]->state == SRV_closed) { free(connections[i]); connections[i] = connections[--nbOpen]; continue; }
+            fds[i+2].fd = (connections[i]->state == SRV_idle) ? connections[i]->fd : -1;   // busy : ignored by poll()
+            i++;
+        }
+        pthread_mutex_unlock(&SRV_mutex);
+        nbFds = nbOpen + 2;
+        for (i=0; i<nbFds; i++) { fds[i].events = POLLIN; fds[i].revents = 0; }
+
+        if (poll(fds, nbFds, -1) < 0)
+        {
+            if (errno==EINTR) continue;
+            DISPLAYLEVEL(1, "poll() failed (errno %i)\n", errno);
+            break;
+        }
+        if (fds[1].revents) { BYTE drain[64]; while (read(SRV_wakeFd[0], drain, sizeof(drain)) > 0) {} }
+
+        // Request (or end) on idle connections
+        for (i=0; i<nbOpen; i++)
+        {
+            if (fds[i+2].revents == 0) continue;
+            pthread_mutex_lock(&SRV_mutex);
+            connections[i]->state = SRV_busy;
+            pthread_mutex_unlock(&SRV_mutex);
+            if (SCH_submit(requests, SRV_requestTask, connections[i])) EXM_THROW(65, "Allocation error : not enough memory");
+        }
+
+        // New connection
+        if (fds[0].revents)
+        {
+            int fd = accept(listenFd, NULL, NULL);
+            if (fd<0)
+            {
+                if (errno==EINTR) continue;
+                DISPLAYLEVEL(1, "accept() failed (errno %i)\n", errno);
+                break;
+            }
+            connections[nbOpen] = (SRV_connection_t*)malloc(sizeof(SRV_connection_t));
+            if (connections[nbOpen]==NULL) EXM_THROW(65, "Allocation error : not enough memory");
+            connections[nbOpen]->fd = fd;
+            connections[nbOpen]->state = SRV_idle;
+            nbOpen++;
+            nbConnections++;
+        }
+    }
+
+    // Shutdown : requests still served or queued are terminated with the process
+    close(listenFd);
+    unlink(socketName);
+    DISPLAYLEVEL(2, "\nService stopped after %llu connections\n", (unsigned long long)nbConnections);
+    return 0;
+}
+
+
+int SRV_request(const char* socketName, int decode, char* output_filename, char* input_filename)
+{
+    struct sockaddr_un addr;
+    FILE* finput;
+    FILE* foutput;
+    BYTE  header[SRV_HEADERSIZE];
+    BYTE* buffer = NULL;
+    size_t capacity = 0;
+    size_t size = 0;
+    U64   answerSize;
+    int   fd;
+
+    get_fileHandle(input_filename, output_filename, &finput, &foutput);
+
+    // Load input
+    while (1)
+    {
+        size_t readSize;
+        if (size == capacity)
+        {
+            capacity = capacity ? capacity*2 : 1 MB;
+            if (capacity > SRV_MAX_PAYLOAD) EXM_THROW(67, "Input too large (max %u MB)", SRV_MAX_PAYLOAD >> 20);
+            buffer = (BYTE*)realloc(buffer, capacity);
+            if (buffer==NULL) EXM_THROW(68, "Allocation error : not enough memory");
+        }
+        readSize = fread(buffer+size, 1, capacity-size, finput);
+        size += readSize;
+        if (readSize==0) { if (ferror(finput)) EXM_THROW(69, "Read error"); break; }
+    }
+
+    // Request
+    fd = SRV_openSocket(socketName, &addr);
+    if (connect(fd, (struct sockaddr*)&addr, sizeof(addr))) EXM_THROW(70, "Cannot connect to service on %s", socketName);
+    header[0] = decode ? SRV_CMD_DECOMPRESS : SRV_CMD_COMPRESS;
+    SRV_writeLE64(header+1, size);
+    if (SRV_sendAll(fd, header, SRV_HEADERSIZE) || SRV_sendAll(fd, buffer, size)) EXM_THROW(71, "Cannot send request");
+
+    // Answer
+    if (SRV_recvAll(fd, header, SRV_HEADERSIZE)) EXM_THROW(72, "No answer from service");
+    if (header[0] != SRV_STATUS_OK) EXM_THROW(73, "Service error : %s failed", decode ? "decompression" : "compression");
+    answerSize = SRV_readLE64(header+1);
+    if (answerSize > SRV_MAX_PAYLOAD) EXM_THROW(74, "Invalid answer from service");
+    if (SRV_reserve(&buffer, &capacity, (size_t)answerSize)) EXM_THROW(68, "Allocation error : not enough memory");
+    if (SRV_recvAll(fd, buffer, (size_t)answerSize)) EXM_THROW(72, "Incomplete answer from service");
+    close(fd);
+
+    if (fwrite(buffer, 1, (size_t)answerSize, foutput) != (size_t)answerSize) EXM_THROW(75, "Write error");
+    DISPLAYLEVEL(2, "%s %llu bytes into %llu bytes\n", decode ? "Decoded" : "Compressed", (unsigned long long)size, (unsigned long long)answerSize);
+
+    free(buffer);
+    fclose(finput);
+    fclose(foutput);
+    return 0;
+}
+
+#endif   // _WIN32
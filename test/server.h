@@ -0,0 +1,56 @@
+/*
+  server.h - local compression service - header
+  Copyright (C) Yann Collet 2013-2014
+  GPL v2 License
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License along
+  with this program; if not, write to the Free Software Foundation, Inc.,
+  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+  You can contact the author at :
+  - Public forum : https://groups.google.com/forum/#!forum/lz4c
+*/
+#pragma once
+
+#if defined (__cplusplus)
+extern "C" {
+#endif
+
+
+//**************************************
+// Service functions
+//**************************************
+int SRV_serve  (const char* socketName);
+int SRV_request(const char* socketName, int decode, char* output_filename, char* input_filename);
+/*
+SRV_serve():
+    Runs a compression service on Unix socket 'socketName', until interrupted (SIGINT, SIGTERM).
+    Each request is a task of the shared pool of threads (see scheduler.h) : idle connections hold no thread,
+    so any number of clients can stay connected while others are served.
+    Each thread keeps its buffers and its FSE_DStream (with its DTable cache) from one request to the next.
+    Requests and answers have the same layout :
+        1 byte  : request : 'C' (compress) or 'D' (decompress); answer : 0 (success) or 1 (error)
+        8 bytes : payload size, little endian
+        payload : request : data to process; answer : result, in the same format as compress_file()
+    A connection can carry any number of requests. Payload size is limited to 1 GB.
+    return : 0 on clean shutdown, or an error code if the service could not start
+SRV_request():
+    Sends the content of 'input_filename' to the service listening on 'socketName',
+    and writes the answer into 'output_filename' (same conventions as compress_file()/decompress_file()).
+    return : 0 on success, or an error code
+*/
+
+
+#if defined (__cplusplus)
+}
+#endif